@@ -0,0 +1,352 @@
+#include <sstream>
+
+#include "accel.h"
+#include "bvh.h"
+#include "grid.h"
+#include "kdtree.h"
+#include "logger.h"
+
+
+namespace mrtp {
+
+void Accelerator::solve_packet_hits(RayPacket* packet, RayHit* hits, RenderStats*) const
+{
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        double distance = packet->max_dist[i];
+        unsigned int part = 0;
+
+        ActorBase* actor = solve_hits(packet->get_origin(i), packet->get_direction(i),
+                                      &distance, &part);
+        if (actor) {
+            packet->max_dist[i] = distance;
+            hits[i].actor = actor;
+            hits[i].distance = distance;
+            hits[i].part = part;
+        }
+    }
+}
+
+
+// Tests whether an actor casts a shadow on a ray, as the snapshot did
+static bool test_occluder(const CompiledActor& item, const Vector3d& O,
+                          const Vector3d& D, double max_dist,
+                          const ActorBase* skip, RenderStats* stats)
+{
+    if (!item.has_shadow || item.actor == skip) {
+        return false;
+    }
+
+    stats->num_shadow_tests++;
+    return item.actor->occludes(O, D, max_dist);
+}
+
+
+// Hands the hits of an actor to the rays of a packet which it got closer
+static void solve_actor_packet(ActorBase* actor, unsigned int rays,
+                               RayPacket* packet, RayHit* hits)
+{
+    unsigned int parts[RayPacket::kMaxRays];
+    unsigned int hit_rays = actor->solve_packet_rays(packet, rays, parts);
+
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        if (hit_rays & (1u << i)) {
+            hits[i].actor = actor;
+            hits[i].distance = packet->max_dist[i];
+            hits[i].part = parts[i];
+        }
+    }
+}
+
+
+// Every actor is tested by every ray
+class ListAccelerator : public Accelerator
+{
+public:
+    ListAccelerator(const std::vector<CompiledActor>& actors)
+        : actors_(actors)
+    {
+    }
+
+    ActorBase* solve_hits(const Vector3d& O, const Vector3d& D,
+                          double* curr_dist, unsigned int* hit_part) const override
+    {
+        ActorBase* hit_actor = nullptr;
+
+        for (const CompiledActor& item : actors_) {
+            unsigned int part = 0;
+            double distance = item.actor->solve_part_ray(O, D, 0, *curr_dist, &part);
+            if (distance > 0 && distance < *curr_dist) {
+                *curr_dist = distance;
+                *hit_part = part;
+                hit_actor = item.actor;
+            }
+        }
+
+        return hit_actor;
+    }
+
+    ActorBase* find_occluder(const Vector3d& O, const Vector3d& D, double max_dist,
+                             const ActorBase* skip, RenderStats* stats) const override
+    {
+        for (const CompiledActor& item : actors_) {
+            if (test_occluder(item, O, D, max_dist, skip, stats)) {
+                return item.actor;
+            }
+        }
+        return nullptr;
+    }
+
+    // Compound actors walk their own hierarchies with the whole packet
+    void solve_packet_hits(RayPacket* packet, RayHit* hits, RenderStats*) const override
+    {
+        for (const CompiledActor& item : actors_) {
+            solve_actor_packet(item.actor, packet->get_all_rays(), packet, hits);
+        }
+    }
+
+    std::string get_name() const override
+    {
+        return get_accel_name(AccelType::None);
+    }
+
+    size_t get_memory_size() const override
+    {
+        return actors_.capacity() * sizeof(CompiledActor);
+    }
+
+private:
+    std::vector<CompiledActor> actors_;
+};
+
+
+/*
+Actors are stored in the leaf order of the hierarchy, so leaves read them
+from one contiguous range. Packets walk the hierarchy together and skip
+nodes outside their frustum.
+*/
+class BvhAccelerator : public Accelerator
+{
+public:
+    BvhAccelerator(const std::vector<CompiledActor>& actors,
+                   const std::vector<BoundingBox>& boxes)
+    {
+        bvh_.build(boxes);
+
+        actors_.reserve(actors.size());
+        for (unsigned int index : bvh_.get_order()) {
+            actors_.push_back(actors[index]);
+        }
+
+        std::stringstream convert;
+        convert << "Built BVH with " << bvh_.get_num_nodes() << " nodes for "
+                << actors_.size() << " actors";
+        LOG_DEBUG(convert.str());
+    }
+
+    ActorBase* solve_hits(const Vector3d& O, const Vector3d& D,
+                          double* curr_dist, unsigned int* hit_part) const override
+    {
+        ActorBase* hit_actor = nullptr;
+
+        bvh_.find_closest_leaf(O, D, *curr_dist,
+            [&](unsigned int first, unsigned int count, double max_dist) {
+                double closest = -1;
+                for (unsigned int i = first; i < first + count; i++) {
+                    unsigned int part = 0;
+                    double distance = actors_[i].actor->solve_part_ray(O, D, 0, max_dist, &part);
+                    if (distance > 0 && distance < max_dist) {
+                        max_dist = distance;
+                        closest = distance;
+                        *curr_dist = distance;
+                        *hit_part = part;
+                        hit_actor = actors_[i].actor;
+                    }
+                }
+                return closest;
+            });
+
+        return hit_actor;
+    }
+
+    ActorBase* find_occluder(const Vector3d& O, const Vector3d& D, double max_dist,
+                             const ActorBase* skip, RenderStats* stats) const override
+    {
+        ActorBase* occluder = nullptr;
+
+        bvh_.find_any_leaf(O, D, max_dist,
+            [&](unsigned int first, unsigned int count, double) {
+                for (unsigned int i = first; i < first + count; i++) {
+                    if (test_occluder(actors_[i], O, D, max_dist, skip, stats)) {
+                        occluder = actors_[i].actor;
+                        return true;
+                    }
+                }
+                return false;
+            });
+
+        return occluder;
+    }
+
+    void solve_packet_hits(RayPacket* packet, RayHit* hits, RenderStats* stats) const override
+    {
+        bvh_.visit_leaves(
+            [&](const BvhNode& node) {
+                if (packet->is_outside_frustum(node.lo, node.hi)) {
+                    stats->num_frustum_culls++;
+                    return -1.0;
+                }
+                return packet->intersect_box(node.lo, node.hi, packet->get_all_rays());
+            },
+            [&](const BvhNode& node) {
+                unsigned int rays = 0;
+                for (unsigned int i = 0; i < packet->num_rays; i++) {
+                    if (packet->intersect_box(i, node.lo, node.hi) >= 0) {
+                        rays |= 1u << i;
+                    }
+                }
+
+                for (unsigned int a = node.first; rays && a < node.first + node.count; a++) {
+                    solve_actor_packet(actors_[a].actor, rays, packet, hits);
+                }
+            });
+    }
+
+    std::string get_name() const override
+    {
+        return get_accel_name(AccelType::BVH);
+    }
+
+    size_t get_memory_size() const override
+    {
+        return actors_.capacity() * sizeof(CompiledActor) + bvh_.get_memory_size();
+    }
+
+private:
+    BoundingVolumeHierarchy bvh_;
+    std::vector<CompiledActor> actors_;
+};
+
+
+/*
+Backends whose structures list actors by index and may visit an actor more
+than once per ray, like grids and kd-trees. Structure has the queries of
+the hierarchy without leaf ranges.
+*/
+template <typename Structure>
+class IndexedAccelerator : public Accelerator
+{
+public:
+    IndexedAccelerator(const std::vector<CompiledActor>& actors,
+                       const std::vector<BoundingBox>& boxes,
+                       const std::string& name)
+        : actors_(actors)
+        , name_(name)
+    {
+        structure_.build(boxes);
+    }
+
+    ActorBase* solve_hits(const Vector3d& O, const Vector3d& D,
+                          double* curr_dist, unsigned int* hit_part) const override
+    {
+        ActorBase* hit_actor = nullptr;
+
+        structure_.find_closest(O, D, *curr_dist,
+            [&](unsigned int index, double max_dist) {
+                unsigned int part = 0;
+                ActorBase* actor = actors_[index].actor;
+                double distance = actor->solve_part_ray(O, D, 0, max_dist, &part);
+                if (distance > 0 && distance < *curr_dist) {
+                    *curr_dist = distance;
+                    *hit_part = part;
+                    hit_actor = actor;
+                }
+                return distance;
+            });
+
+        return hit_actor;
+    }
+
+    ActorBase* find_occluder(const Vector3d& O, const Vector3d& D, double max_dist,
+                             const ActorBase* skip, RenderStats* stats) const override
+    {
+        ActorBase* occluder = nullptr;
+
+        structure_.find_any(O, D, max_dist,
+            [&](unsigned int index, double) {
+                if (test_occluder(actors_[index], O, D, max_dist, skip, stats)) {
+                    occluder = actors_[index].actor;
+                    return true;
+                }
+                return false;
+            });
+
+        return occluder;
+    }
+
+    std::string get_name() const override
+    {
+        return name_;
+    }
+
+    size_t get_memory_size() const override
+    {
+        return actors_.capacity() * sizeof(CompiledActor) + structure_.get_memory_size();
+    }
+
+private:
+    Structure structure_;
+    std::vector<CompiledActor> actors_;
+    std::string name_;
+};
+
+
+std::unique_ptr<Accelerator> create_accelerator(AccelType accel_type,
+                                                const std::vector<CompiledActor>& actors,
+                                                const std::vector<BoundingBox>& boxes)
+{
+    switch (accel_type) {
+    case AccelType::BVH:
+        return std::unique_ptr<Accelerator>(new BvhAccelerator(actors, boxes));
+    case AccelType::Grid:
+        return std::unique_ptr<Accelerator>(
+                    new IndexedAccelerator<UniformGrid>(actors, boxes, get_accel_name(accel_type)));
+    case AccelType::KdTree:
+        return std::unique_ptr<Accelerator>(
+                    new IndexedAccelerator<KdTree>(actors, boxes, get_accel_name(accel_type)));
+    case AccelType::None:
+        break;
+    }
+
+    return std::unique_ptr<Accelerator>(new ListAccelerator(actors));
+}
+
+
+std::string get_accel_name(AccelType accel_type)
+{
+    switch (accel_type) {
+    case AccelType::BVH:
+        return "bvh";
+    case AccelType::Grid:
+        return "grid";
+    case AccelType::KdTree:
+        return "kdtree";
+    case AccelType::None:
+        break;
+    }
+    return "none";
+}
+
+
+bool parse_accel_type(const std::string& name, AccelType* accel_type)
+{
+    for (AccelType type : {AccelType::None, AccelType::BVH, AccelType::Grid, AccelType::KdTree}) {
+        if (get_accel_name(type) == name) {
+            *accel_type = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,79 @@
+#ifndef _ACCEL_H
+#define _ACCEL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+
+#include "actors.h"
+#include "common.h"
+#include "packet.h"
+#include "stats.h"
+
+
+namespace mrtp {
+
+enum class AccelType
+{
+    None,    // every actor in a list
+    BVH,
+    Grid,
+    KdTree
+};
+
+
+struct RayHit
+{
+    ActorBase* actor = nullptr;
+    double distance = 0;
+    unsigned int part = 0;
+};
+
+
+// Actor of a snapshot with the answers render threads ask for every ray
+struct CompiledActor
+{
+    ActorBase* actor;
+    bool has_shadow;
+};
+
+
+/*
+Finds hits among the bounded actors of a snapshot. Backends only differ in
+how they index the actors, so they give the same images. Actors of infinite
+extent stay with the snapshot.
+*/
+class Accelerator
+{
+public:
+    virtual ~Accelerator() = default;
+
+    // Closest hit nearer than the distance, which is shortened to it
+    virtual ActorBase* solve_hits(const Vector3d&, const Vector3d&,
+                                  double*, unsigned int*) const = 0;
+
+    // Any actor with shadows closer than the distance, except the given one
+    virtual ActorBase* find_occluder(const Vector3d&, const Vector3d&, double,
+                                     const ActorBase*, RenderStats*) const = 0;
+
+    // Closer hits of the rays of a packet, one ray at a time unless the
+    // backend can trace whole packets
+    virtual void solve_packet_hits(RayPacket*, RayHit*, RenderStats*) const;
+
+    virtual std::string get_name() const = 0;
+    virtual size_t get_memory_size() const = 0;
+};
+
+
+std::unique_ptr<Accelerator> create_accelerator(AccelType,
+                                                const std::vector<CompiledActor>&,
+                                                const std::vector<BoundingBox>&);
+
+std::string get_accel_name(AccelType);
+bool parse_accel_type(const std::string&, AccelType*);
+
+
+} // namespace mrtp
+
+#endif // _ACCEL_H
@@ -2,16 +2,81 @@
 
 namespace mrtp {
 
-ActorBase::ActorBase(const StandardBasis& local_basis,
-    std::shared_ptr<TextureMapper> texture_mapper_ptr)
+ActorBase::ActorBase(const StandardBasis& local_basis, MaterialId material)
     : local_basis_(local_basis)
-    , texture_mapper_(texture_mapper_ptr)
+    , material_(material)
 {
 }
 
-MyPixel ActorBase::pick_pixel(const Vector3d& X, const Vector3d& N) const
+bool ActorBase::is_planar() const
 {
-    return texture_mapper_->pick_pixel(X, N, local_basis_);
+    return false;
+}
+
+bool ActorBase::occludes(const Vector3d& O, const Vector3d& D, double max_dist) const
+{
+    return solve_light_ray(O, D, 0, max_dist) > 0;
+}
+
+void ActorBase::prepare_light(const Light*, double)
+{
+}
+
+void ActorBase::rasterize(VisibilityBuffer*) const
+{
+}
+
+bool ActorBase::is_animated() const
+{
+    return false;
+}
+
+bool ActorBase::advance_frame()
+{
+    return false;
+}
+
+double ActorBase::solve_part_ray(const Vector3d& O, const Vector3d& D,
+    double min_dist, double max_dist, unsigned int* part) const
+{
+    *part = 0;
+    return solve_light_ray(O, D, min_dist, max_dist);
+}
+
+unsigned int ActorBase::solve_packet_rays(RayPacket* packet, unsigned int rays,
+    unsigned int* parts) const
+{
+    unsigned int hit_rays = 0;
+
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        if (!(rays & (1u << i))) {
+            continue;
+        }
+
+        double distance = solve_part_ray(packet->get_origin(i), packet->get_direction(i),
+                                         0, packet->max_dist[i], &parts[i]);
+        if (distance > 0 && distance < packet->max_dist[i]) {
+            packet->max_dist[i] = distance;
+            hit_rays |= 1u << i;
+        }
+    }
+
+    return hit_rays;
+}
+
+Vector3d ActorBase::calculate_part_normal(const Vector3d& hit, unsigned int) const
+{
+    return calculate_normal_at_hit(hit);
+}
+
+MaterialId ActorBase::get_part_material(unsigned int) const
+{
+    return material_;
+}
+
+const StandardBasis& ActorBase::get_local_basis() const
+{
+    return local_basis_;
 }
 
 } // namespace mrtp
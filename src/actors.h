@@ -5,17 +5,22 @@
 #include <Eigen/Core>
 
 #include "common.h"
-#include "mappers.h"
+#include "light.h"
+#include "materials.h"
+#include "packet.h"
 
 using Vector3d = Eigen::Vector3d;
 
 
 namespace mrtp {
 
+class VisibilityBuffer;
+
+
 class ActorBase 
 {
 public:
-    ActorBase(const StandardBasis&, std::shared_ptr<TextureMapper>);
+    ActorBase(const StandardBasis&, MaterialId);
     ActorBase() = delete;
 
     virtual ~ActorBase() = default;
@@ -25,11 +30,46 @@ public:
     virtual Vector3d calculate_normal_at_hit(const Vector3d&) const = 0;
     virtual bool has_shadow() const = 0;
 
-    MyPixel pick_pixel(const Vector3d&, const Vector3d&) const;
+    // Flat actors lie in the plane through the origin of their basis,
+    // normal to vk
+    virtual bool is_planar() const;
+
+    // Any hit closer than the distance, used for shadow rays
+    virtual bool occludes(const Vector3d&, const Vector3d&, double) const;
+
+    // Shadow rays of the next frames end within the margin of this light,
+    // or of no particular point for nullptr. Compound actors may sort
+    // their parts by direction from it.
+    virtual void prepare_light(const Light*, double);
+
+    // Draws the actor for the primary visibility prepass, if it can be
+    // drawn as triangles or spheres
+    virtual void rasterize(VisibilityBuffer*) const;
+
+    // Animated actors move on to their next frame, returning false when
+    // they have no more. The world compiles its snapshot again after.
+    virtual bool is_animated() const;
+    virtual bool advance_frame();
+
+    // Returns false for actors without finite extent
+    virtual bool calculate_bounds(BoundingBox*) const = 0;
+
+    // Compound actors also report which of their parts was hit
+    virtual double solve_part_ray(const Vector3d&, const Vector3d&,
+                                  double, double, unsigned int*) const;
+    virtual Vector3d calculate_part_normal(const Vector3d&, unsigned int) const;
+
+    // Closest hits of the masked rays of a packet, which shortens the rays
+    // that hit. Returns those rays and sets their parts.
+    virtual unsigned int solve_packet_rays(RayPacket*, unsigned int, unsigned int*) const;
+    virtual MaterialId get_part_material(unsigned int) const;
+
+    // Textures are mapped in the local basis
+    const StandardBasis& get_local_basis() const;
 
 protected:
     StandardBasis local_basis_;
-    std::shared_ptr<TextureMapper> texture_mapper_;
+    MaterialId material_;
 };
 
 
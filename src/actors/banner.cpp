@@ -3,12 +3,12 @@
 #include <Eigen/Geometry>
 
 #include "actors/banner.h"
-#include "actors/sphere.h"
+#include "actors/batch.h"
 #include "actors/tools.h"
 
 #include "logger.h"
 #include "common.h"
-#include "mappers.h"
+#include "materials.h"
 
 
 namespace mrtp {
@@ -18,8 +18,7 @@ extern const unsigned char kCharacterData[];
 static void create_char3d(char c,
                           double char_scale,
                           const StandardBasis& char_basis,
-                          std::shared_ptr<TextureMapper> texture_mapper,
-                          std::vector<std::shared_ptr<ActorBase>>* actor_ptrs)
+                          std::vector<BatchSphere>* spheres)
 {
     if (c > 'a' && c < 'z') {
         c += ('A' - 'a');
@@ -36,20 +35,14 @@ static void create_char3d(char c,
 
                 Vector3d o_vec = ( (7 - j) * block_scale - (8 * block_scale / 2) + block_scale / 2 ) * char_basis.vj + ( (7 - i) * block_scale - (8 * block_scale / 2) + block_scale / 2 ) * char_basis.vk + char_basis.o;
 
-                StandardBasis sphere_basis;
-                sphere_basis.o = o_vec;
-
-                auto sphere_ptr = std::shared_ptr<ActorBase>(
-                    new SimpleSphere(sphere_basis, char_scale / 8 / 2, texture_mapper));
-
-                actor_ptrs->push_back(sphere_ptr);
+                spheres->push_back(BatchSphere{o_vec, char_scale / 8 / 2});
             }
         }
     }
 }
 
 
-void create_banner(TextureFactory* texture_factory,
+void create_banner(MaterialTable* materials,
                    std::shared_ptr<ConfigTable> items,
                    std::vector<std::shared_ptr<ActorBase>>* actor_ptrs)
 {
@@ -59,9 +52,8 @@ void create_banner(TextureFactory* texture_factory,
         return;
     }
 
-    std::shared_ptr<TextureMapper> banner_mapper =
-            create_dummy_mapper(items, "color", "reflect");
-    if (!banner_mapper) {
+    MaterialId material = 0;
+    if (!create_solid_material(materials, items, "color", "reflect", &material)) {
         return;
     }
 
@@ -91,6 +83,8 @@ void create_banner(TextureFactory* texture_factory,
     double char_scale = items->get_value("scale", 1);
     int char_idx = 0;
 
+    std::vector<BatchSphere> spheres;
+
     for (char c : banner_text) {
         Vector3d char_o_vec = banner_o_vec + (char_scale * char_idx - (banner_text.size() - 1) * char_scale / 2) * banner_j_vec;
         char_idx++;
@@ -98,8 +92,16 @@ void create_banner(TextureFactory* texture_factory,
         StandardBasis char_basis;
         set_basis(&char_basis, char_o_vec, char_i_vec, char_j_vec, char_k_vec);
 
-        create_char3d(c, char_scale, char_basis, banner_mapper, actor_ptrs);
+        create_char3d(c, char_scale, char_basis, &spheres);
     }
+
+    if (spheres.empty()) {
+        return;
+    }
+
+    actor_ptrs->push_back(std::make_shared<PrimitiveBatch>(
+            std::move(spheres), std::vector<BatchCylinder>(),
+            material, material));
 }
 
 
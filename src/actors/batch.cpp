@@ -0,0 +1,308 @@
+#include <Eigen/Geometry>
+
+#include <sstream>
+
+#include "logger.h"
+#include "raster.h"
+#include "actors/batch.h"
+#include "actors/cylinder.h"
+#include "actors/sphere.h"
+
+
+namespace mrtp {
+
+PrimitiveBatch::PrimitiveBatch(std::vector<BatchSphere>&& spheres,
+        std::vector<BatchCylinder>&& cylinders,
+        MaterialId sphere_material,
+        MaterialId cylinder_material) :
+    ActorBase(StandardBasis(), sphere_material),
+    spheres_(std::move(spheres)),
+    cylinders_(std::move(cylinders)),
+    cylinder_material_(cylinder_material)
+{
+    std::vector<BoundingBox> boxes;
+    boxes.reserve(get_num_parts());
+
+    for (unsigned int part = 0; part < get_num_parts(); part++) {
+        boxes.push_back(calculate_part_bounds(part));
+        bounds_.extend(boxes.back());
+    }
+
+    bvh_.build(boxes, kPacketWidth);
+
+    // Zero radius lanes never become candidates
+    unsigned int num_spheres = static_cast<unsigned int>(spheres_.size());
+    sphere_packets_.reserve(get_num_parts());
+    cylinder_packets_.reserve(get_num_parts());
+
+    for (unsigned int part : bvh_.get_order()) {
+        if (part < num_spheres) {
+            const BatchSphere& sphere = spheres_[part];
+            sphere_packets_.add(sphere.center, sphere.radius);
+            cylinder_packets_.add(Vector3d{0, 0, 0}, Vector3d{0, 0, 1}, 0, 0);
+        }
+        else {
+            const BatchCylinder& cylinder = cylinders_[part - num_spheres];
+            sphere_packets_.add(Vector3d{0, 0, 0}, 0);
+            cylinder_packets_.add(cylinder.center, cylinder.axis,
+                                  cylinder.radius, cylinder.span);
+        }
+    }
+
+    sphere_packets_.finish();
+    cylinder_packets_.finish();
+}
+
+
+bool PrimitiveBatch::has_shadow() const {
+    return true;
+}
+
+
+bool PrimitiveBatch::calculate_bounds(BoundingBox* box) const {
+    *box = bounds_;
+    return true;
+}
+
+
+// Only spheres are drawn, rays find the cylinders in front of them
+void PrimitiveBatch::rasterize(VisibilityBuffer* buffer) const {
+    for (unsigned int i = 0; i < spheres_.size(); i++) {
+        buffer->draw_sphere(spheres_[i].center, spheres_[i].radius, this, i);
+    }
+}
+
+
+unsigned int PrimitiveBatch::get_num_parts() const {
+    return static_cast<unsigned int>(spheres_.size() + cylinders_.size());
+}
+
+
+size_t PrimitiveBatch::get_memory_size() const {
+    return sizeof(PrimitiveBatch) +
+           spheres_.capacity() * sizeof(BatchSphere) +
+           cylinders_.capacity() * sizeof(BatchCylinder) +
+           sphere_packets_.get_memory_size() +
+           cylinder_packets_.get_memory_size() +
+           bvh_.get_memory_size() +
+           light_buffer_.get_memory_size();
+}
+
+
+BoundingBox PrimitiveBatch::calculate_part_bounds(unsigned int part) const {
+    BoundingBox box;
+
+    if (part < spheres_.size()) {
+        const BatchSphere& sphere = spheres_[part];
+        Vector3d r{sphere.radius, sphere.radius, sphere.radius};
+        box.lo = sphere.center - r;
+        box.hi = sphere.center + r;
+        return box;
+    }
+
+    const BatchCylinder& cylinder = cylinders_[part - spheres_.size()];
+    calculate_cylinder_bounds(cylinder.center, cylinder.axis,
+                              cylinder.radius, cylinder.span, &box);
+    return box;
+}
+
+
+// Closest hit in one leaf, which holds a sphere and a cylinder packet
+double PrimitiveBatch::solve_leaf(unsigned int first, unsigned int count,
+        const Vector3d& O, const Vector3d& D, const PacketRay& ray,
+        double min_dist, double max_dist, unsigned int* part) const
+{
+    const std::vector<unsigned int>& order = bvh_.get_order();
+    unsigned int num_spheres = static_cast<unsigned int>(spheres_.size());
+
+    double closest = find_closest_candidate(sphere_packets_, first, count, ray,
+                                            min_dist, max_dist,
+        [&](unsigned int position, double max_sphere_dist) {
+            const BatchSphere& sphere = spheres_[order[position]];
+            double distance = solve_sphere_ray(sphere.center, sphere.radius,
+                                               O, D, min_dist, max_sphere_dist);
+            if (distance > 0) {
+                *part = order[position];
+            }
+            return distance;
+        });
+
+    if (closest > 0) {
+        max_dist = closest;
+    }
+
+    double distance = find_closest_candidate(cylinder_packets_, first, count, ray,
+                                             min_dist, max_dist,
+        [&](unsigned int position, double max_cylinder_dist) {
+            const BatchCylinder& cylinder = cylinders_[order[position] - num_spheres];
+            double distance = solve_cylinder_ray(cylinder.center, cylinder.axis,
+                                                 cylinder.radius, cylinder.span,
+                                                 O, D, min_dist, max_cylinder_dist);
+            if (distance > 0 && distance < max_cylinder_dist) {
+                *part = order[position];
+            }
+            return distance;
+        });
+
+    return (distance > 0) ? distance : closest;
+}
+
+
+double PrimitiveBatch::solve_part_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist, unsigned int* part) const
+{
+    PacketRay ray(O, D);
+
+    return bvh_.find_closest_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            return solve_leaf(first, count, O, D, ray, min_dist, max_leaf_dist, part);
+        });
+}
+
+
+unsigned int PrimitiveBatch::solve_packet_rays(RayPacket* packet, unsigned int rays,
+        unsigned int* parts) const
+{
+    PacketRay packet_rays[RayPacket::kMaxRays];
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        packet_rays[i] = PacketRay(packet->get_origin(i), packet->get_direction(i));
+    }
+
+    return solve_packet_leaves(bvh_, packet, rays, parts,
+        [&](unsigned int i, unsigned int first, unsigned int count,
+            double max_dist, unsigned int* part) {
+            return solve_leaf(first, count, packet->get_origin(i), packet->get_direction(i),
+                              packet_rays[i], 0, max_dist, part);
+        });
+}
+
+
+double PrimitiveBatch::solve_light_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist) const
+{
+    unsigned int part = 0;
+    return solve_part_ray(O, D, min_dist, max_dist, &part);
+}
+
+
+bool PrimitiveBatch::occludes_part(unsigned int part, const Vector3d& O,
+        const Vector3d& D, double max_dist) const
+{
+    if (part < spheres_.size()) {
+        const BatchSphere& sphere = spheres_[part];
+        return solve_sphere_ray(sphere.center, sphere.radius, O, D, 0, max_dist) > 0;
+    }
+
+    const BatchCylinder& cylinder = cylinders_[part - spheres_.size()];
+    return solve_cylinder_ray(cylinder.center, cylinder.axis, cylinder.radius,
+                              cylinder.span, O, D, 0, max_dist) > 0;
+}
+
+
+void PrimitiveBatch::prepare_light(const Light* light, double margin)
+{
+    if (!light) {
+        light_buffer_ = LightBuffer();
+        return;
+    }
+
+    std::vector<BoundingBox> boxes;
+    boxes.reserve(get_num_parts());
+
+    for (unsigned int part = 0; part < get_num_parts(); part++) {
+        boxes.push_back(calculate_part_bounds(part));
+    }
+
+    light_buffer_.build(light->get_center(), boxes, margin);
+
+    std::stringstream convert;
+    convert << "Light buffer with " << light_buffer_.get_resolution()
+            << " cells per edge holds " << light_buffer_.get_num_entries()
+            << " entries for " << get_num_parts() << " parts";
+    LOG_DEBUG(convert.str());
+}
+
+
+bool PrimitiveBatch::occludes(const Vector3d& O, const Vector3d& D,
+        double max_dist) const
+{
+    // Rays to the light only meet the parts listed in their direction
+    if (light_buffer_.covers(O, D, max_dist)) {
+        return light_buffer_.find_any(O, [&](unsigned int part) {
+            return occludes_part(part, O, D, max_dist);
+        });
+    }
+
+    PacketRay ray(O, D);
+    const std::vector<unsigned int>& order = bvh_.get_order();
+    unsigned int num_spheres = static_cast<unsigned int>(spheres_.size());
+
+    return bvh_.find_any_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            return find_any_candidate(sphere_packets_, first, count, ray, max_leaf_dist,
+                    [&](unsigned int position, double max_sphere_dist) {
+                        const BatchSphere& sphere = spheres_[order[position]];
+                        return solve_sphere_ray(sphere.center, sphere.radius,
+                                                O, D, 0, max_sphere_dist) > 0;
+                    }) ||
+                find_any_candidate(cylinder_packets_, first, count, ray, max_leaf_dist,
+                    [&](unsigned int position, double max_cylinder_dist) {
+                        const BatchCylinder& cylinder =
+                                cylinders_[order[position] - num_spheres];
+                        return solve_cylinder_ray(cylinder.center, cylinder.axis,
+                                                  cylinder.radius, cylinder.span,
+                                                  O, D, 0, max_cylinder_dist) > 0;
+                    });
+        });
+}
+
+
+Vector3d PrimitiveBatch::calculate_part_normal(const Vector3d& hit, unsigned int part) const {
+    if (part < spheres_.size()) {
+        Vector3d t = hit - spheres_[part].center;
+        return t * (1 / t.norm());
+    }
+
+    const BatchCylinder& cylinder = cylinders_[part - spheres_.size()];
+    return calculate_cylinder_normal(cylinder.center, cylinder.axis, hit);
+}
+
+
+// Without a part index, use the primitive whose surface is closest to the hit
+Vector3d PrimitiveBatch::calculate_normal_at_hit(const Vector3d& hit) const {
+    unsigned int best_part = 0;
+    double best_dist = std::numeric_limits<double>::max();
+
+    for (unsigned int i = 0; i < spheres_.size(); i++) {
+        double d = std::abs((hit - spheres_[i].center).norm() - spheres_[i].radius);
+        if (d < best_dist) {
+            best_dist = d;
+            best_part = i;
+        }
+    }
+
+    for (unsigned int i = 0; i < cylinders_.size(); i++) {
+        const BatchCylinder& cylinder = cylinders_[i];
+        Vector3d v = hit - cylinder.center;
+        double alpha = v.dot(cylinder.axis);
+        if (alpha < -cylinder.span || alpha > cylinder.span) {
+            continue;
+        }
+
+        double d = std::abs((v - alpha * cylinder.axis).norm() - cylinder.radius);
+        if (d < best_dist) {
+            best_dist = d;
+            best_part = static_cast<unsigned int>(spheres_.size()) + i;
+        }
+    }
+
+    return calculate_part_normal(hit, best_part);
+}
+
+
+MaterialId PrimitiveBatch::get_part_material(unsigned int part) const {
+    return (part < spheres_.size()) ? material_ : cylinder_material_;
+}
+
+
+}
@@ -0,0 +1,93 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <memory>
+#include <vector>
+
+#include "actors.h"
+#include "bvh.h"
+#include "kernels.h"
+#include "lightbuffer.h"
+
+
+namespace mrtp {
+
+struct BatchSphere
+{
+    Vector3d center;
+    double radius;
+};
+
+
+struct BatchCylinder
+{
+    Vector3d center;
+    Vector3d axis;  // unit length
+    double radius;
+    double span;    // half length
+};
+
+
+/*
+Spheres and finite cylinders stored as one actor, as used for atoms and
+bonds of molecules and for the dots of banners. Both kinds share one
+hierarchy. Its leaves hold a sphere packet and a cylinder packet, where
+the lanes of the other kind are empty. Parts number the spheres first,
+then the cylinders.
+*/
+class PrimitiveBatch : public ActorBase
+{
+public:
+    PrimitiveBatch(std::vector<BatchSphere>&&, std::vector<BatchCylinder>&&,
+                   MaterialId, MaterialId);
+    PrimitiveBatch() = delete;
+
+    ~PrimitiveBatch() override = default;
+
+    double solve_light_ray(const Vector3d&, const Vector3d&,
+            double, double) const override;
+    double solve_part_ray(const Vector3d&, const Vector3d&,
+            double, double, unsigned int*) const override;
+    unsigned int solve_packet_rays(RayPacket*, unsigned int, unsigned int*) const override;
+
+    Vector3d calculate_normal_at_hit(const Vector3d&) const override;
+    Vector3d calculate_part_normal(const Vector3d&, unsigned int) const override;
+    MaterialId get_part_material(unsigned int) const override;
+
+    bool has_shadow() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
+    void prepare_light(const Light*, double) override;
+
+    unsigned int get_num_parts() const;
+    size_t get_memory_size() const;
+
+private:
+    double solve_leaf(unsigned int, unsigned int, const Vector3d&, const Vector3d&,
+                      const PacketRay&, double, double, unsigned int*) const;
+    bool occludes_part(unsigned int, const Vector3d&, const Vector3d&, double) const;
+    BoundingBox calculate_part_bounds(unsigned int) const;
+
+    std::vector<BatchSphere> spheres_;
+    std::vector<BatchCylinder> cylinders_;
+
+    // Indexed by position in the hierarchy order
+    SpherePackets sphere_packets_;
+    CylinderPackets cylinder_packets_;
+
+    BoundingVolumeHierarchy bvh_;
+
+    // Parts by direction from the light, for shadow rays
+    LightBuffer light_buffer_;
+
+    BoundingBox bounds_;
+
+    // Spheres use the material of the base class
+    MaterialId cylinder_material_;
+};
+
+}
+
+#endif // BATCH_H
@@ -11,7 +11,7 @@
 
 namespace mrtp {
 
-void create_cube(TextureFactory* texture_factory,
+void create_cube(MaterialTable* materials,
                  std::shared_ptr<ConfigTable> cube_items,
                  std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
@@ -25,8 +25,8 @@ void create_cube(TextureFactory* texture_factory,
 
     double cube_scale = cube_items->get_value("scale", 1) / 2;
 
-    auto texture_mapper = create_dummy_mapper(cube_items, "color", "reflect");
-    if (!texture_mapper) {
+    MaterialId material = 0;
+    if (!create_solid_material(materials, cube_items, "color", "reflect", &material)) {
         return;
     }
 
@@ -70,17 +70,17 @@ void create_cube(TextureFactory* texture_factory,
     set_basis(&face_f_basis, face_f_o, -cube_vec_k, cube_vec_i, -cube_vec_j);
 
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_a_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_a_basis, material, cube_scale, cube_scale)));
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_b_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_b_basis, material, cube_scale, cube_scale)));
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_c_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_c_basis, material, cube_scale, cube_scale)));
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_d_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_d_basis, material, cube_scale, cube_scale)));
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_e_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_e_basis, material, cube_scale, cube_scale)));
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                              new SimplePolygon(face_f_basis, texture_mapper, cube_scale, cube_scale)));
+                              new SimplePolygon(face_f_basis, material, cube_scale, cube_scale)));
 }
 
 
@@ -1,5 +1,8 @@
 #include <Eigen/Geometry>
 
+#include <algorithm>
+#include <cmath>
+
 #include "logger.h"
 
 #include "actors/tools.h"
@@ -9,8 +12,8 @@
 namespace mrtp {
 
 SimpleCylinder::SimpleCylinder(const StandardBasis& local_basis, double radius, 
-        double length, std::shared_ptr<TextureMapper> texture_mapper_ptr) : 
-    ActorBase(local_basis, texture_mapper_ptr), 
+        double length, MaterialId material) : 
+    ActorBase(local_basis, material), 
     radius_(radius), length_(length) 
 {
 }
@@ -21,6 +24,32 @@ bool SimpleCylinder::has_shadow() const {
 }
 
 
+void calculate_cylinder_bounds(const Vector3d& center, const Vector3d& axis,
+        double radius, double length, BoundingBox* box)
+{
+    // Extent of the axis segment plus the disc radius projected on each axis
+    Vector3d extent;
+    for (int i = 0; i < 3; i++) {
+        double k = axis[i];
+        extent[i] = length * std::abs(k) + radius * std::sqrt(std::max(0.0, 1 - k * k));
+    }
+
+    box->lo = center - extent;
+    box->hi = center + extent;
+}
+
+
+bool SimpleCylinder::calculate_bounds(BoundingBox* box) const {
+    // Cylinders without span are infinite
+    if (length_ <= 0) {
+        return false;
+    }
+
+    calculate_cylinder_bounds(local_basis_.o, local_basis_.vk, radius_, length_, box);
+    return true;
+}
+
+
 /*
 Capital letters are vectors.
   A       Origin    of cylinder
@@ -51,15 +80,16 @@ Capital letters are vectors.
  alpha = d + t * b
 */
 
-double SimpleCylinder::solve_light_ray(const Vector3d& O, const Vector3d& D, 
-        double min_dist, double max_dist) const
+double solve_cylinder_ray(const Vector3d& center, const Vector3d& axis,
+        double radius, double length, const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist)
 {
-    Vector3d vec = O - local_basis_.o;
+    Vector3d vec = O - center;
 
     double a = D.dot(vec);
-    double b = D.dot(local_basis_.vk);
-    double d = vec.dot(local_basis_.vk);
-    double f = radius_ * radius_ - vec.dot(vec);
+    double b = D.dot(axis);
+    double d = vec.dot(axis);
+    double f = radius * radius - vec.dot(vec);
 
     // Solving quadratic equation for t
     double aa = 1 - (b * b);
@@ -71,9 +101,9 @@ double SimpleCylinder::solve_light_ray(const Vector3d& O, const Vector3d& D,
         return -1;
     }
     // Check if cylinder is finite
-    if (length_ > 0) {
+    if (length > 0) {
         double alpha = d + t * b;
-        if (alpha < -length_ || alpha > length_) {
+        if (alpha < -length || alpha > length) {
             return -1;
         }
     }
@@ -82,21 +112,36 @@ double SimpleCylinder::solve_light_ray(const Vector3d& O, const Vector3d& D,
 }
 
 
-Vector3d SimpleCylinder::calculate_normal_at_hit(const Vector3d& hit) const
+double SimpleCylinder::solve_light_ray(const Vector3d& O, const Vector3d& D, 
+        double min_dist, double max_dist) const
+{
+    return solve_cylinder_ray(local_basis_.o, local_basis_.vk, radius_, length_,
+                              O, D, min_dist, max_dist);
+}
+
+
+Vector3d calculate_cylinder_normal(const Vector3d& center, const Vector3d& axis,
+        const Vector3d& hit)
 {
     // N = Hit - [B . (Hit - A)] * B
-    Vector3d v = hit - local_basis_.o;
+    Vector3d v = hit - center;
     
-    double alpha = local_basis_.vk.dot(v);
+    double alpha = axis.dot(v);
     
-    Vector3d w = local_basis_.o + alpha * local_basis_.vk;
+    Vector3d w = center + alpha * axis;
     Vector3d normal = hit - w;
 
     return normal * (1 / normal.norm());
 }
 
 
-void create_cylinder(TextureFactory* texture_factory,
+Vector3d SimpleCylinder::calculate_normal_at_hit(const Vector3d& hit) const
+{
+    return calculate_cylinder_normal(local_basis_.o, local_basis_.vk, hit);
+}
+
+
+void create_cylinder(MaterialTable* materials,
                      std::shared_ptr<ConfigTable> cylinder_items,
                      std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
@@ -128,9 +173,8 @@ void create_cylinder(TextureFactory* texture_factory,
     set_basis(&cylinder_basis, cylinder_center_vec, cylinder_vec_i,
               cylinder_vec_j, cylinder_direction_vec);
 
-    auto texture_mapper_ptr = create_texture_mapper(
-                cylinder_items, ActorType::Cylinder, texture_factory);
-    if (!texture_mapper_ptr) {
+    MaterialId material = 0;
+    if (!create_material(materials, cylinder_items, ActorType::Cylinder, &material)) {
         return;
     }
 
@@ -138,7 +182,7 @@ void create_cylinder(TextureFactory* texture_factory,
         cylinder_basis,
         cylinder_radius,
         cylinder_span,
-        texture_mapper_ptr
+        material
     ));
 
     actor_ptrs->push_back(cylinder_ptr);
@@ -11,7 +11,7 @@ class SimpleCylinder : public ActorBase
 {
 public:
     SimpleCylinder(const StandardBasis&, 
-            double, double, std::shared_ptr<TextureMapper>);
+            double, double, MaterialId);
 
     SimpleCylinder() = delete;
     ~SimpleCylinder() override = default;
@@ -21,6 +21,7 @@ public:
 
     Vector3d calculate_normal_at_hit(const Vector3d&) const override;
     bool has_shadow() const override;
+    bool calculate_bounds(BoundingBox*) const override;
 
 private:
     double radius_;
@@ -28,7 +29,16 @@ private:
 };
 
 
-void create_cylinder(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
+// Nearest root of a ray and a cylinder, shared with batched actors
+double solve_cylinder_ray(const Vector3d&, const Vector3d&, double, double,
+                          const Vector3d&, const Vector3d&, double, double);
+
+Vector3d calculate_cylinder_normal(const Vector3d&, const Vector3d&, const Vector3d&);
+
+void calculate_cylinder_bounds(const Vector3d&, const Vector3d&, double, double,
+                               BoundingBox*);
+
+void create_cylinder(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
 
 }
 
@@ -0,0 +1,137 @@
+#include <cctype>
+
+#include "actors/elements.h"
+
+
+namespace mrtp {
+
+// By atomic number, up to uranium
+static const ElementInfo kElements[] = {
+    {"X",  255,  20, 147, 0.75f},
+    {"H",  255, 255, 255, 0.31f},
+    {"He", 217, 255, 255, 0.28f},
+    {"Li", 204, 128, 255, 1.28f},
+    {"Be", 194, 255,   0, 0.96f},
+    {"B",  255, 181, 181, 0.84f},
+    {"C",  144, 144, 144, 0.76f},
+    {"N",   48,  80, 248, 0.71f},
+    {"O",  255,  13,  13, 0.66f},
+    {"F",  144, 224,  80, 0.57f},
+    {"Ne", 179, 227, 245, 0.58f},
+    {"Na", 171,  92, 242, 1.66f},
+    {"Mg", 138, 255,   0, 1.41f},
+    {"Al", 191, 166, 166, 1.21f},
+    {"Si", 240, 200, 160, 1.11f},
+    {"P",  255, 128,   0, 1.07f},
+    {"S",  255, 255,  48, 1.05f},
+    {"Cl",  31, 240,  31, 1.02f},
+    {"Ar", 128, 209, 227, 1.06f},
+    {"K",  143,  64, 212, 2.03f},
+    {"Ca",  61, 255,   0, 1.76f},
+    {"Sc", 230, 230, 230, 1.70f},
+    {"Ti", 191, 194, 199, 1.60f},
+    {"V",  166, 166, 171, 1.53f},
+    {"Cr", 138, 153, 199, 1.39f},
+    {"Mn", 156, 122, 199, 1.39f},
+    {"Fe", 224, 102,  51, 1.32f},
+    {"Co", 240, 144, 160, 1.26f},
+    {"Ni",  80, 208,  80, 1.24f},
+    {"Cu", 200, 128,  51, 1.32f},
+    {"Zn", 125, 128, 176, 1.22f},
+    {"Ga", 194, 143, 143, 1.22f},
+    {"Ge", 102, 143, 143, 1.20f},
+    {"As", 189, 128, 227, 1.19f},
+    {"Se", 255, 161,   0, 1.20f},
+    {"Br", 166,  41,  41, 1.20f},
+    {"Kr",  92, 184, 209, 1.16f},
+    {"Rb", 112,  46, 176, 2.20f},
+    {"Sr",   0, 255,   0, 1.95f},
+    {"Y",  148, 255, 255, 1.90f},
+    {"Zr", 148, 224, 224, 1.75f},
+    {"Nb", 115, 194, 201, 1.64f},
+    {"Mo",  84, 181, 181, 1.54f},
+    {"Tc",  59, 158, 158, 1.47f},
+    {"Ru",  36, 143, 143, 1.46f},
+    {"Rh",  10, 125, 140, 1.42f},
+    {"Pd",   0, 105, 133, 1.39f},
+    {"Ag", 192, 192, 192, 1.45f},
+    {"Cd", 255, 217, 143, 1.44f},
+    {"In", 166, 117, 115, 1.42f},
+    {"Sn", 102, 128, 128, 1.39f},
+    {"Sb", 158,  99, 181, 1.39f},
+    {"Te", 212, 122,   0, 1.38f},
+    {"I",  148,   0, 148, 1.39f},
+    {"Xe",  66, 158, 176, 1.40f},
+    {"Cs",  87,  23, 143, 2.44f},
+    {"Ba",   0, 201,   0, 2.15f},
+    {"La", 112, 212, 255, 2.07f},
+    {"Ce", 255, 255, 199, 2.04f},
+    {"Pr", 217, 255, 199, 2.03f},
+    {"Nd", 199, 255, 199, 2.01f},
+    {"Pm", 163, 255, 199, 1.99f},
+    {"Sm", 143, 255, 199, 1.98f},
+    {"Eu",  97, 255, 199, 1.98f},
+    {"Gd",  69, 255, 199, 1.96f},
+    {"Tb",  48, 255, 199, 1.94f},
+    {"Dy",  31, 255, 199, 1.92f},
+    {"Ho",   0, 255, 156, 1.92f},
+    {"Er",   0, 230, 117, 1.89f},
+    {"Tm",   0, 212,  82, 1.90f},
+    {"Yb",   0, 191,  56, 1.87f},
+    {"Lu",   0, 171,  36, 1.87f},
+    {"Hf",  77, 194, 255, 1.75f},
+    {"Ta",  77, 166, 255, 1.70f},
+    {"W",   33, 148, 214, 1.62f},
+    {"Re",  38, 125, 171, 1.51f},
+    {"Os",  38, 102, 150, 1.44f},
+    {"Ir",  23,  84, 135, 1.41f},
+    {"Pt", 208, 208, 224, 1.36f},
+    {"Au", 255, 209,  35, 1.36f},
+    {"Hg", 184, 184, 208, 1.32f},
+    {"Tl", 166,  84,  77, 1.45f},
+    {"Pb",  87,  89,  97, 1.46f},
+    {"Bi", 158,  79, 181, 1.48f},
+    {"Po", 171,  92,   0, 1.40f},
+    {"At", 117,  79,  69, 1.50f},
+    {"Rn",  66, 130, 150, 1.50f},
+    {"Fr",  66,   0, 102, 2.60f},
+    {"Ra",   0, 125,   0, 2.21f},
+    {"Ac", 112, 171, 250, 2.15f},
+    {"Th",   0, 186, 255, 2.06f},
+    {"Pa",   0, 161, 255, 2.00f},
+    {"U",    0, 143, 255, 1.96f}
+};
+
+static const unsigned int kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+
+unsigned int find_element(std::string_view symbol)
+{
+    for (unsigned int i = 1; i < kNumElements; i++) {
+        const char* s = kElements[i].symbol;
+        size_t n = 0;
+        while (s[n] && n < symbol.size() &&
+               std::tolower(static_cast<unsigned char>(s[n])) ==
+               std::tolower(static_cast<unsigned char>(symbol[n]))) {
+            n++;
+        }
+        if (!s[n] && n == symbol.size()) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+
+const ElementInfo& get_element_info(unsigned int element)
+{
+    return kElements[(element < kNumElements) ? element : 0];
+}
+
+
+unsigned int get_num_elements()
+{
+    return kNumElements;
+}
+
+}
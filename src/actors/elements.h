@@ -0,0 +1,34 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <string_view>
+
+
+namespace mrtp {
+
+/*
+Chemical elements met in molecule files, with the colors of the Jmol
+scheme for atoms of scenes which do not set one, and the covalent radii
+in angstroms which bonds are guessed from. Entry 0 stands for any element
+missing from the table.
+*/
+struct ElementInfo
+{
+    const char* symbol;
+    unsigned char red;
+    unsigned char green;
+    unsigned char blue;
+    float covalent_radius;
+};
+
+
+// Symbols match in any case, unknown symbols give 0
+unsigned int find_element(std::string_view);
+
+const ElementInfo& get_element_info(unsigned int);
+
+unsigned int get_num_elements();
+
+}
+
+#endif // ELEMENTS_H
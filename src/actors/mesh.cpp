@@ -1,6 +1,9 @@
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -12,16 +15,240 @@
 #endif
 
 #include "logger.h"
+#include "raster.h"
 
 #include "actors/mesh.h"
 #include "actors/tools.h"
-#include "actors/triangle.h"
 
 using Vector3d = Eigen::Vector3d;
 
 
 namespace mrtp {
 
+TriangleMesh::TriangleMesh(std::vector<Eigen::Vector3f>&& vertices,
+        std::vector<std::uint32_t>&& indices,
+        MaterialId material) :
+    ActorBase(StandardBasis(), material),
+    vertices_(std::move(vertices)),
+    indices_(std::move(indices))
+{
+    unsigned int num_faces = get_num_faces();
+
+    std::vector<BoundingBox> boxes(num_faces);
+    for (unsigned int i = 0; i < num_faces; i++) {
+        for (unsigned int k = 0; k < 3; k++) {
+            boxes[i].extend(vertices_[indices_[3 * i + k]].cast<double>());
+        }
+        bounds_.extend(boxes[i]);
+    }
+
+    bvh_.build(boxes, kPacketWidth);
+
+    // Store faces in leaf order
+    std::vector<std::uint32_t> sorted_indices;
+    sorted_indices.reserve(indices_.size());
+
+    for (unsigned int face : bvh_.get_order()) {
+        for (unsigned int k = 0; k < 3; k++) {
+            sorted_indices.push_back(indices_[3 * face + k]);
+        }
+    }
+    indices_.swap(sorted_indices);
+
+    packets_.reserve(num_faces);
+    for (unsigned int i = 0; i < num_faces; i++) {
+        packets_.add(vertices_[indices_[3 * i]],
+                     vertices_[indices_[3 * i + 1]],
+                     vertices_[indices_[3 * i + 2]]);
+    }
+    packets_.finish();
+}
+
+
+bool TriangleMesh::has_shadow() const {
+    return true;
+}
+
+
+bool TriangleMesh::calculate_bounds(BoundingBox* box) const {
+    *box = bounds_;
+    return true;
+}
+
+
+// Faces keep their hierarchy order, which is their part index
+void TriangleMesh::rasterize(VisibilityBuffer* buffer) const {
+    for (unsigned int face = 0; face < get_num_faces(); face++) {
+        const std::uint32_t* index = &indices_[3 * face];
+        buffer->draw_triangle(vertices_[index[0]].cast<double>(),
+                              vertices_[index[1]].cast<double>(),
+                              vertices_[index[2]].cast<double>(),
+                              this, face);
+    }
+}
+
+
+unsigned int TriangleMesh::get_num_faces() const {
+    return static_cast<unsigned int>(indices_.size() / 3);
+}
+
+
+size_t TriangleMesh::get_memory_size() const {
+    return sizeof(TriangleMesh) +
+           vertices_.capacity() * sizeof(Eigen::Vector3f) +
+           indices_.capacity() * sizeof(std::uint32_t) +
+           packets_.get_memory_size() +
+           bvh_.get_memory_size();
+}
+
+
+// Moller-Trumbore test, the face interior excludes its edges
+double TriangleMesh::intersect_face(unsigned int face,
+        const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist) const
+{
+    const std::uint32_t* index = &indices_[3 * face];
+    Vector3d A = vertices_[index[0]].cast<double>();
+    Vector3d E1 = vertices_[index[1]].cast<double>() - A;
+    Vector3d E2 = vertices_[index[2]].cast<double>() - A;
+
+    // det is D.(E2 x E1), so the cutoff scales with the face as the old
+    // test of D against the unit normal did
+    Vector3d P = D.cross(E2);
+    double det = E1.dot(P);
+    double min_det = kMyZero * E1.cross(E2).norm();
+    if (det <= min_det && det >= -min_det) {
+        return -1;
+    }
+
+    double inv_det = 1 / det;
+    Vector3d T = O - A;
+
+    double u = T.dot(P) * inv_det;
+    if (u <= 0 || u >= 1) {
+        return -1;
+    }
+
+    Vector3d Q = T.cross(E1);
+    double v = D.dot(Q) * inv_det;
+    if (v <= 0 || u + v >= 1) {
+        return -1;
+    }
+
+    double t = E2.dot(Q) * inv_det;
+    if (t > min_dist && t < max_dist) {
+        return t;
+    }
+
+    return -1;
+}
+
+
+// Candidates of the packet kernel are confirmed with the exact test
+double TriangleMesh::solve_leaf(unsigned int first, unsigned int count,
+        const Vector3d& O, const Vector3d& D, const PacketRay& ray,
+        double min_dist, double max_dist, unsigned int* part) const
+{
+    return find_closest_candidate(packets_, first, count, ray, min_dist, max_dist,
+        [&](unsigned int face, double max_face_dist) {
+            double distance = intersect_face(face, O, D, min_dist, max_face_dist);
+            if (distance > 0) {
+                *part = face;
+            }
+            return distance;
+        });
+}
+
+
+double TriangleMesh::solve_part_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist, unsigned int* part) const
+{
+    PacketRay ray(O, D);
+    unsigned int hit_face = 0;
+
+    double t = bvh_.find_closest_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            return solve_leaf(first, count, O, D, ray, min_dist, max_leaf_dist, &hit_face);
+        });
+
+    if (t > 0) {
+        *part = hit_face;
+        return t;
+    }
+
+    return -1;
+}
+
+
+unsigned int TriangleMesh::solve_packet_rays(RayPacket* packet, unsigned int rays,
+        unsigned int* parts) const
+{
+    PacketRay packet_rays[RayPacket::kMaxRays];
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        packet_rays[i] = PacketRay(packet->get_origin(i), packet->get_direction(i));
+    }
+
+    return solve_packet_leaves(bvh_, packet, rays, parts,
+        [&](unsigned int i, unsigned int first, unsigned int count,
+            double max_dist, unsigned int* part) {
+            return solve_leaf(first, count, packet->get_origin(i), packet->get_direction(i),
+                              packet_rays[i], 0, max_dist, part);
+        });
+}
+
+
+double TriangleMesh::solve_light_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist) const
+{
+    unsigned int part = 0;
+    return solve_part_ray(O, D, min_dist, max_dist, &part);
+}
+
+
+bool TriangleMesh::occludes(const Vector3d& O, const Vector3d& D,
+        double max_dist) const
+{
+    PacketRay ray(O, D);
+
+    return bvh_.find_any_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            return find_any_candidate(packets_, first, count, ray, max_leaf_dist,
+                [&](unsigned int face, double max_face_dist) {
+                    return intersect_face(face, O, D, 0, max_face_dist) > 0;
+                });
+        });
+}
+
+
+Vector3d TriangleMesh::calculate_part_normal(const Vector3d&, unsigned int part) const {
+    const std::uint32_t* index = &indices_[3 * part];
+    Vector3d A = vertices_[index[0]].cast<double>();
+    Vector3d B = vertices_[index[1]].cast<double>();
+    Vector3d C = vertices_[index[2]].cast<double>();
+
+    Vector3d N = (B - A).cross(C - B);
+    return N * (1 / N.norm());
+}
+
+
+// Without a part index, use the face whose plane passes closest to the hit
+Vector3d TriangleMesh::calculate_normal_at_hit(const Vector3d& hit) const {
+    unsigned int best_face = 0;
+    double best_dist = std::numeric_limits<double>::max();
+
+    for (unsigned int i = 0; i < get_num_faces(); i++) {
+        Vector3d N = calculate_part_normal(hit, i);
+        double d = std::abs((hit - vertices_[indices_[3 * i]].cast<double>()).dot(N));
+        if (d < best_dist) {
+            best_dist = d;
+            best_face = i;
+        }
+    }
+
+    return calculate_part_normal(hit, best_face);
+}
+
+
 #ifdef USE_LIB3DS
 class File3dsWrapper
 {
@@ -49,11 +276,12 @@ public:
 
 static void load_node_r(Lib3dsFile* libfile,
                         Lib3dsNode* node,
-                        std::vector<Vector3d>* vertex_list)
+                        std::vector<Eigen::Vector3f>* vertices,
+                        std::vector<std::uint32_t>* indices)
 {
     Lib3dsNode* p = node->childs;
     while (p != nullptr) {
-        load_node_r(libfile, p, vertex_list);
+        load_node_r(libfile, p, vertices, indices);
         p = p->next;
     }
 
@@ -68,22 +296,28 @@ static void load_node_r(Lib3dsFile* libfile,
             return;
         }
 
+        std::uint32_t first_vertex = static_cast<std::uint32_t>(vertices->size());
+
+        for (unsigned p = 0; p < mesh->points; p++) {
+            vertices->push_back(Eigen::Vector3f{ mesh->pointL[p].pos[0],
+                                                 mesh->pointL[p].pos[1],
+                                                 mesh->pointL[p].pos[2] });
+        }
+
         for (unsigned p = 0; p < mesh->faces; p++) {
             Lib3dsFace* face = &mesh->faceL[p];
 
             for (int i = 0; i < 3; i++) {
-                Vector3d V{ static_cast<double>(mesh->pointL[face->points[i]].pos[0]),
-                            static_cast<double>(mesh->pointL[face->points[i]].pos[1]),
-                            static_cast<double>(mesh->pointL[face->points[i]].pos[2]) };
-
-                vertex_list->push_back(V);
+                indices->push_back(first_vertex + face->points[i]);
             }
         }
     }
 }
 
 
-static int load_3ds_file(const std::string& filename, std::vector<Vector3d>* vertex_list)
+static int load_3ds_file(const std::string& filename,
+                         std::vector<Eigen::Vector3f>* vertices,
+                         std::vector<std::uint32_t>* indices)
 {
     File3dsWrapper filewrap(filename);
     if (filewrap.is_failed()) {
@@ -92,7 +326,7 @@ static int load_3ds_file(const std::string& filename, std::vector<Vector3d>* ver
 
     Lib3dsNode* node = filewrap.libfile->nodes;
     while (node != nullptr) {
-        load_node_r(filewrap.libfile, node, vertex_list);
+        load_node_r(filewrap.libfile, node, vertices, indices);
         node = node->next;
     }
 
@@ -100,7 +334,9 @@ static int load_3ds_file(const std::string& filename, std::vector<Vector3d>* ver
 }
 #endif  // USE_LIB3DS
 
-static void load_custom_file(const std::string& filename, std::vector<Vector3d>* vertex_list)
+static void load_custom_file(const std::string& filename,
+                             std::vector<Eigen::Vector3f>* vertices,
+                             std::vector<std::uint32_t>* indices)
 {
     struct TriangleFace
     {
@@ -123,9 +359,8 @@ static void load_custom_file(const std::string& filename, std::vector<Vector3d>*
 
             static_assert(sizeof(Eigen::Vector3f) == 12, "Vector3f is not 12 bytes");
 
-            std::vector<Eigen::Vector3f> tmp_vertex_list;
-            tmp_vertex_list.resize(num_vertices);
-            f.read(static_cast<char *>(static_cast<void *>(tmp_vertex_list.data())), sizeof(Eigen::Vector3f) * num_vertices);
+            vertices->resize(num_vertices);
+            f.read(static_cast<char *>(static_cast<void *>(vertices->data())), sizeof(Eigen::Vector3f) * num_vertices);
 
             std::vector<TriangleFace> faces_list;
             faces_list.resize(num_faces);
@@ -133,17 +368,11 @@ static void load_custom_file(const std::string& filename, std::vector<Vector3d>*
 
             f.close();
 
+            indices->reserve(3 * faces_list.size());
             for (const TriangleFace& face : faces_list) {
-                Eigen::Vector3f v;
-
-                v << tmp_vertex_list[face.a];
-                vertex_list->push_back(v.cast<double>());
-
-                v << tmp_vertex_list[face.b];
-                vertex_list->push_back(v.cast<double>());
-
-                v << tmp_vertex_list[face.c];
-                vertex_list->push_back(v.cast<double>());
+                indices->push_back(face.a);
+                indices->push_back(face.b);
+                indices->push_back(face.c);
             }
 
             // Debug info
@@ -161,7 +390,7 @@ static void load_custom_file(const std::string& filename, std::vector<Vector3d>*
 }
 
 
-void create_mesh(TextureFactory* texture_factory,
+void create_mesh(MaterialTable* materials,
                  std::shared_ptr<ConfigTable> items,
                  std::vector<std::shared_ptr<ActorBase>>* actor_ptrs)
 {
@@ -177,22 +406,22 @@ void create_mesh(TextureFactory* texture_factory,
         return;
     }
 
-    std::shared_ptr<TextureMapper> texture_mapper_ptr = create_dummy_mapper(
-                items, "color", "reflect");
-    if (!texture_mapper_ptr) {
+    MaterialId material = 0;
+    if (!create_solid_material(materials, items, "color", "reflect", &material)) {
         return;
     }
 
     size_t idx = filename.rfind(".");
     std::string ext = filename.substr(idx + 1, filename.length() - idx - 1);
-    std::vector<Vector3d> vertex_list;
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<std::uint32_t> indices;
 
     if (ext == "3d") {
-        load_custom_file(filename, &vertex_list);
+        load_custom_file(filename, &vertices, &indices);
     }
 #ifdef USE_LIB3DS
     else if (ext == "3ds") {
-        if (!load_3ds_file(filename, &vertex_list)) {
+        if (!load_3ds_file(filename, &vertices, &indices)) {
             LOG_ERROR("Error reading mesh file");
             return;
         }
@@ -203,69 +432,56 @@ void create_mesh(TextureFactory* texture_factory,
         return;
     }
 
-    if (vertex_list.empty()) {
+    if (indices.empty()) {
         LOG_ERROR("No triangles found");
         return;
     }
 
-    // Translate model to 0, 0, 0
-    Vector3d vec_o;
-
-    for (const Vector3d& v : vertex_list) {
-        vec_o += v;
+    for (std::uint32_t index : indices) {
+        if (index >= vertices.size()) {
+            LOG_ERROR("Mesh face refers to a missing vertex");
+            return;
+        }
     }
-    vec_o /= vertex_list.size();
 
-    for (Vector3d& v : vertex_list) {
-        v -= vec_o;
+    // Translate model to 0, 0, 0, weighting vertices by the faces using them
+    Vector3d vec_o{0, 0, 0};
+
+    for (std::uint32_t index : indices) {
+        vec_o += vertices[index].cast<double>();
     }
+    vec_o /= indices.size();
 
     // Normalize model
     double max_d = 0;
 
-    for (const Vector3d& v : vertex_list) {
-        double d = v.norm();
+    for (std::uint32_t index : indices) {
+        double d = (vertices[index].cast<double>() - vec_o).norm();
         if (d > max_d) {
             max_d = d;
         }
     }
 
-    for (Vector3d& v : vertex_list) {
-        v /= max_d;
-    }
-
     // Rotate, scale, and translate model to center
     Eigen::Matrix3d m_rot = create_rotation_matrix(items);
 
     double mesh_scale = items->get_value("scale", 1);
 
-    for (Vector3d& v : vertex_list) {
-        v = mesh_scale * (m_rot * v) + mesh_vec_o;
+    for (Eigen::Vector3f& v : vertices) {
+        Vector3d w = (v.cast<double>() - vec_o) / max_d;
+        w = mesh_scale * (m_rot * w) + mesh_vec_o;
+        v = w.cast<float>();
     }
 
-    // Create triangles
-    for (size_t i = 0; i < vertex_list.size() / 3; i++) {
-        Vector3d A{vertex_list[i * 3]};
-        Vector3d B{vertex_list[i * 3 + 1]};
-        Vector3d C{vertex_list[i * 3 + 2]};
-
-        Vector3d vec_o = (A + B + C) / 3;
-        Vector3d vec_i = B - A;
-        Vector3d vec_k = vec_i.cross(C - B);
-        Vector3d vec_j = vec_k.cross(vec_i);
+    auto mesh_ptr = std::make_shared<TriangleMesh>(
+                std::move(vertices), std::move(indices), material);
 
-        vec_i *= (1 / vec_i.norm());
-        vec_j *= (1 / vec_j.norm());
-        vec_k *= (1 / vec_k.norm());
+    std::stringstream convert;
+    convert << "Mesh uses " << mesh_ptr->get_memory_size() / mesh_ptr->get_num_faces()
+            << " bytes per face";
+    LOG_DEBUG(convert.str());
 
-        StandardBasis local_basis;
-        set_basis(&local_basis, vec_o, vec_i, vec_j, vec_k);
-
-        std::shared_ptr<ActorBase> triangle_ptr = std::shared_ptr<ActorBase>(
-                    new SimpleTriangle(local_basis, A, B, C, texture_mapper_ptr));
-
-        actor_ptrs->push_back(triangle_ptr);
-    }
+    actor_ptrs->push_back(mesh_ptr);
 }
 
 
@@ -1,17 +1,69 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include <Eigen/Core>
+
 #include "config.h"
 #include "actors.h"
+#include "bvh.h"
+#include "kernels.h"
 #include "texture.h"
 
 
 namespace mrtp {
 
-void create_mesh(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
+/*
+Triangle mesh stored as one actor. Vertices are kept once in single
+precision and faces refer to them by index. Rays are tested against an
+internal hierarchy and the hit face is reported as the part index.
+Faces are sorted in hierarchy order, so every leaf is a run of faces
+that the packet kernel tests at once.
+*/
+class TriangleMesh : public ActorBase
+{
+public:
+    TriangleMesh(std::vector<Eigen::Vector3f>&&, std::vector<std::uint32_t>&&,
+                 MaterialId);
+    TriangleMesh() = delete;
+
+    ~TriangleMesh() override = default;
+
+    double solve_light_ray(const Vector3d&, const Vector3d&,
+            double, double) const override;
+    double solve_part_ray(const Vector3d&, const Vector3d&,
+            double, double, unsigned int*) const override;
+    unsigned int solve_packet_rays(RayPacket*, unsigned int, unsigned int*) const override;
+
+    Vector3d calculate_normal_at_hit(const Vector3d&) const override;
+    Vector3d calculate_part_normal(const Vector3d&, unsigned int) const override;
+
+    bool has_shadow() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
+
+    unsigned int get_num_faces() const;
+    size_t get_memory_size() const;
+
+private:
+    double solve_leaf(unsigned int, unsigned int, const Vector3d&, const Vector3d&,
+                      const PacketRay&, double, double, unsigned int*) const;
+    double intersect_face(unsigned int, const Vector3d&, const Vector3d&,
+                          double, double) const;
+
+    std::vector<Eigen::Vector3f> vertices_;
+    std::vector<std::uint32_t> indices_;  // three per face
+    TrianglePackets packets_;
+    BoundingVolumeHierarchy bvh_;
+    BoundingBox bounds_;
+};
+
+void create_mesh(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
 
 }
 
@@ -1,95 +1,677 @@
 #include <Eigen/Geometry>
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <iostream>
 
 #include "actors/molecule.h"
 #include "actors/cylinder.h"
+#include "actors/elements.h"
 #include "actors/sphere.h"
 #include "actors/tools.h"
 
 #include "logger.h"
+#include "raster.h"
+#include "stats.h"
 
 
 namespace mrtp {
 
-static std::vector<std::string> tokenize_line(const std::string& line)
+// Share of the extent of a moving molecule added around its grid
+static const double kTrajectorySlack = 0.1;
+
+
+MoleculeActor::MoleculeActor(std::vector<Eigen::Vector3f>&& positions,
+        std::vector<float>&& radii,
+        std::vector<std::uint8_t>&& elements,
+        std::vector<MoleculeBond>&& bonds,
+        double bond_radius,
+        std::vector<MaterialId>&& element_materials,
+        MaterialId bond_material) :
+    ActorBase(StandardBasis(), bond_material),
+    positions_(std::move(positions)),
+    radii_(std::move(radii)),
+    elements_(std::move(elements)),
+    bonds_(std::move(bonds)),
+    bond_radius_(bond_radius),
+    element_materials_(std::move(element_materials)),
+    bond_material_(bond_material)
 {
-    std::vector<std::string> tokens;
-    std::istringstream str(line);
-    std::string token("");
+    std::vector<BoundingBox> boxes;
+    calculate_part_boxes(&boxes);
 
-    while (str >> token) {
-        tokens.push_back(token);
+    for (const BoundingBox& box : boxes) {
+        bounds_.extend(box);
     }
 
-    return tokens;
+    grid_.build(boxes);
+
+    std::stringstream convert;
+    convert << "Molecule with " << get_num_atoms() << " atoms and " << get_num_bonds()
+            << " bonds in " << grid_.get_num_cells() << " grid cells, "
+            << get_memory_size() / 1024 << "KiB";
+    LOG_DEBUG(convert.str());
+}
+
+
+bool MoleculeActor::has_shadow() const {
+    return true;
+}
+
+
+bool MoleculeActor::calculate_bounds(BoundingBox* box) const {
+    *box = bounds_;
+    return true;
+}
+
+
+// Only atoms are drawn, rays find the bonds in front of them
+void MoleculeActor::rasterize(VisibilityBuffer* buffer) const {
+    for (unsigned int i = 0; i < get_num_atoms(); i++) {
+        buffer->draw_sphere(get_position(i), radii_[i], this, i);
+    }
+}
+
+
+unsigned int MoleculeActor::get_num_atoms() const {
+    return static_cast<unsigned int>(radii_.size());
+}
+
+
+unsigned int MoleculeActor::get_num_bonds() const {
+    return static_cast<unsigned int>(bonds_.size());
+}
+
+
+unsigned int MoleculeActor::get_num_parts() const {
+    return get_num_atoms() + get_num_bonds();
+}
+
+
+size_t MoleculeActor::get_memory_size() const {
+    return sizeof(MoleculeActor) +
+           positions_.capacity() * sizeof(Eigen::Vector3f) +
+           radii_.capacity() * sizeof(float) +
+           elements_.capacity() * sizeof(std::uint8_t) +
+           bonds_.capacity() * sizeof(MoleculeBond) +
+           element_materials_.capacity() * sizeof(MaterialId) +
+           frame_positions_.capacity() * sizeof(Eigen::Vector3f) +
+           grid_.get_memory_size() +
+           light_buffer_.get_memory_size();
+}
+
+
+BoundingBox MoleculeActor::calculate_part_bounds(unsigned int part) const {
+    BoundingBox box;
+
+    if (part < get_num_atoms()) {
+        Vector3d r{radii_[part], radii_[part], radii_[part]};
+        box.lo = get_position(part) - r;
+        box.hi = get_position(part) + r;
+        return box;
+    }
+
+    const MoleculeBond& bond = bonds_[part - get_num_atoms()];
+    Vector3d A = get_position(bond.first);
+    Vector3d B = get_position(bond.second);
+    Vector3d r{bond_radius_, bond_radius_, bond_radius_};
+    box.lo = A.cwiseMin(B) - r;
+    box.hi = A.cwiseMax(B) + r;
+    return box;
+}
+
+
+void MoleculeActor::calculate_part_boxes(std::vector<BoundingBox>* boxes) const {
+    boxes->clear();
+    boxes->reserve(get_num_parts());
+
+    for (unsigned int part = 0; part < get_num_parts(); part++) {
+        boxes->push_back(calculate_part_bounds(part));
+    }
+}
+
+
+void MoleculeActor::set_trajectory(std::unique_ptr<TrajectoryReader>&& trajectory,
+                                   const Eigen::Affine3d& placement)
+{
+    trajectory_ = std::move(trajectory);
+    placement_ = placement;
+
+    // Room for the atoms to move, so most frames only refit the grid
+    std::vector<BoundingBox> boxes;
+    calculate_part_boxes(&boxes);
+    grid_.build(boxes, kTrajectorySlack);
+}
+
+
+bool MoleculeActor::is_animated() const {
+    return trajectory_ != nullptr;
+}
+
+
+bool MoleculeActor::advance_frame()
+{
+    if (!trajectory_) {
+        return false;
+    }
+
+    if (!trajectory_->read_frame(&frame_positions_)) {
+        trajectory_.reset();
+        return false;
+    }
+
+    if (frame_positions_.size() != positions_.size()) {
+        std::stringstream convert;
+        convert << "Trajectory frame " << trajectory_->get_num_frames() - 1 << " has "
+                << frame_positions_.size() << " atoms, the molecule " << positions_.size();
+        LOG_ERROR(convert.str());
+        trajectory_.reset();
+        return false;
+    }
+
+    StopWatch stop_watch;
+
+    for (size_t i = 0; i < positions_.size(); i++) {
+        positions_[i] = (placement_ * frame_positions_[i].cast<double>()).cast<float>();
+    }
+
+    std::vector<BoundingBox> boxes;
+    calculate_part_boxes(&boxes);
+
+    bounds_ = BoundingBox();
+    for (const BoundingBox& box : boxes) {
+        bounds_.extend(box);
+    }
+
+    bool is_refit = grid_.refit(boxes);
+    if (!is_refit) {
+        grid_.build(boxes, kTrajectorySlack);
+    }
+
+    std::stringstream convert;
+    convert << "Moved to trajectory frame " << trajectory_->get_num_frames() - 1
+            << (is_refit ? ", refit " : ", rebuilt ") << grid_.get_num_cells()
+            << " grid cells in " << stop_watch.elapsed() * 1000 << "ms";
+    LOG_DEBUG(convert.str());
+    return true;
+}
+
+
+double solve_capsule_ray(const Vector3d& A, const Vector3d& B, double radius,
+        const Vector3d& O, const Vector3d& D, double min_dist, double max_dist)
+{
+    // The first hit of a union of convex parts is the first hit of any part
+    double closest = -1;
+
+    Vector3d axis = B - A;
+    double length = axis.norm();
+    if (length > 0) {
+        double t = solve_cylinder_ray((A + B) / 2, axis / length, radius, length / 2,
+                                      O, D, min_dist, max_dist);
+        if (t > 0 && t < max_dist) {
+            closest = t;
+            max_dist = t;
+        }
+    }
+
+    for (const Vector3d* end : {&A, &B}) {
+        double t = solve_sphere_ray(*end, radius, O, D, min_dist, max_dist);
+        if (t > 0) {
+            closest = t;
+            max_dist = t;
+        }
+    }
+
+    return closest;
+}
+
+
+double MoleculeActor::solve_part(unsigned int part, const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist) const
+{
+    if (part < get_num_atoms()) {
+        return solve_sphere_ray(get_position(part), radii_[part], O, D, min_dist, max_dist);
+    }
+
+    const MoleculeBond& bond = bonds_[part - get_num_atoms()];
+    return solve_capsule_ray(get_position(bond.first), get_position(bond.second),
+                             bond_radius_, O, D, min_dist, max_dist);
+}
+
+
+double MoleculeActor::solve_part_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist, unsigned int* part) const
+{
+    return grid_.find_closest(O, D, max_dist,
+        [&](unsigned int index, double max_part_dist) {
+            double distance = solve_part(index, O, D, min_dist, max_part_dist);
+            if (distance > 0 && distance < max_part_dist) {
+                *part = index;
+            }
+            return distance;
+        });
+}
+
+
+double MoleculeActor::solve_light_ray(const Vector3d& O, const Vector3d& D,
+        double min_dist, double max_dist) const
+{
+    unsigned int part = 0;
+    return solve_part_ray(O, D, min_dist, max_dist, &part);
+}
+
+
+void MoleculeActor::prepare_light(const Light* light, double margin)
+{
+    if (!light) {
+        light_buffer_ = LightBuffer();
+        return;
+    }
+
+    std::vector<BoundingBox> boxes;
+    calculate_part_boxes(&boxes);
+
+    light_buffer_.build(light->get_center(), boxes, margin);
+
+    std::stringstream convert;
+    convert << "Light buffer with " << light_buffer_.get_resolution()
+            << " cells per edge holds " << light_buffer_.get_num_entries()
+            << " entries for " << get_num_parts() << " parts";
+    LOG_DEBUG(convert.str());
+}
+
+
+bool MoleculeActor::occludes(const Vector3d& O, const Vector3d& D,
+        double max_dist) const
+{
+    auto test_part = [&](unsigned int part) {
+        return solve_part(part, O, D, 0, max_dist) > 0;
+    };
+
+    // Rays to the light only meet the parts listed in their direction
+    if (light_buffer_.covers(O, D, max_dist)) {
+        return light_buffer_.find_any(O, test_part);
+    }
+
+    return grid_.find_any(O, D, max_dist,
+        [&](unsigned int index, double) {
+            return test_part(index);
+        });
+}
+
+
+Vector3d MoleculeActor::calculate_part_normal(const Vector3d& hit, unsigned int part) const {
+    if (part < get_num_atoms()) {
+        Vector3d t = hit - get_position(part);
+        return t * (1 / t.norm());
+    }
+
+    // Away from the closest point of the bond axis, also on the caps
+    const MoleculeBond& bond = bonds_[part - get_num_atoms()];
+    Vector3d A = get_position(bond.first);
+    Vector3d axis = get_position(bond.second) - A;
+
+    double length2 = axis.squaredNorm();
+    double alpha = (length2 > 0) ? (hit - A).dot(axis) / length2 : 0;
+    alpha = std::min(std::max(alpha, 0.0), 1.0);
+
+    Vector3d t = hit - (A + alpha * axis);
+    return t * (1 / t.norm());
+}
+
+
+// Without a part index, use the part whose surface is nearest to the hit
+Vector3d MoleculeActor::calculate_normal_at_hit(const Vector3d& hit) const {
+    unsigned int best_part = 0;
+    double best_dist = std::numeric_limits<double>::max();
+
+    for (unsigned int part = 0; part < get_num_parts(); part++) {
+        double dist;
+        if (part < get_num_atoms()) {
+            dist = std::abs((hit - get_position(part)).norm() - radii_[part]);
+        } else {
+            const MoleculeBond& bond = bonds_[part - get_num_atoms()];
+            Vector3d A = get_position(bond.first);
+            Vector3d axis = get_position(bond.second) - A;
+
+            double length2 = axis.squaredNorm();
+            double alpha = (length2 > 0) ? (hit - A).dot(axis) / length2 : 0;
+            alpha = std::min(std::max(alpha, 0.0), 1.0);
+            dist = std::abs((hit - (A + alpha * axis)).norm() - bond_radius_);
+        }
+
+        if (dist < best_dist) {
+            best_dist = dist;
+            best_part = part;
+        }
+    }
+
+    return calculate_part_normal(hit, best_part);
+}
+
+
+MaterialId MoleculeActor::get_part_material(unsigned int part) const {
+    return (part < get_num_atoms()) ? element_materials_[elements_[part]] : bond_material_;
+}
+
+
+// One material for each element found, unless the scene sets one color
+// for all atoms
+static bool create_element_materials(MaterialTable* materials,
+                                     std::shared_ptr<ConfigTable> items,
+                                     const std::vector<std::uint8_t>& elements,
+                                     std::vector<std::uint8_t>* atom_slots,
+                                     std::vector<MaterialId>* element_materials)
+{
+    // Colors run from 0 to 1, so a negative one marks a missing key
+    Vector3d atom_color = items->get_vector("atom_color", Vector3d{-1, -1, -1});
+    if (atom_color[0] >= 0) {
+        MaterialId material = 0;
+        if (!create_solid_material(materials, items, "atom_color", "atom_reflect", &material)) {
+            return false;
+        }
+
+        element_materials->push_back(material);
+        atom_slots->assign(elements.size(), 0);
+        return true;
+    }
+
+    double reflection_coeff = items->get_value("atom_reflect", 0);
+    std::vector<int> slots(get_num_elements(), -1);
+
+    atom_slots->reserve(elements.size());
+    for (std::uint8_t element : elements) {
+        if (slots[element] < 0) {
+            const ElementInfo& info = get_element_info(element);
+
+            Material material;
+            material.color = TexturePixel(Vector3d{info.red / 255., info.green / 255.,
+                                                   info.blue / 255.});
+            material.reflection_coeff = reflection_coeff;
+
+            slots[element] = static_cast<int>(element_materials->size());
+            element_materials->push_back(materials->add_material(material));
+        }
+
+        atom_slots->push_back(static_cast<std::uint8_t>(slots[element]));
+    }
+
+    return true;
 }
 
-static bool read_line(std::ifstream& f, std::string& buffer, const std::string& pattern)
+
+// Points spread evenly over the unit sphere, on a Fibonacci spiral
+static std::vector<Eigen::Vector3f> create_sphere_samples(unsigned int num_samples)
 {
-    return std::getline(f, buffer) && buffer.find(pattern) == std::string::npos;
+    std::vector<Eigen::Vector3f> samples;
+    samples.reserve(num_samples);
+
+    const double golden_angle = std::atan(1) * 4 * (3 - std::sqrt(5.0));
+    for (unsigned int i = 0; i < num_samples; i++) {
+        double z = 1 - (2 * i + 1.0) / num_samples;
+        double r = std::sqrt(1 - z * z);
+        double phi = golden_angle * i;
+        samples.emplace_back(static_cast<float>(r * std::cos(phi)),
+                             static_cast<float>(r * std::sin(phi)),
+                             static_cast<float>(z));
+    }
+
+    return samples;
 }
 
-static void create_tables(const std::string& mol2file,
-    std::vector<unsigned int>* atomic_nums,
-    std::vector<Eigen::Vector3d>* positions,
-    std::vector<std::pair<unsigned int, unsigned int>>* bonds)
+
+/*
+Finds atoms inside the union of the spheres of other atoms, and bonds
+inside the union of the atoms. These can neither be seen nor cast a
+shadow of their own. Points on each surface are tested against the
+neighbours found in a grid over the atoms, and are lifted a little off
+the surface so that openings between the samples are less likely to be
+missed. Atoms are tested in turn against those kept so far, so that two
+atoms which only cover each other are not both dropped and the union of
+the atoms stays the same.
+*/
+static void find_buried_parts(const std::vector<Eigen::Vector3f>& positions,
+                              const std::vector<float>& radii,
+                              const std::vector<MoleculeBond>& bonds,
+                              double bond_radius,
+                              std::vector<bool>* buried_atoms,
+                              std::vector<bool>* buried_bonds)
 {
-    std::ifstream f(mol2file);
-    std::string buffer;
+    static const unsigned int kNumSamples = 256;
+    static const float kSampleLift = 1.05f;
+    static const unsigned int kNoAtom = std::numeric_limits<unsigned int>::max();
+
+    std::vector<Eigen::Vector3f> samples = create_sphere_samples(kNumSamples);
+
+    // The grid lists atom centers once each, so searches around a sphere
+    // reach out by the largest radius
+    std::vector<BoundingBox> centers(positions.size());
+    float max_radius = 0;
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        centers[i].lo = centers[i].hi = positions[i].cast<double>();
+        max_radius = std::max(max_radius, radii[i]);
+    }
+
+    UniformGrid grid;
+    grid.build(centers);
+
+    buried_atoms->assign(positions.size(), false);
+    buried_bonds->assign(bonds.size(), false);
+
+    std::vector<unsigned int> neighbours;
+
+    // Atoms which overlap a sphere, nearest first
+    auto find_neighbours = [&](const Eigen::Vector3f& center, float radius, unsigned int self) {
+        neighbours.clear();
+
+        BoundingBox box;
+        double reach = radius + max_radius;
+        box.lo = center.cast<double>() - Vector3d{reach, reach, reach};
+        box.hi = center.cast<double>() + Vector3d{reach, reach, reach};
 
-    if (f.is_open()) {
-        while (read_line(f, buffer, "@<TRIPOS>ATOM"))
-            ;
+        grid.find_in_box(box, [&](unsigned int j) {
+            if (j == self || (*buried_atoms)[j]) {
+                return;
+            }
 
-        while (read_line(f, buffer, "@<TRIPOS>BOND")) {
-            std::vector<std::string> tokens = tokenize_line(buffer);
+            float reach = radius + radii[j];
+            if ((positions[j] - center).squaredNorm() < reach * reach) {
+                neighbours.push_back(j);
+            }
+        });
 
-            unsigned int atomic_num = static_cast<unsigned int>(std::stoi(tokens[0]));
-            atomic_nums->push_back(atomic_num);
+        std::sort(neighbours.begin(), neighbours.end(), [&](unsigned int a, unsigned int b) {
+            return (positions[a] - center).squaredNorm() < (positions[b] - center).squaredNorm();
+        });
+    };
 
-            Vector3d coor(std::stod(tokens[2]), std::stod(tokens[3]), std::stod(tokens[4]));
-            positions->push_back(coor);
+    // True when the sphere lies inside the neighbours, the neighbour which
+    // covered the last point is tried first for the next one
+    auto is_covered = [&](const Eigen::Vector3f& center, float radius) {
+        if (neighbours.empty()) {
+            return false;
         }
 
-        while (read_line(f, buffer, "@<TRIPOS>SUBSTRUCTURE")) {
-            std::vector<std::string> tokens = tokenize_line(buffer);
+        unsigned int last = neighbours[0];
+        for (const Eigen::Vector3f& sample : samples) {
+            Eigen::Vector3f p = center + sample * (radius * kSampleLift);
 
-            std::pair<unsigned int, unsigned int> bond(static_cast<unsigned int>(std::stoi(tokens[1])) - 1, static_cast<unsigned int>(std::stoi(tokens[2])) - 1);
-            bonds->push_back(bond);
+            auto inside = [&](unsigned int j) {
+                return (p - positions[j]).squaredNorm() < radii[j] * radii[j];
+            };
+
+            if (inside(last)) {
+                continue;
+            }
+
+            auto it = std::find_if(neighbours.begin(), neighbours.end(), inside);
+            if (it == neighbours.end()) {
+                return false;
+            }
+            last = *it;
+        }
+
+        return true;
+    };
+
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        find_neighbours(positions[i], radii[i], i);
+        (*buried_atoms)[i] = is_covered(positions[i], radii[i]);
+    }
+
+    // Bonds as spheres along their axis, no further apart than their radius
+    float r = static_cast<float>(bond_radius);
+    for (unsigned int k = 0; k < bonds.size(); k++) {
+        const Eigen::Vector3f& A = positions[bonds[k].first];
+        const Eigen::Vector3f& B = positions[bonds[k].second];
+        float half_length = (B - A).norm() / 2;
+
+        // Inside its own atoms when the ring around its middle is, and
+        // bonds of no width are never hit
+        float ra = std::min(radii[bonds[k].first], radii[bonds[k].second]);
+        if (r <= 0 || (r <= ra && half_length * half_length + r * r < ra * ra)) {
+            (*buried_bonds)[k] = true;
+            continue;
+        }
+
+        find_neighbours((A + B) / 2, half_length + r, kNoAtom);
+
+        unsigned int num_steps = static_cast<unsigned int>(std::ceil((B - A).norm() / r));
+        bool covered = true;
+        for (unsigned int step = 0; step <= num_steps && covered; step++) {
+            float alpha = num_steps ? static_cast<float>(step) / num_steps : 0;
+            covered = is_covered(A + alpha * (B - A), r);
         }
+
+        (*buried_bonds)[k] = covered;
     }
 }
 
-void create_molecule(TextureFactory* texture_factory,
+
+/*
+Drops buried atoms and bonds from the molecule. Atoms are renumbered with
+the ones left first, then the buried ones which are still the ends of
+bonds, which the molecule keeps only as positions.
+*/
+static void cull_buried_parts(std::vector<Eigen::Vector3f>* positions,
+                              std::vector<float>* radii,
+                              std::vector<std::uint8_t>* atom_slots,
+                              std::vector<MoleculeBond>* bonds,
+                              double bond_radius)
+{
+    StopWatch stop_watch;
+
+    std::vector<bool> buried_atoms;
+    std::vector<bool> buried_bonds;
+    find_buried_parts(*positions, *radii, *bonds, bond_radius, &buried_atoms, &buried_bonds);
+
+    size_t num_atoms = positions->size();
+    size_t num_bonds = bonds->size();
+
+    std::vector<MoleculeBond> kept_bonds;
+    std::vector<bool> is_bond_end(num_atoms, false);
+    for (size_t k = 0; k < num_bonds; k++) {
+        if (!buried_bonds[k]) {
+            kept_bonds.push_back((*bonds)[k]);
+            is_bond_end[(*bonds)[k].first] = true;
+            is_bond_end[(*bonds)[k].second] = true;
+        }
+    }
+
+    const std::uint32_t kDropped = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> new_index(num_atoms, kDropped);
+    std::vector<Eigen::Vector3f> new_positions;
+    std::vector<float> new_radii;
+    std::vector<std::uint8_t> new_slots;
+
+    for (size_t i = 0; i < num_atoms; i++) {
+        if (!buried_atoms[i]) {
+            new_index[i] = static_cast<std::uint32_t>(new_positions.size());
+            new_positions.push_back((*positions)[i]);
+            new_radii.push_back((*radii)[i]);
+            new_slots.push_back((*atom_slots)[i]);
+        }
+    }
+
+    for (size_t i = 0; i < num_atoms; i++) {
+        if (buried_atoms[i] && is_bond_end[i]) {
+            new_index[i] = static_cast<std::uint32_t>(new_positions.size());
+            new_positions.push_back((*positions)[i]);
+        }
+    }
+
+    for (MoleculeBond& bond : kept_bonds) {
+        bond.first = new_index[bond.first];
+        bond.second = new_index[bond.second];
+    }
+
+    std::stringstream convert;
+    convert << "Culled " << num_atoms - new_radii.size() << " of " << num_atoms
+            << " atoms and " << num_bonds - kept_bonds.size() << " of " << num_bonds
+            << " bonds buried in the molecule in " << stop_watch.elapsed() << " s";
+    LOG_INFO(convert.str());
+
+    *positions = std::move(new_positions);
+    *radii = std::move(new_radii);
+    *atom_slots = std::move(new_slots);
+    *bonds = std::move(kept_bonds);
+}
+
+
+void create_molecule(MaterialTable* materials,
                      std::shared_ptr<ConfigTable> items,
                      std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
-    std::string mol2file_str = items->get_text("mol2file");
-    if (mol2file_str.empty()) {
-        LOG_ERROR("Undefined mol2 file");
-        return;
+    // MOL2, PDB, mmCIF or XYZ by the extension, mol2file is the older key
+    std::string filename = items->get_text("file");
+    if (filename.empty()) {
+        filename = items->get_text("mol2file");
+    }
+
+    // Positions of the frames come from a trajectory, elements and bonds
+    // from the molecule file, or else from its first frame
+    std::string trajectory_file = items->get_text("trajectory");
+    if (filename.empty()) {
+        filename = trajectory_file;
     }
 
-    std::fstream check(mol2file_str.c_str());
-    if (!check.good()) {
-        LOG_ERROR(std::string("Cannot open mol2 file " + mol2file_str));
+    if (filename.empty()) {
+        LOG_ERROR("Undefined molecule file");
         return;
     }
 
-    std::vector<unsigned int> atomic_nums;
-    std::vector<Vector3d> positions;
-    std::vector<std::pair<unsigned int, unsigned int>> bonds;
+    unsigned int num_threads = static_cast<unsigned int>(items->get_value("load_threads", 1));
 
-    create_tables(mol2file_str, &atomic_nums, &positions, &bonds);
+    MoleculeData data;
+    if (!read_molecule_file(filename, num_threads, &data)) {
+        return;
+    }
 
-    if (atomic_nums.empty() || positions.empty() || bonds.empty()) {
+    if (data.positions.empty()) {
         LOG_ERROR("Cannot create molecule");
         return;
     }
 
+    std::unique_ptr<TrajectoryReader> trajectory;
+    if (!trajectory_file.empty()) {
+        trajectory = std::make_unique<TrajectoryReader>();
+        size_t num_atoms = data.positions.size();
+
+        if (!trajectory->open(trajectory_file) || !trajectory->read_frame(&data.positions)) {
+            return;
+        }
+
+        if (data.positions.size() != num_atoms) {
+            std::stringstream convert;
+            convert << "Trajectory " << trajectory_file << " has " << data.positions.size()
+                    << " atoms, the molecule " << num_atoms;
+            LOG_ERROR(convert.str());
+            return;
+        }
+    }
+
     Vector3d mol_vec_o = items->get_vector("center");
     if (!mol_vec_o.size()) {
         LOG_ERROR("Error parsing molecule center");
@@ -102,60 +684,53 @@ void create_molecule(TextureFactory* texture_factory,
 
     Eigen::Matrix3d m_rot = create_rotation_matrix(items);
 
-    auto sphere_mapper_ptr = create_dummy_mapper(items, "atom_color", "atom_reflect");
-    if (!sphere_mapper_ptr) {
+    std::vector<std::uint8_t> atom_slots;
+    std::vector<MaterialId> element_materials;
+    if (!create_element_materials(materials, items, data.elements,
+                                  &atom_slots, &element_materials)) {
         return;
     }
 
-    auto cylinder_mapper_ptr = create_dummy_mapper(items, "bond_color", "bond_reflect");
-    if (!cylinder_mapper_ptr) {
+    MaterialId cylinder_material = 0;
+    if (!create_solid_material(materials, items, "bond_color", "bond_reflect",
+                               &cylinder_material)) {
         return;
     }
 
     Vector3d center_vec{0, 0, 0};
-    for (auto& atom_vec : positions) {
-        center_vec += atom_vec;
+    for (auto& atom_vec : data.positions) {
+        center_vec += atom_vec.cast<double>();
     }
-    center_vec *= (1. / positions.size());
+    center_vec *= (1. / data.positions.size());
 
-    std::vector<Vector3d> transl_pos;
-    for (auto& atom_vec : positions) {
-        Vector3d transl_atom_vec = (m_rot * (atom_vec - center_vec)) * mol_scale + mol_vec_o;
-        transl_pos.push_back(transl_atom_vec);
-    }
-
-    for (auto& atom_vec : transl_pos) {
-        StandardBasis sphere_basis;
-        sphere_basis.o = atom_vec;
+    // Later frames are placed as the first one
+    Eigen::Affine3d placement = Eigen::Affine3d::Identity();
+    placement.translate(mol_vec_o).scale(mol_scale).rotate(m_rot).translate(-center_vec);
 
-        actor_ptrs->push_back(std::shared_ptr<ActorBase>(new SimpleSphere(
-                sphere_basis, sphere_scale, sphere_mapper_ptr)));
+    for (auto& atom_vec : data.positions) {
+        atom_vec = (placement * atom_vec.cast<double>()).cast<float>();
     }
 
-    for (auto& bond : bonds) {
-        Vector3d cylinder_begin_vec = transl_pos[bond.first];
-        Vector3d cylinder_end_vec = transl_pos[bond.second];
-
-        Vector3d cylinder_center_vec = (cylinder_begin_vec + cylinder_end_vec) / 2;
-        Vector3d cylinder_k_vec = cylinder_end_vec - cylinder_begin_vec;
-        double cylinder_span = cylinder_k_vec.norm() / 2;
+    std::vector<float> radii(data.positions.size(), static_cast<float>(sphere_scale));
 
-        Vector3d fill_vec = fill_vector(cylinder_k_vec);
-
-        Vector3d cylinder_i_vec = fill_vec.cross(cylinder_k_vec);
-        Vector3d cylinder_j_vec = cylinder_k_vec.cross(cylinder_i_vec);
-
-        cylinder_i_vec *= (1 / cylinder_i_vec.norm());
-        cylinder_j_vec *= (1 / cylinder_j_vec.norm());
-        cylinder_k_vec *= (1 / cylinder_k_vec.norm());
+    if (items->get_value("cull_buried", 0) != 0) {
+        if (trajectory) {
+            LOG_WARNING("Buried atoms are kept, they move with the trajectory");
+        } else {
+            cull_buried_parts(&data.positions, &radii, &atom_slots, &data.bonds, cylinder_scale);
+        }
+    }
 
-        StandardBasis cylinder_basis;
-        set_basis(&cylinder_basis, cylinder_center_vec, cylinder_i_vec,
-                  cylinder_j_vec, cylinder_k_vec);
+    auto molecule = std::make_shared<MoleculeActor>(
+            std::move(data.positions), std::move(radii), std::move(atom_slots),
+            std::move(data.bonds), cylinder_scale,
+            std::move(element_materials), cylinder_material);
 
-        actor_ptrs->push_back(std::shared_ptr<ActorBase>(new SimpleCylinder(
-                cylinder_basis, cylinder_scale, cylinder_span, cylinder_mapper_ptr)));
+    if (trajectory) {
+        molecule->set_trajectory(std::move(trajectory), placement);
     }
+
+    actor_ptrs->push_back(molecule);
 }
 
 
@@ -1,17 +1,107 @@
 #ifndef MOLECULE_H
 #define MOLECULE_H
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
 #include "config.h"
 #include "actors.h"
+#include "actors/molfile.h"
+#include "grid.h"
+#include "lightbuffer.h"
 #include "texture.h"
 
 
 namespace mrtp {
 
-void create_molecule(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
+/*
+Molecule stored as one actor. Atoms are kept in packed single precision
+arrays of positions and radii with one byte per atom for their element,
+which indexes a short table of materials. Bonds are pairs of atom indices,
+drawn as capsules of one radius. Atoms and bonds share a uniform grid for
+closest hits and for shadow rays. Parts number the atoms first, then the
+bonds. Positions past the radii are atoms which are not drawn, kept as the
+ends of bonds. With a trajectory, each frame moves the atoms in place and
+refits the grid to them. The light buffer is built again by prepare_light.
+*/
+class MoleculeActor : public ActorBase
+{
+public:
+    MoleculeActor(std::vector<Eigen::Vector3f>&&, std::vector<float>&&,
+                  std::vector<std::uint8_t>&&, std::vector<MoleculeBond>&&, double,
+                  std::vector<MaterialId>&&, MaterialId);
+    MoleculeActor() = delete;
+
+    ~MoleculeActor() override = default;
+
+    double solve_light_ray(const Vector3d&, const Vector3d&,
+            double, double) const override;
+    double solve_part_ray(const Vector3d&, const Vector3d&,
+            double, double, unsigned int*) const override;
+
+    Vector3d calculate_normal_at_hit(const Vector3d&) const override;
+    Vector3d calculate_part_normal(const Vector3d&, unsigned int) const override;
+    MaterialId get_part_material(unsigned int) const override;
+
+    bool has_shadow() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
+    void prepare_light(const Light*, double) override;
+
+    // Frames hold the atoms of the molecule in file order, and are placed
+    // by the transform which placed the first one
+    void set_trajectory(std::unique_ptr<TrajectoryReader>&&, const Eigen::Affine3d&);
+    bool is_animated() const override;
+    bool advance_frame() override;
+
+    unsigned int get_num_atoms() const;
+    unsigned int get_num_bonds() const;
+    size_t get_memory_size() const;
+
+private:
+    double solve_part(unsigned int, const Vector3d&, const Vector3d&, double, double) const;
+    BoundingBox calculate_part_bounds(unsigned int) const;
+    void calculate_part_boxes(std::vector<BoundingBox>*) const;
+    unsigned int get_num_parts() const;
+
+    Vector3d get_position(unsigned int atom) const
+    {
+        return positions_[atom].cast<double>();
+    }
+
+    std::vector<Eigen::Vector3f> positions_;
+    std::vector<float> radii_;
+    std::vector<std::uint8_t> elements_;  // index into element_materials_
+    std::vector<MoleculeBond> bonds_;
+    double bond_radius_;
+
+    std::vector<MaterialId> element_materials_;
+    MaterialId bond_material_;
+
+    UniformGrid grid_;
+
+    // Parts by direction from the light, for shadow rays
+    LightBuffer light_buffer_;
+
+    BoundingBox bounds_;
+
+    std::unique_ptr<TrajectoryReader> trajectory_;
+    Eigen::Affine3d placement_ = Eigen::Affine3d::Identity();
+    std::vector<Eigen::Vector3f> frame_positions_;
+};
+
+
+// Nearest hit of a ray and a capsule around the segment between two points
+double solve_capsule_ray(const Vector3d&, const Vector3d&, double,
+                         const Vector3d&, const Vector3d&, double, double);
+
+void create_molecule(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
 
 }
 
@@ -0,0 +1,1091 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "actors/elements.h"
+#include "actors/molfile.h"
+
+#include "logger.h"
+#include "mappedfile.h"
+#include "stats.h"
+
+
+namespace mrtp {
+
+// Chunks smaller than this are not worth a thread
+static const size_t kMinChunkSize = 1 << 20;
+
+// Margin over the sum of covalent radii for bonds, and the shortest bond,
+// in angstroms
+static const float kBondTolerance = 0.45f;
+static const float kMinBondLength = 0.4f;
+
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+// Whole field as a number, blanks around it are allowed
+template<typename T>
+static bool parse_number(std::string_view field, T* value)
+{
+    const char* first = field.data();
+    const char* last = first + field.size();
+
+    while (first < last && is_blank(*first)) {
+        first++;
+    }
+    while (last > first && is_blank(last[-1])) {
+        last--;
+    }
+
+    // from_chars takes no leading plus sign
+    if (first < last && *first == '+') {
+        first++;
+    }
+
+    std::from_chars_result result = std::from_chars(first, last, *value);
+    return first < last && result.ec == std::errc() && result.ptr == last;
+}
+
+
+/*
+Cursor over the fields of one record. Fields are separated by blanks and
+are returned as views into the mapped file, so records are parsed without
+copying or allocating.
+*/
+class RecordReader
+{
+public:
+    RecordReader(const char* begin, const char* end)
+        : p_(begin), end_(end)
+    {
+    }
+
+    bool next_field(std::string_view* field)
+    {
+        while (p_ < end_ && is_blank(*p_)) {
+            p_++;
+        }
+
+        const char* first = p_;
+        while (p_ < end_ && !is_blank(*p_)) {
+            p_++;
+        }
+
+        *field = std::string_view(first, p_ - first);
+        return p_ > first;
+    }
+
+    template<typename T>
+    bool next_number(T* value)
+    {
+        std::string_view field;
+        return next_field(&field) && parse_number(field, value);
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+
+struct ParseError
+{
+    const char* where = nullptr;
+    std::string what;
+};
+
+
+// Atom and bond records of one chunk of a section
+struct Mol2Chunk
+{
+    const char* begin;
+    const char* end;
+
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<std::uint8_t> elements;
+    std::vector<std::uint32_t> atom_ids;
+    std::vector<MoleculeBond> bond_ids;
+
+    ParseError error;
+};
+
+
+static const char* find_line_end(const char* p, const char* end)
+{
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+
+// Records of a section end where the next one begins, or at the end of
+// the file. A section of no records ends where it begins.
+static const char* find_section_end(const char* begin, const char* end)
+{
+    std::string_view text(begin, end - begin);
+    if (text.compare(0, 9, "@<TRIPOS>") == 0) {
+        return begin;
+    }
+
+    size_t pos = text.find("\n@<TRIPOS>");
+    return (pos == std::string_view::npos) ? end : begin + pos + 1;
+}
+
+
+static const char* find_section(const char* begin, const char* end, std::string_view name)
+{
+    std::string_view text(begin, end - begin);
+
+    for (size_t pos = text.find("@<TRIPOS>"); pos != std::string_view::npos;
+         pos = text.find("@<TRIPOS>", pos + 1)) {
+        if (pos > 0 && text[pos - 1] != '\n') {
+            continue;
+        }
+
+        const char* header = begin + pos;
+        const char* eol = find_line_end(header, end);
+
+        RecordReader reader(header, eol);
+        std::string_view field;
+        reader.next_field(&field);
+        if (field.substr(9) == name) {
+            return (eol < end) ? eol + 1 : end;
+        }
+    }
+
+    return nullptr;
+}
+
+
+// The element is the part of the SYBYL atom type before the dot, as in
+// "C.ar", or failing that the leading letters of the atom name. Two of
+// them only make a symbol when the second is lower case, as in "Cl1",
+// since names such as "CA" stand for carbon atoms.
+static std::uint8_t parse_element(std::string_view name, std::string_view type)
+{
+    unsigned int element = find_element(type.substr(0, type.find('.')));
+    if (element || name.empty()) {
+        return static_cast<std::uint8_t>(element);
+    }
+
+    size_t length = (name.size() > 1 && std::islower(static_cast<unsigned char>(name[1]))) ? 2 : 1;
+    return static_cast<std::uint8_t>(find_element(name.substr(0, length)));
+}
+
+
+static bool is_record(const char* begin, const char* end)
+{
+    RecordReader reader(begin, end);
+    std::string_view field;
+    return reader.next_field(&field) && field[0] != '#';
+}
+
+
+// Returns the start of the first line with a record, or the end
+static const char* skip_blank_lines(const char* line, const char* end)
+{
+    while (line < end) {
+        const char* eol = find_line_end(line, end);
+        if (is_record(line, eol)) {
+            break;
+        }
+        line = (eol < end) ? eol + 1 : end;
+    }
+    return line;
+}
+
+
+// Fields are atom_id atom_name x y z atom_type, and more which are unused
+static void parse_atoms(Mol2Chunk* chunk)
+{
+    for (const char* line = chunk->begin; line < chunk->end; ) {
+        const char* eol = find_line_end(line, chunk->end);
+
+        if (is_record(line, eol)) {
+            RecordReader reader(line, eol);
+            std::uint32_t id;
+            std::string_view name, type;
+            Eigen::Vector3f position;
+
+            if (!reader.next_number(&id) || !reader.next_field(&name) ||
+                !reader.next_number(&position[0]) || !reader.next_number(&position[1]) ||
+                !reader.next_number(&position[2])) {
+                chunk->error = ParseError{line, "Malformed atom record"};
+                return;
+            }
+            reader.next_field(&type);
+
+            chunk->atom_ids.push_back(id);
+            chunk->positions.push_back(position);
+            chunk->elements.push_back(parse_element(name, type));
+        }
+
+        line = eol + 1;
+    }
+}
+
+
+// Fields are bond_id origin_atom_id target_atom_id bond_type
+static void parse_bonds(Mol2Chunk* chunk)
+{
+    for (const char* line = chunk->begin; line < chunk->end; ) {
+        const char* eol = find_line_end(line, chunk->end);
+
+        if (is_record(line, eol)) {
+            RecordReader reader(line, eol);
+            std::uint32_t id;
+            MoleculeBond bond;
+
+            if (!reader.next_number(&id) || !reader.next_number(&bond.first) ||
+                !reader.next_number(&bond.second)) {
+                chunk->error = ParseError{line, "Malformed bond record"};
+                return;
+            }
+
+            chunk->bond_ids.push_back(bond);
+        }
+
+        line = eol + 1;
+    }
+}
+
+
+// Splits a section at line ends into chunks of about the same size
+static std::vector<Mol2Chunk> split_section(const char* begin, const char* end,
+                                            unsigned int num_threads)
+{
+    size_t size = end - begin;
+    unsigned int num_chunks = static_cast<unsigned int>(
+            std::max<size_t>(1, std::min<size_t>(num_threads, size / kMinChunkSize)));
+
+    std::vector<Mol2Chunk> chunks(num_chunks);
+    const char* first = begin;
+
+    for (unsigned int i = 0; i < num_chunks; i++) {
+        const char* last = end;
+        if (i + 1 < num_chunks) {
+            last = find_line_end(std::max(first, begin + size * (i + 1) / num_chunks), end);
+            last = std::min(last + 1, end);
+        }
+
+        chunks[i].begin = first;
+        chunks[i].end = last;
+        first = last;
+    }
+
+    return chunks;
+}
+
+
+static void parse_chunks(std::vector<Mol2Chunk>* chunks, void (*parse)(Mol2Chunk*))
+{
+    if (chunks->size() == 1) {
+        parse(&chunks->front());
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (Mol2Chunk& chunk : *chunks) {
+        threads.emplace_back(parse, &chunk);
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+
+static void log_error(const std::string& filename, const MappedFile& file,
+                      const ParseError& error)
+{
+    std::stringstream convert;
+    convert << filename;
+
+    if (error.where) {
+        convert << ":" << std::count(file.begin(), error.where, '\n') + 1;
+    }
+
+    convert << ": " << error.what;
+    LOG_ERROR(convert.str());
+}
+
+
+static void log_read(const std::string& filename, const MappedFile& file,
+                     const MoleculeData& data, double time)
+{
+    std::stringstream convert;
+    convert << "Read " << data.positions.size() << " atoms and " << data.bonds.size()
+            << " bonds from " << filename << " in " << time << " s ("
+            << file.size() / (time * 1024 * 1024) << " MB/s)";
+    LOG_INFO(convert.str());
+
+    // Their bonds are guessed with a covalent radius of 0.75
+    size_t num_unknown = std::count(data.elements.begin(), data.elements.end(), 0);
+    if (num_unknown) {
+        std::stringstream warning;
+        warning << num_unknown << " atoms of " << filename << " are of unknown elements";
+        LOG_WARNING(warning.str());
+    }
+}
+
+
+static const ParseError* find_error(const std::vector<Mol2Chunk>& chunks)
+{
+    for (const Mol2Chunk& chunk : chunks) {
+        if (chunk.error.where) {
+            return &chunk.error;
+        }
+    }
+    return nullptr;
+}
+
+
+bool read_mol2_file(const std::string& filename, unsigned int num_threads,
+                    MoleculeData* data)
+{
+    StopWatch stop_watch;
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        LOG_ERROR(std::string("Cannot open mol2 file " + filename));
+        return false;
+    }
+
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Only the first molecule of the file is read
+    const char* end = file.end();
+    const char* molecule = find_section(file.begin(), end, "MOLECULE");
+    if (molecule) {
+        const char* next = find_section(molecule, end, "MOLECULE");
+        if (next) {
+            end = next;
+        }
+    }
+
+    const char* atoms = find_section(file.begin(), end, "ATOM");
+    if (!atoms) {
+        log_error(filename, file, ParseError{nullptr, "No atom section"});
+        return false;
+    }
+
+    std::vector<Mol2Chunk> atom_chunks =
+            split_section(atoms, find_section_end(atoms, end), num_threads);
+    parse_chunks(&atom_chunks, parse_atoms);
+
+    if (const ParseError* error = find_error(atom_chunks)) {
+        log_error(filename, file, *error);
+        return false;
+    }
+
+    std::vector<Mol2Chunk> bond_chunks;
+    const char* bonds = find_section(file.begin(), end, "BOND");
+    if (bonds) {
+        bond_chunks = split_section(bonds, find_section_end(bonds, end), num_threads);
+        parse_chunks(&bond_chunks, parse_bonds);
+
+        if (const ParseError* error = find_error(bond_chunks)) {
+            log_error(filename, file, *error);
+            return false;
+        }
+    }
+
+    size_t num_atoms = 0;
+    for (const Mol2Chunk& chunk : atom_chunks) {
+        num_atoms += chunk.positions.size();
+    }
+
+    if (num_atoms == 0) {
+        log_error(filename, file, ParseError{nullptr, "No atoms found"});
+        return false;
+    }
+
+    size_t num_bonds = 0;
+    for (const Mol2Chunk& chunk : bond_chunks) {
+        num_bonds += chunk.bond_ids.size();
+    }
+
+    data->positions.clear();
+    data->elements.clear();
+    data->bonds.clear();
+    data->positions.reserve(num_atoms);
+    data->elements.reserve(num_atoms);
+    data->bonds.reserve(num_bonds);
+
+    std::vector<std::uint32_t> atom_ids;
+    atom_ids.reserve(num_atoms);
+
+    for (const Mol2Chunk& chunk : atom_chunks) {
+        data->positions.insert(data->positions.end(), chunk.positions.begin(), chunk.positions.end());
+        data->elements.insert(data->elements.end(), chunk.elements.begin(), chunk.elements.end());
+        atom_ids.insert(atom_ids.end(), chunk.atom_ids.begin(), chunk.atom_ids.end());
+    }
+
+    // Atom ids usually count from 1 in file order, otherwise look them up
+    bool is_sequential = true;
+    for (size_t i = 0; i < atom_ids.size() && is_sequential; i++) {
+        is_sequential = (atom_ids[i] == i + 1);
+    }
+
+    std::unordered_map<std::uint32_t, std::uint32_t> atom_index;
+    if (!is_sequential) {
+        for (size_t i = 0; i < atom_ids.size(); i++) {
+            atom_index.emplace(atom_ids[i], static_cast<std::uint32_t>(i));
+        }
+    }
+
+    auto find_atom = [&](std::uint32_t id, std::uint32_t* index) {
+        if (is_sequential) {
+            *index = id - 1;
+            return id >= 1 && id <= atom_ids.size();
+        }
+
+        auto it = atom_index.find(id);
+        if (it == atom_index.end()) {
+            return false;
+        }
+        *index = it->second;
+        return true;
+    };
+
+    for (const Mol2Chunk& chunk : bond_chunks) {
+        for (const MoleculeBond& ids : chunk.bond_ids) {
+            MoleculeBond bond;
+            if (!find_atom(ids.first, &bond.first) || !find_atom(ids.second, &bond.second)) {
+                std::stringstream convert;
+                convert << "Bond " << data->bonds.size() + 1 << " refers to a missing atom";
+                log_error(filename, file, ParseError{nullptr, convert.str()});
+                return false;
+            }
+
+            data->bonds.push_back(bond);
+        }
+    }
+
+    log_read(filename, file, *data, stop_watch.elapsed());
+    return true;
+}
+
+
+// Atoms of one PDB line are in fixed columns, see the wwPDB format guide
+static const size_t kPdbNameColumn = 12;
+static const size_t kPdbAltColumn = 16;
+static const size_t kPdbCoordColumn = 30;
+static const size_t kPdbCoordWidth = 8;
+static const size_t kPdbElementColumn = 76;
+
+
+// Names are aligned so that one letter elements start in their second
+// column, as in " CA " for carbon and "CA  " for calcium. Two letter
+// elements only come in HETATM records, and names of four letters which
+// start with H are hydrogens, as in "HG12".
+static std::uint8_t parse_pdb_element(std::string_view line)
+{
+    if (line.size() > kPdbElementColumn) {
+        std::string_view symbol = line.substr(kPdbElementColumn, 2);
+        while (!symbol.empty() && is_blank(symbol.back())) {
+            symbol.remove_suffix(1);
+        }
+        while (!symbol.empty() && is_blank(symbol.front())) {
+            symbol.remove_prefix(1);
+        }
+
+        unsigned int element = find_element(symbol);
+        if (element) {
+            return static_cast<std::uint8_t>(element);
+        }
+    }
+
+    std::string_view name = line.substr(kPdbNameColumn, 2);
+    if (name[0] == ' ' || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return static_cast<std::uint8_t>(find_element(name.substr(1, 1)));
+    }
+
+    std::string_view full_name = line.substr(kPdbNameColumn, 4);
+    bool is_hydrogen = full_name[0] == 'H' && full_name.find(' ') == std::string_view::npos;
+    unsigned int element = 0;
+    if (line.compare(0, 6, "HETATM") == 0 && !is_hydrogen) {
+        element = find_element(name);
+    }
+    return static_cast<std::uint8_t>(element ? element : find_element(name.substr(0, 1)));
+}
+
+
+/*
+Reads the ATOM and HETATM records of one model, up to its ENDMDL record.
+Only the first of alternate locations is kept. Returns where the next
+model starts.
+*/
+static const char* parse_pdb_model(const char* begin, const char* end,
+                                   MoleculeData* data, ParseError* error)
+{
+    for (const char* line = begin; line < end; ) {
+        const char* eol = find_line_end(line, end);
+        std::string_view record(line, eol - line);
+        line = (eol < end) ? eol + 1 : end;
+
+        if (record.compare(0, 6, "ENDMDL") == 0 || record.compare(0, 6, "END   ") == 0 ||
+            record == "END" || record == "END\r") {
+            return line;
+        }
+
+        if (record.compare(0, 6, "ATOM  ") != 0 && record.compare(0, 6, "HETATM") != 0) {
+            continue;
+        }
+
+        Eigen::Vector3f position;
+        if (record.size() < kPdbCoordColumn + 3 * kPdbCoordWidth ||
+            !parse_number(record.substr(kPdbCoordColumn, kPdbCoordWidth), &position[0]) ||
+            !parse_number(record.substr(kPdbCoordColumn + kPdbCoordWidth, kPdbCoordWidth), &position[1]) ||
+            !parse_number(record.substr(kPdbCoordColumn + 2 * kPdbCoordWidth, kPdbCoordWidth), &position[2])) {
+            *error = ParseError{record.data(), "Malformed atom record"};
+            return end;
+        }
+
+        char alt = record[kPdbAltColumn];
+        if (alt != ' ' && alt != 'A' && alt != '1') {
+            continue;
+        }
+
+        data->positions.push_back(position);
+        data->elements.push_back(parse_pdb_element(record));
+    }
+
+    return end;
+}
+
+
+/*
+Tokens of a CIF file. Values may be quoted, and text fields run between
+lines which start with a semicolon. Comments are skipped. Returns false at
+the end of the file.
+*/
+class CifReader
+{
+public:
+    CifReader(const char* begin, const char* end)
+        : begin_(begin), p_(begin), end_(end)
+    {
+    }
+
+    bool next_token(std::string_view* token)
+    {
+        while (p_ < end_) {
+            if (*p_ == '\n' || is_blank(*p_)) {
+                p_++;
+            }
+            else if (*p_ == '#') {
+                p_ = find_line_end(p_, end_);
+            }
+            else {
+                break;
+            }
+        }
+
+        if (p_ >= end_) {
+            return false;
+        }
+
+        token_ = p_;
+
+        if (*p_ == ';' && (p_ == begin_ || p_[-1] == '\n')) {
+            std::string_view rest(p_ + 1, end_ - p_ - 1);
+            size_t close = rest.find("\n;");
+            const char* last = (close == std::string_view::npos) ? end_ : p_ + 1 + close;
+            *token = std::string_view(p_ + 1, last - p_ - 1);
+            p_ = std::min(last + 2, end_);
+            return true;
+        }
+
+        // Quotes only close before a blank
+        if (*p_ == '\'' || *p_ == '"') {
+            char quote = *p_;
+            const char* first = ++p_;
+            while (p_ < end_ && *p_ != '\n' &&
+                   !(*p_ == quote && (p_ + 1 == end_ || p_[1] == '\n' || is_blank(p_[1])))) {
+                p_++;
+            }
+            *token = std::string_view(first, p_ - first);
+            if (p_ < end_ && *p_ == quote) {
+                p_++;
+            }
+            return true;
+        }
+
+        const char* first = p_;
+        while (p_ < end_ && *p_ != '\n' && !is_blank(*p_)) {
+            p_++;
+        }
+        *token = std::string_view(first, p_ - first);
+        return true;
+    }
+
+    // Start of the last token, for errors
+    const char* get_token_start() const
+    {
+        return token_;
+    }
+
+private:
+    const char* begin_;
+    const char* p_;
+    const char* end_;
+    const char* token_ = nullptr;
+};
+
+
+// Quoted and text fields may be empty
+static bool is_cif_keyword(std::string_view token)
+{
+    return (!token.empty() && token[0] == '_') || token == "loop_" ||
+           token.compare(0, 5, "data_") == 0 || token.compare(0, 5, "save_") == 0;
+}
+
+
+/*
+Reads the atom_site loop of an mmCIF file, only the atoms of its first
+model and of the first of alternate locations.
+*/
+static void parse_cif_atoms(const char* begin, const char* end,
+                            MoleculeData* data, ParseError* error)
+{
+    CifReader reader(begin, end);
+    std::string_view token;
+
+    bool has_token = reader.next_token(&token);
+    while (has_token) {
+        if (token != "loop_") {
+            has_token = reader.next_token(&token);
+            continue;
+        }
+
+        std::vector<std::string_view> columns;
+        while ((has_token = reader.next_token(&token)) && !token.empty() && token[0] == '_') {
+            columns.push_back(token);
+        }
+
+        if (columns.empty() || columns[0].compare(0, 11, "_atom_site.") != 0) {
+            continue;
+        }
+
+        // Every column of the loop names an atom_site field
+        for (std::string_view column : columns) {
+            if (column.compare(0, 11, "_atom_site.") != 0) {
+                *error = ParseError{column.data(), "Malformed atom_site column"};
+                return;
+            }
+        }
+
+        auto find_column = [&](std::string_view name) {
+            for (size_t i = 0; i < columns.size(); i++) {
+                if (columns[i].substr(11) == name) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        };
+
+        int x = find_column("Cartn_x");
+        int y = find_column("Cartn_y");
+        int z = find_column("Cartn_z");
+        int symbol = find_column("type_symbol");
+        int name = find_column("label_atom_id");
+        int alt = find_column("label_alt_id");
+        int model = find_column("pdbx_PDB_model_num");
+
+        if (x < 0 || y < 0 || z < 0) {
+            *error = ParseError{nullptr, "No atom coordinates in atom_site"};
+            return;
+        }
+
+        std::vector<std::string_view> row(columns.size());
+        std::string_view first_model;
+
+        while (has_token && !is_cif_keyword(token)) {
+            const char* row_start = reader.get_token_start();
+
+            row[0] = token;
+            for (size_t i = 1; i < row.size(); i++) {
+                if (!reader.next_token(&row[i]) || is_cif_keyword(row[i])) {
+                    *error = ParseError{row_start, "Truncated atom_site row"};
+                    return;
+                }
+            }
+            has_token = reader.next_token(&token);
+
+            if (model >= 0) {
+                if (first_model.empty()) {
+                    first_model = row[model];
+                }
+                else if (row[model] != first_model) {
+                    break;
+                }
+            }
+
+            if (alt >= 0 && !row[alt].empty() && row[alt] != "." && row[alt] != "?" &&
+                row[alt] != "A") {
+                continue;
+            }
+
+            Eigen::Vector3f position;
+            if (!parse_number(row[x], &position[0]) || !parse_number(row[y], &position[1]) ||
+                !parse_number(row[z], &position[2])) {
+                *error = ParseError{row_start, "Malformed atom coordinates"};
+                return;
+            }
+
+            unsigned int element = (symbol >= 0) ? find_element(row[symbol]) : 0;
+            if (!element && name >= 0) {
+                element = parse_element(row[name], std::string_view());
+            }
+
+            data->positions.push_back(position);
+            data->elements.push_back(static_cast<std::uint8_t>(element));
+        }
+
+        return;
+    }
+
+    *error = ParseError{nullptr, "No atom_site loop"};
+    return;
+}
+
+
+/*
+Reads one frame of an XYZ file, a line with the number of atoms, a comment
+line, then one line for each atom with its element and coordinates.
+Returns where the next frame starts, or the start of a frame of no
+atoms at the end of the file.
+*/
+static const char* parse_xyz_frame(const char* begin, const char* end,
+                                   MoleculeData* data, ParseError* error)
+{
+    // Blank lines between frames are allowed
+    const char* line = skip_blank_lines(begin, end);
+    if (line >= end) {
+        return end;
+    }
+
+    const char* eol = find_line_end(line, end);
+
+    RecordReader count_reader(line, eol);
+    std::uint32_t num_atoms;
+    if (!count_reader.next_number(&num_atoms)) {
+        *error = ParseError{line, "Expected the number of atoms"};
+        return end;
+    }
+
+    // Then a comment line
+    for (int i = 0; i < 2 && line < end; i++) {
+        eol = find_line_end(line, end);
+        line = (eol < end) ? eol + 1 : end;
+    }
+
+    for (std::uint32_t i = 0; i < num_atoms; i++) {
+        if (line >= end) {
+            std::stringstream convert;
+            convert << "Expected " << num_atoms << " atoms, found " << i;
+            *error = ParseError{end, convert.str()};
+            return end;
+        }
+
+        eol = find_line_end(line, end);
+        RecordReader reader(line, eol);
+        std::string_view symbol;
+        Eigen::Vector3f position;
+
+        if (!reader.next_field(&symbol) ||
+            !reader.next_number(&position[0]) || !reader.next_number(&position[1]) ||
+            !reader.next_number(&position[2])) {
+            *error = ParseError{line, "Malformed atom record"};
+            return end;
+        }
+
+        data->positions.push_back(position);
+        data->elements.push_back(static_cast<std::uint8_t>(find_element(symbol)));
+        line = (eol < end) ? eol + 1 : end;
+    }
+
+    return line;
+}
+
+
+template<typename F>
+static bool read_atoms(const std::string& filename, const char* format,
+                       F parse, MoleculeData* data)
+{
+    StopWatch stop_watch;
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        LOG_ERROR(std::string("Cannot open ") + format + " file " + filename);
+        return false;
+    }
+
+    data->positions.clear();
+    data->elements.clear();
+    data->bonds.clear();
+
+    ParseError error;
+    parse(file.begin(), file.end(), data, &error);
+    if (!error.what.empty()) {
+        log_error(filename, file, error);
+        return false;
+    }
+
+    if (data->positions.empty()) {
+        log_error(filename, file, ParseError{nullptr, "No atoms found"});
+        return false;
+    }
+
+    log_read(filename, file, *data, stop_watch.elapsed());
+    return true;
+}
+
+
+bool read_pdb_file(const std::string& filename, MoleculeData* data)
+{
+    return read_atoms(filename, "PDB", parse_pdb_model, data);
+}
+
+
+bool read_cif_file(const std::string& filename, MoleculeData* data)
+{
+    return read_atoms(filename, "mmCIF", parse_cif_atoms, data);
+}
+
+
+bool read_xyz_file(const std::string& filename, MoleculeData* data)
+{
+    return read_atoms(filename, "XYZ", parse_xyz_frame, data);
+}
+
+
+/*
+Atoms are sorted into cubic cells at least as wide as the longest bond, so
+each atom only meets the atoms of the 27 cells around it and the search
+takes time in proportion to the number of atoms.
+*/
+void infer_bonds(MoleculeData* data)
+{
+    StopWatch stop_watch;
+
+    const std::vector<Eigen::Vector3f>& positions = data->positions;
+    size_t num_atoms = positions.size();
+    data->bonds.clear();
+
+    if (num_atoms < 2) {
+        return;
+    }
+
+    std::vector<float> radii(num_atoms);
+    float max_radius = 0;
+    Eigen::Vector3f lo = positions[0];
+    Eigen::Vector3f hi = positions[0];
+
+    for (size_t i = 0; i < num_atoms; i++) {
+        radii[i] = get_element_info(data->elements[i]).covalent_radius;
+        max_radius = std::max(max_radius, radii[i]);
+        lo = lo.cwiseMin(positions[i]);
+        hi = hi.cwiseMax(positions[i]);
+    }
+
+    // Sparse molecules get wider cells, so that there are not many more
+    // cells than atoms
+    float cell_size = 2 * max_radius + kBondTolerance;
+    size_t dims[3];
+    for (;;) {
+        for (int k = 0; k < 3; k++) {
+            dims[k] = static_cast<size_t>((hi[k] - lo[k]) / cell_size) + 1;
+        }
+        if (static_cast<double>(dims[0]) * dims[1] * dims[2] <= 8.0 * num_atoms) {
+            break;
+        }
+        cell_size *= 2;
+    }
+
+    auto find_cell = [&](const Eigen::Vector3f& p, size_t* c) {
+        for (int k = 0; k < 3; k++) {
+            c[k] = std::min(static_cast<size_t>((p[k] - lo[k]) / cell_size), dims[k] - 1);
+        }
+        return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+    };
+
+    // Counting sort of the atoms by cell
+    size_t num_cells = dims[0] * dims[1] * dims[2];
+    std::vector<std::uint32_t> cell_starts(num_cells + 1, 0);
+    std::vector<std::uint32_t> atom_cells(num_atoms);
+
+    for (size_t i = 0; i < num_atoms; i++) {
+        size_t c[3];
+        atom_cells[i] = static_cast<std::uint32_t>(find_cell(positions[i], c));
+        cell_starts[atom_cells[i] + 1]++;
+    }
+
+    for (size_t i = 0; i < num_cells; i++) {
+        cell_starts[i + 1] += cell_starts[i];
+    }
+
+    std::vector<std::uint32_t> cell_atoms(num_atoms);
+    std::vector<std::uint32_t> fill(cell_starts.begin(), cell_starts.end() - 1);
+    for (size_t i = 0; i < num_atoms; i++) {
+        cell_atoms[fill[atom_cells[i]]++] = static_cast<std::uint32_t>(i);
+    }
+
+    // Bonded when closer than the sum of the covalent radii and a margin
+    for (size_t i = 0; i < num_atoms; i++) {
+        size_t c[3];
+        find_cell(positions[i], c);
+
+        size_t lo_c[3], hi_c[3];
+        for (int k = 0; k < 3; k++) {
+            lo_c[k] = (c[k] > 0) ? c[k] - 1 : 0;
+            hi_c[k] = std::min(c[k] + 1, dims[k] - 1);
+        }
+
+        for (size_t cz = lo_c[2]; cz <= hi_c[2]; cz++) {
+            for (size_t cy = lo_c[1]; cy <= hi_c[1]; cy++) {
+                for (size_t cx = lo_c[0]; cx <= hi_c[0]; cx++) {
+                    size_t cell = (cz * dims[1] + cy) * dims[0] + cx;
+
+                    for (std::uint32_t k = cell_starts[cell]; k < cell_starts[cell + 1]; k++) {
+                        std::uint32_t j = cell_atoms[k];
+                        if (j <= i) {
+                            continue;
+                        }
+
+                        float max_dist = radii[i] + radii[j] + kBondTolerance;
+                        float dist2 = (positions[j] - positions[i]).squaredNorm();
+                        if (dist2 < max_dist * max_dist && dist2 > kMinBondLength * kMinBondLength) {
+                            data->bonds.push_back(MoleculeBond{static_cast<std::uint32_t>(i), j});
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::stringstream convert;
+    convert << "Found " << data->bonds.size() << " bonds between " << num_atoms
+            << " atoms in " << stop_watch.elapsed() << " s";
+    LOG_INFO(convert.str());
+}
+
+
+// Lower case extension of a file name
+static std::string get_extension(const std::string& filename)
+{
+    size_t idx = filename.rfind(".");
+    std::string ext = (idx == std::string::npos) ? "" : filename.substr(idx + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+
+bool read_molecule_file(const std::string& filename, unsigned int num_threads,
+                        MoleculeData* data)
+{
+    std::string ext = get_extension(filename);
+
+    if (ext == "mol2") {
+        return read_mol2_file(filename, num_threads, data);
+    }
+
+    bool has_read = false;
+    if (ext == "pdb" || ext == "ent") {
+        has_read = read_pdb_file(filename, data);
+    }
+    else if (ext == "cif" || ext == "mmcif") {
+        has_read = read_cif_file(filename, data);
+    }
+    else if (ext == "xyz") {
+        has_read = read_xyz_file(filename, data);
+    }
+    else {
+        LOG_ERROR(std::string("Unknown molecule file extension " + ext));
+        return false;
+    }
+
+    // These formats list no bonds, or only some of them
+    if (has_read) {
+        infer_bonds(data);
+    }
+    return has_read;
+}
+
+
+
+bool TrajectoryReader::open(const std::string& filename)
+{
+    std::string ext = get_extension(filename);
+
+    if (ext != "xyz" && ext != "pdb" && ext != "ent") {
+        LOG_ERROR(std::string("Trajectories are XYZ or PDB files, not " + filename));
+        return false;
+    }
+
+    if (!file_.open(filename)) {
+        LOG_ERROR(std::string("Cannot open trajectory file " + filename));
+        return false;
+    }
+
+    filename_ = filename;
+    is_pdb_ = (ext != "xyz");
+    next_ = file_.begin();
+    num_frames_ = 0;
+    return true;
+}
+
+
+bool TrajectoryReader::read_frame(std::vector<Eigen::Vector3f>* positions)
+{
+    if (!next_ || next_ >= file_.end()) {
+        return false;
+    }
+
+    frame_.positions.clear();
+    frame_.elements.clear();
+
+    ParseError error;
+    const char* frame_end = is_pdb_ ?
+            parse_pdb_model(next_, file_.end(), &frame_, &error) :
+            parse_xyz_frame(next_, file_.end(), &frame_, &error);
+
+    if (!error.what.empty()) {
+        log_error(filename_, file_, error);
+        next_ = file_.end();
+        return false;
+    }
+
+    // Blanks after the last XYZ frame are not another frame
+    next_ = is_pdb_ ? frame_end : skip_blank_lines(frame_end, file_.end());
+    file_.release(next_);
+
+    // Trailing records after the last model or frame
+    if (frame_.positions.empty()) {
+        return false;
+    }
+
+    positions->swap(frame_.positions);
+    num_frames_++;
+    return true;
+}
+
+
+unsigned int TrajectoryReader::get_num_frames() const
+{
+    return num_frames_;
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef MOLFILE_H
+#define MOLFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "mappedfile.h"
+
+
+namespace mrtp {
+
+struct MoleculeBond
+{
+    std::uint32_t first;
+    std::uint32_t second;
+};
+
+
+/*
+Atoms and bonds as read from a molecule file, before they are placed in
+the scene. Elements index the element table, and bonds index the atoms
+in file order.
+*/
+struct MoleculeData
+{
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<std::uint8_t> elements;
+    std::vector<MoleculeBond> bonds;
+};
+
+
+// Reads the first molecule of a Tripos MOL2 file. Its atom and bond
+// records are split into chunks for the given number of threads, 0 for
+// one per core. Errors are logged with their line number.
+bool read_mol2_file(const std::string&, unsigned int, MoleculeData*);
+
+// Atoms of the first model of a PDB file, of the atom_site loop of an
+// mmCIF file, and of the first frame of an XYZ file. Bonds are left out.
+bool read_pdb_file(const std::string&, MoleculeData*);
+bool read_cif_file(const std::string&, MoleculeData*);
+bool read_xyz_file(const std::string&, MoleculeData*);
+
+// Bonds between atoms closer than the sum of their covalent radii
+void infer_bonds(MoleculeData*);
+
+// Picks the reader by the file extension, and adds bonds from covalent
+// radii to formats which do not list them
+bool read_molecule_file(const std::string&, unsigned int, MoleculeData*);
+
+
+/*
+Frames of a multi-frame XYZ file or of a multi-model PDB file, read one
+after the other from a memory map. Pages of the frames already read are
+given back, so a trajectory takes the memory of about one frame however
+long it is.
+*/
+class TrajectoryReader
+{
+public:
+    TrajectoryReader() = default;
+    ~TrajectoryReader() = default;
+
+    bool open(const std::string&);
+
+    // Atom positions of the next frame in file order, swapped into the
+    // vector. Returns false past the last frame and on errors.
+    bool read_frame(std::vector<Eigen::Vector3f>*);
+
+    // Frames read so far
+    unsigned int get_num_frames() const;
+
+private:
+    std::string filename_;
+    MappedFile file_;
+    bool is_pdb_ = false;
+    const char* next_ = nullptr;
+    unsigned int num_frames_ = 0;
+
+    // Reused from frame to frame
+    MoleculeData frame_;
+};
+
+}
+
+#endif // MOLFILE_H
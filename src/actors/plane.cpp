@@ -9,8 +9,8 @@
 namespace mrtp {
 
 SimplePlane::SimplePlane(const StandardBasis& local_basis, 
-        std::shared_ptr<TextureMapper> texture_mapper_ptr) : 
-    ActorBase(local_basis, texture_mapper_ptr) {
+        MaterialId material) : 
+    ActorBase(local_basis, material) {
 
 }
 
@@ -20,18 +20,28 @@ bool SimplePlane::has_shadow() const {
 }
 
 
+bool SimplePlane::is_planar() const {
+    return true;
+}
+
+
+bool SimplePlane::calculate_bounds(BoundingBox*) const {
+    return false;
+}
+
+
 Vector3d SimplePlane::calculate_normal_at_hit(const Vector3d& hit) const {
     return local_basis_.vk;
 }
 
 
-double SimplePlane::solve_light_ray(const Vector3d& O, const Vector3d& D, 
-        double min_dist, double max_dist) const 
+double solve_plane_ray(const StandardBasis& basis, const Vector3d& O,
+                       const Vector3d& D, double min_dist, double max_dist)
 {
-    double t = D.dot(local_basis_.vk);
+    double t = D.dot(basis.vk);
     if (t > kMyZero || t < -kMyZero) {
-        Vector3d v = O - local_basis_.o;
-        double d = -v.dot(local_basis_.vk) / t;
+        Vector3d v = O - basis.o;
+        double d = -v.dot(basis.vk) / t;
         if (d > min_dist && d < max_dist) {
             return d;
         }
@@ -40,7 +50,14 @@ double SimplePlane::solve_light_ray(const Vector3d& O, const Vector3d& D,
 }
 
 
-void create_plane(TextureFactory* texture_factory,
+double SimplePlane::solve_light_ray(const Vector3d& O, const Vector3d& D, 
+        double min_dist, double max_dist) const 
+{
+    return solve_plane_ray(local_basis_, O, D, min_dist, max_dist);
+}
+
+
+void create_plane(MaterialTable* materials,
                   std::shared_ptr<ConfigTable> plane_items,
                   std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
@@ -68,14 +85,13 @@ void create_plane(TextureFactory* texture_factory,
     StandardBasis plane_basis;
     set_basis(&plane_basis, plane_center_vec, plane_vec_i, plane_vec_j, plane_normal_vec);
 
-    auto texture_mapper_ptr = create_texture_mapper(
-            plane_items, ActorType::Plane, texture_factory);
-    if (!texture_mapper_ptr) {
+    MaterialId material = 0;
+    if (!create_material(materials, plane_items, ActorType::Plane, &material)) {
         return;
     }
 
     actor_ptrs->push_back(std::shared_ptr<ActorBase>(
-                new SimplePlane(plane_basis, texture_mapper_ptr)));
+                new SimplePlane(plane_basis, material)));
 }
 
 
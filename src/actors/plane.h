@@ -10,7 +10,7 @@ namespace mrtp {
 class SimplePlane : public ActorBase 
 {
 public:
-    SimplePlane(const StandardBasis&, std::shared_ptr<TextureMapper>);
+    SimplePlane(const StandardBasis&, MaterialId);
     SimplePlane() = delete;
 
     ~SimplePlane() override = default;
@@ -20,9 +20,15 @@ public:
 
     Vector3d calculate_normal_at_hit(const Vector3d&) const override;
     bool has_shadow() const override;
+    bool is_planar() const override;
+    bool calculate_bounds(BoundingBox*) const override;
 };
 
-void create_plane(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
+// Distance to an infinite plane through the origin of a basis, normal to vk
+double solve_plane_ray(const StandardBasis&, const Vector3d&, const Vector3d&,
+                       double, double);
+
+void create_plane(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
 
 }
 
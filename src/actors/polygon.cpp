@@ -1,13 +1,15 @@
 #include "actors/polygon.h"
 #include "actors/plane.h"
+#include "actors/tools.h"
+#include "raster.h"
 
 
 namespace mrtp {
 
 SimplePolygon::SimplePolygon(const StandardBasis& local_basis,
-                             std::shared_ptr<TextureMapper> texture_mapper,
+                             MaterialId material,
                              double xsize, double ysize)
-    : ActorBase(local_basis, texture_mapper)
+    : ActorBase(local_basis, material)
     , xsize_(xsize), ysize_(ysize)
 {
 }
@@ -16,8 +18,7 @@ SimplePolygon::SimplePolygon(const StandardBasis& local_basis,
 double SimplePolygon::solve_light_ray(const Vector3d& O, const Vector3d& D,
                                       double min_dist, double max_dist) const
 {
-    SimplePlane plane(local_basis_, texture_mapper_);
-    double t = plane.solve_light_ray(O, D, min_dist, max_dist);
+    double t = solve_plane_ray(local_basis_, O, D, min_dist, max_dist);
 
     if (t > 0) {
         Vector3d X = (D * t) + O - local_basis_.o;
@@ -34,6 +35,28 @@ double SimplePolygon::solve_light_ray(const Vector3d& O, const Vector3d& D,
 }
 
 
+bool SimplePolygon::occludes(const Vector3d& O, const Vector3d& D,
+                             double max_dist) const
+{
+    double t = D.dot(local_basis_.vk);
+    if (t <= kMyZero && t >= -kMyZero) {
+        return false;
+    }
+
+    Vector3d v = O - local_basis_.o;
+    double d = -v.dot(local_basis_.vk) / t;
+    if (d <= 0 || d >= max_dist) {
+        return false;
+    }
+
+    Vector3d X = v + d * D;
+    double vx = X.dot(local_basis_.vi);
+    double vy = X.dot(local_basis_.vj);
+
+    return vx >= -xsize_ && vx <= xsize_ && vy >= -ysize_ && vy <= ysize_;
+}
+
+
 Vector3d SimplePolygon::calculate_normal_at_hit(const Vector3d& hit) const
 {
     return local_basis_.vk;
@@ -46,4 +69,32 @@ bool SimplePolygon::has_shadow() const
 }
 
 
+bool SimplePolygon::is_planar() const
+{
+    return true;
+}
+
+
+bool SimplePolygon::calculate_bounds(BoundingBox* box) const
+{
+    Vector3d extent = xsize_ * local_basis_.vi.cwiseAbs() + ysize_ * local_basis_.vj.cwiseAbs();
+
+    box->lo = local_basis_.o - extent;
+    box->hi = local_basis_.o + extent;
+    return true;
+}
+
+
+// Drawn as two triangles
+void SimplePolygon::rasterize(VisibilityBuffer* buffer) const
+{
+    Vector3d x = xsize_ * local_basis_.vi;
+    Vector3d y = ysize_ * local_basis_.vj;
+    const Vector3d& o = local_basis_.o;
+
+    buffer->draw_triangle(o - x - y, o + x - y, o + x + y, this, 0);
+    buffer->draw_triangle(o - x - y, o + x + y, o - x + y, this, 0);
+}
+
+
 }
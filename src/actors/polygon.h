@@ -9,7 +9,7 @@ namespace mrtp {
 class SimplePolygon : public ActorBase
 {
 public:
-    SimplePolygon(const StandardBasis&, std::shared_ptr<TextureMapper>,
+    SimplePolygon(const StandardBasis&, MaterialId,
                   double, double);
     SimplePolygon() = delete;
 
@@ -20,6 +20,11 @@ public:
 
     Vector3d calculate_normal_at_hit(const Vector3d&) const override;
     bool has_shadow() const override;
+    bool is_planar() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
 
 private:
     double xsize_;
@@ -4,13 +4,14 @@
 #include "actors/tools.h"
 
 #include "logger.h"
+#include "raster.h"
 
 
 namespace mrtp {
 
 SimpleSphere::SimpleSphere(const StandardBasis& local_basis, double radius, 
-        std::shared_ptr<TextureMapper> texture_mapper_ptr) : 
-    ActorBase(local_basis, texture_mapper_ptr), 
+        MaterialId material) : 
+    ActorBase(local_basis, material), 
     radius_(radius) {
 
 }
@@ -21,20 +22,33 @@ bool SimpleSphere::has_shadow() const {
 }
 
 
+bool SimpleSphere::calculate_bounds(BoundingBox* box) const {
+    Vector3d r{radius_, radius_, radius_};
+    box->lo = local_basis_.o - r;
+    box->hi = local_basis_.o + r;
+    return true;
+}
+
+
+void SimpleSphere::rasterize(VisibilityBuffer* buffer) const {
+    buffer->draw_sphere(local_basis_.o, radius_, this, 0);
+}
+
+
 Vector3d SimpleSphere::calculate_normal_at_hit(const Vector3d& hit) const {
     Vector3d t = hit - local_basis_.o;
     return t * (1 / t.norm());
 }
 
 
-double SimpleSphere::solve_light_ray(const Vector3d& O, const Vector3d& D, 
-        double min_dist, double max_dist) const 
+double solve_sphere_ray(const Vector3d& center, double radius,
+        const Vector3d& O, const Vector3d& D, double min_dist, double max_dist)
 {
-    Vector3d t = O - local_basis_.o;
+    Vector3d t = O - center;
 
     double a = D.dot(D);
     double b = 2 * D.dot(t);
-    double c = t.dot(t) - radius_ * radius_;
+    double c = t.dot(t) - radius * radius;
     double d = solve_quadratic(a, b, c);
     
     if (d > min_dist && d < max_dist) {
@@ -44,7 +58,36 @@ double SimpleSphere::solve_light_ray(const Vector3d& O, const Vector3d& D,
 }
 
 
-void create_sphere(TextureFactory* texture_factory,
+double SimpleSphere::solve_light_ray(const Vector3d& O, const Vector3d& D, 
+        double min_dist, double max_dist) const 
+{
+    return solve_sphere_ray(local_basis_.o, radius_, O, D, min_dist, max_dist);
+}
+
+
+bool SimpleSphere::occludes(const Vector3d& O, const Vector3d& D,
+        double max_dist) const
+{
+    Vector3d t = O - local_basis_.o;
+
+    // Origin inside the sphere or sphere behind the origin
+    double c = t.dot(t) - radius_ * radius_;
+    double b = 2 * D.dot(t);
+    if (c <= 0 || b >= 0) {
+        return false;
+    }
+
+    double a = D.dot(D);
+    if (b * b - 4 * a * c < 0) {
+        return false;
+    }
+
+    double d = solve_quadratic(a, b, c);
+    return d > 0 && d < max_dist;
+}
+
+
+void create_sphere(MaterialTable* materials,
                    std::shared_ptr<ConfigTable> sphere_items,
                    std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
@@ -71,14 +114,13 @@ void create_sphere(TextureFactory* texture_factory,
     set_basis(&sphere_basis, sphere_center_vec, sphere_vec_i,
               sphere_vec_j, sphere_axis_vec);
 
-    auto texture_mapper_ptr = create_texture_mapper(
-                sphere_items, ActorType::Sphere, texture_factory);
-    if (!texture_mapper_ptr) {
+    MaterialId material = 0;
+    if (!create_material(materials, sphere_items, ActorType::Sphere, &material)) {
         return;
     }
 
     auto sphere_ptr = std::shared_ptr<ActorBase>(
-            new SimpleSphere(sphere_basis, sphere_radius, texture_mapper_ptr));
+            new SimpleSphere(sphere_basis, sphere_radius, material));
 
     actor_ptrs->push_back(sphere_ptr);
 }
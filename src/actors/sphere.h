@@ -10,7 +10,7 @@ namespace mrtp {
 class SimpleSphere : public ActorBase 
 {
 public:
-    SimpleSphere(const StandardBasis&, double, std::shared_ptr<TextureMapper>);
+    SimpleSphere(const StandardBasis&, double, MaterialId);
     SimpleSphere() = delete;
 
     ~SimpleSphere() override = default;
@@ -20,12 +20,20 @@ public:
 
     Vector3d calculate_normal_at_hit(const Vector3d&) const override;
     bool has_shadow() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
 
 private:
     double radius_;
 };
 
-void create_sphere(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*); 
+// Nearest root of a ray and a sphere, shared with batched actors
+double solve_sphere_ray(const Vector3d&, double, const Vector3d&, const Vector3d&,
+                        double, double);
+
+void create_sphere(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*); 
 
 }
 
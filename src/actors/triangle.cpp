@@ -4,6 +4,7 @@
 #include "actors/plane.h"
 
 #include "logger.h"
+#include "raster.h"
 #include "tools.h"
 
 
@@ -11,8 +12,8 @@ namespace mrtp {
 
 SimpleTriangle::SimpleTriangle(const StandardBasis& local_basis, 
         const Vector3d& A, const Vector3d& B, const Vector3d& C, 
-        std::shared_ptr<TextureMapper> texture_mapper_ptr) : 
-    ActorBase(local_basis, texture_mapper_ptr), 
+        MaterialId material) : 
+    ActorBase(local_basis, material), 
     A_(A), B_(B), C_(C) 
 {
     TA_ = local_basis_.vk.cross(A - C);
@@ -26,6 +27,23 @@ bool SimpleTriangle::has_shadow() const {
 }
 
 
+bool SimpleTriangle::is_planar() const {
+    return true;
+}
+
+
+bool SimpleTriangle::calculate_bounds(BoundingBox* box) const {
+    box->lo = A_.cwiseMin(B_).cwiseMin(C_);
+    box->hi = A_.cwiseMax(B_).cwiseMax(C_);
+    return true;
+}
+
+
+void SimpleTriangle::rasterize(VisibilityBuffer* buffer) const {
+    buffer->draw_triangle(A_, B_, C_, this, 0);
+}
+
+
 Vector3d SimpleTriangle::calculate_normal_at_hit(const Vector3d& hit) const {
     return local_basis_.vk;
 }
@@ -34,8 +52,7 @@ Vector3d SimpleTriangle::calculate_normal_at_hit(const Vector3d& hit) const {
 double SimpleTriangle::solve_light_ray(const Vector3d& O, const Vector3d& D, 
         double min_dist, double max_dist) const
 {
-    SimplePlane plane(local_basis_, texture_mapper_);
-    double t = plane.solve_light_ray(O, D, min_dist, max_dist);
+    double t = solve_plane_ray(local_basis_, O, D, min_dist, max_dist);
     
     if (t > 0) {
         Vector3d X = O + t * D;
@@ -50,7 +67,27 @@ double SimpleTriangle::solve_light_ray(const Vector3d& O, const Vector3d& D,
 }
 
 
-void create_triangle(TextureFactory* texture_factory,
+bool SimpleTriangle::occludes(const Vector3d& O, const Vector3d& D,
+        double max_dist) const
+{
+    double t = D.dot(local_basis_.vk);
+    if (t <= kMyZero && t >= -kMyZero) {
+        return false;
+    }
+
+    double d = -(O - local_basis_.o).dot(local_basis_.vk) / t;
+    if (d <= 0 || d >= max_dist) {
+        return false;
+    }
+
+    Vector3d X = O + d * D;
+    return (X - A_).dot(TA_) > 0 &&
+           (X - B_).dot(TB_) > 0 &&
+           (X - C_).dot(TC_) > 0;
+}
+
+
+void create_triangle(MaterialTable* materials,
                      std::shared_ptr<ConfigTable> items,
                      std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) 
 {
@@ -84,13 +121,13 @@ void create_triangle(TextureFactory* texture_factory,
     StandardBasis local_basis;
     set_basis(&local_basis, vec_o, vec_i, vec_j, vec_k);
 
-    auto texture_mapper_ptr = create_dummy_mapper(items, "color", "reflect");
-    if (!texture_mapper_ptr) {
+    MaterialId material = 0;
+    if (!create_solid_material(materials, items, "color", "reflect", &material)) {
         return;
     }
 
     auto new_triangle_ptr = std::shared_ptr<ActorBase>(
-                new SimpleTriangle(local_basis, A, B, C, texture_mapper_ptr));
+                new SimpleTriangle(local_basis, A, B, C, material));
 
     actor_ptrs->push_back(new_triangle_ptr);
 }
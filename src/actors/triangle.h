@@ -11,7 +11,7 @@ class SimpleTriangle : public ActorBase
 {
 public:
     SimpleTriangle(const StandardBasis&, const Vector3d&, const Vector3d&, 
-            const Vector3d&, std::shared_ptr<TextureMapper>);
+            const Vector3d&, MaterialId);
     SimpleTriangle() = delete;
 
     ~SimpleTriangle() override = default;
@@ -21,6 +21,11 @@ public:
 
     Vector3d calculate_normal_at_hit(const Vector3d&) const override;
     bool has_shadow() const override;
+    bool is_planar() const override;
+    bool calculate_bounds(BoundingBox*) const override;
+    void rasterize(VisibilityBuffer*) const override;
+
+    bool occludes(const Vector3d&, const Vector3d&, double) const override;
 
 private:
     Vector3d A_;
@@ -31,7 +36,7 @@ private:
     Vector3d TC_;
 };
 
-void create_triangle(TextureFactory*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
+void create_triangle(MaterialTable*, std::shared_ptr<ConfigTable>, std::vector<std::shared_ptr<ActorBase>>*);
 
 }
 
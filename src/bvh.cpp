@@ -0,0 +1,250 @@
+#include <algorithm>
+
+#include "bvh.h"
+
+
+namespace mrtp {
+
+// Padding of primitive boxes against rounding in the slab test
+static const double kBoundsPadding = 1e-6;
+
+static const unsigned int kNumBins = 16;
+static const unsigned int kMaxLeafSize = 16;
+
+
+struct BuildItem
+{
+    BoundingBox box;
+    Vector3d centroid;
+    unsigned int index;
+};
+
+
+class BvhBuilder
+{
+public:
+    BvhBuilder(std::vector<BvhNode>* nodes,
+               std::vector<unsigned int>* indices,
+               unsigned int leaf_size,
+               unsigned int max_depth)
+        : nodes_(nodes)
+        , indices_(indices)
+        , leaf_size_(leaf_size)
+        , max_depth_(max_depth)
+    {
+    }
+
+    void build(std::vector<BuildItem>* items)
+    {
+        items_ = items;
+
+        nodes_->clear();
+        nodes_->reserve(2 * items_->size());
+        nodes_->push_back(BvhNode());
+
+        build_r(0, 0, static_cast<unsigned int>(items_->size()), 0);
+        nodes_->shrink_to_fit();
+
+        indices_->clear();
+        indices_->reserve(items_->size());
+        for (const BuildItem& item : *items_) {
+            indices_->push_back(item.index);
+        }
+    }
+
+private:
+    void make_leaf(BvhNode* node, unsigned int begin, unsigned int end)
+    {
+        node->first = begin;
+        node->count = end - begin;
+    }
+
+    void build_r(unsigned int node_index, unsigned int begin,
+                 unsigned int end, unsigned int depth)
+    {
+        BoundingBox node_box;
+        BoundingBox centroid_box;
+
+        for (unsigned int i = begin; i < end; i++) {
+            node_box.extend((*items_)[i].box);
+            centroid_box.extend((*items_)[i].centroid);
+        }
+
+        BvhNode* node = &(*nodes_)[node_index];
+        node->lo = node_box.lo;
+        node->hi = node_box.hi;
+
+        unsigned int num_items = end - begin;
+        if (num_items <= leaf_size_ || depth + 2 >= max_depth_) {
+            make_leaf(node, begin, end);
+            return;
+        }
+
+        // Find the cheapest split over binned centroids
+        double best_cost = std::numeric_limits<double>::max();
+        int best_axis = -1;
+        unsigned int best_bin = 0;
+
+        for (int axis = 0; axis < 3; axis++) {
+            double axis_lo = centroid_box.lo[axis];
+            double axis_span = centroid_box.hi[axis] - axis_lo;
+            if (axis_span <= 0) {
+                continue;
+            }
+
+            BoundingBox bin_boxes[kNumBins];
+            unsigned int bin_counts[kNumBins] = {};
+
+            double scale = kNumBins / axis_span;
+            for (unsigned int i = begin; i < end; i++) {
+                unsigned int bin = bin_index((*items_)[i].centroid[axis], axis_lo, scale);
+                bin_counts[bin]++;
+                bin_boxes[bin].extend((*items_)[i].box);
+            }
+
+            // Sweep from the right to collect suffix areas
+            double right_areas[kNumBins];
+            unsigned int right_counts[kNumBins];
+
+            BoundingBox right_box;
+            unsigned int right_count = 0;
+            for (unsigned int b = kNumBins - 1; b > 0; b--) {
+                right_box.extend(bin_boxes[b]);
+                right_count += bin_counts[b];
+                right_areas[b] = right_box.area();
+                right_counts[b] = right_count;
+            }
+
+            BoundingBox left_box;
+            unsigned int left_count = 0;
+            for (unsigned int b = 0; b < kNumBins - 1; b++) {
+                left_box.extend(bin_boxes[b]);
+                left_count += bin_counts[b];
+
+                if (!left_count || !right_counts[b + 1]) {
+                    continue;
+                }
+
+                double cost = left_count * left_box.area() +
+                              right_counts[b + 1] * right_areas[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        double leaf_cost = num_items * node_box.area();
+        bool split_pays = best_axis >= 0 && best_cost < leaf_cost;
+
+        unsigned int middle = begin;
+
+        if (split_pays || num_items > kMaxLeafSize) {
+            if (best_axis >= 0) {
+                double axis_lo = centroid_box.lo[best_axis];
+                double scale = kNumBins / (centroid_box.hi[best_axis] - axis_lo);
+
+                auto it = std::partition(items_->begin() + begin, items_->begin() + end,
+                    [&](const BuildItem& item) {
+                        return bin_index(item.centroid[best_axis], axis_lo, scale) <= best_bin;
+                    });
+                middle = static_cast<unsigned int>(it - items_->begin());
+            } else {
+                // All centroids coincide, split in half
+                middle = begin + num_items / 2;
+            }
+        }
+
+        if (middle == begin || middle == end) {
+            make_leaf(node, begin, end);
+            return;
+        }
+
+        unsigned int left = static_cast<unsigned int>(nodes_->size());
+        nodes_->push_back(BvhNode());
+        nodes_->push_back(BvhNode());
+
+        // The node may have moved after push_back
+        (*nodes_)[node_index].first = left;
+        (*nodes_)[node_index].count = 0;
+
+        build_r(left, begin, middle, depth + 1);
+        build_r(left + 1, middle, end, depth + 1);
+    }
+
+    static unsigned int bin_index(double value, double axis_lo, double scale)
+    {
+        double bin = (value - axis_lo) * scale;
+        if (bin < 0) {
+            return 0;
+        }
+
+        unsigned int b = static_cast<unsigned int>(bin);
+        return (b < kNumBins) ? b : kNumBins - 1;
+    }
+
+    std::vector<BvhNode>* nodes_;
+    std::vector<unsigned int>* indices_;
+    std::vector<BuildItem>* items_;
+
+    unsigned int leaf_size_;
+    unsigned int max_depth_;
+};
+
+
+void BoundingVolumeHierarchy::build(const std::vector<BoundingBox>& boxes,
+                                    unsigned int leaf_size)
+{
+    nodes_.clear();
+    indices_.clear();
+
+    if (boxes.empty()) {
+        return;
+    }
+
+    Vector3d padding{kBoundsPadding, kBoundsPadding, kBoundsPadding};
+
+    std::vector<BuildItem> items;
+    items.reserve(boxes.size());
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        BuildItem item;
+        item.box.lo = boxes[i].lo - padding;
+        item.box.hi = boxes[i].hi + padding;
+        item.centroid = boxes[i].center();
+        item.index = i;
+        items.push_back(item);
+    }
+
+    BvhBuilder builder(&nodes_, &indices_, leaf_size, kMaxDepth);
+    builder.build(&items);
+}
+
+
+bool BoundingVolumeHierarchy::is_empty() const
+{
+    return nodes_.empty();
+}
+
+
+const std::vector<unsigned int>& BoundingVolumeHierarchy::get_order() const
+{
+    return indices_;
+}
+
+
+size_t BoundingVolumeHierarchy::get_memory_size() const
+{
+    return nodes_.capacity() * sizeof(BvhNode) +
+           indices_.capacity() * sizeof(unsigned int);
+}
+
+
+unsigned int BoundingVolumeHierarchy::get_num_nodes() const
+{
+    return static_cast<unsigned int>(nodes_.size());
+}
+
+
+} // namespace mrtp
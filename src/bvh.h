@@ -0,0 +1,283 @@
+#ifndef _BVH_H
+#define _BVH_H
+
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+struct BvhNode
+{
+    Vector3d lo;
+    Vector3d hi;
+    unsigned int first;  // first index for leaves, left child otherwise
+    unsigned int count;  // zero for inner nodes
+};
+
+
+/*
+Bounding volume hierarchy built with the surface area heuristic.
+The hierarchy only knows the boxes of its primitives. Queries take a
+callback which intersects the primitive with a given index and returns
+its distance, or -1 when missed.
+*/
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy() = default;
+    ~BoundingVolumeHierarchy() = default;
+
+    void build(const std::vector<BoundingBox>&, unsigned int = 4);
+
+    bool is_empty() const;
+    unsigned int get_num_nodes() const;
+    size_t get_memory_size() const;
+
+    // Visitor: double(unsigned int index, double max_dist)
+    template <typename F>
+    double find_closest(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Visitor: bool(unsigned int index, double max_dist)
+    template <typename F>
+    bool find_any(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Leaf visitors get the range [first, first + count) of get_order(),
+    // for owners which store their primitives in hierarchy order
+    template <typename F>
+    double find_closest_leaf(const Vector3d&, const Vector3d&, double, F) const;
+
+    template <typename F>
+    bool find_any_leaf(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Walks the nodes whose test gives a distance, nearer child first, and
+    // hands the leaves to the visitor. Used for bundles of rays.
+    // Test: double(const BvhNode&), Visitor: void(const BvhNode&)
+    template <typename T, typename F>
+    void visit_leaves(T, F) const;
+
+    // Primitive indices in the order the leaves refer to them
+    const std::vector<unsigned int>& get_order() const;
+
+private:
+    static const unsigned int kMaxDepth = 64;
+
+    std::vector<BvhNode> nodes_;
+    std::vector<unsigned int> indices_;
+};
+
+
+// Distance to the entry point of a box, or -1 when missed
+inline double intersect_box(const Vector3d& lo, const Vector3d& hi,
+                            const Vector3d& O, const Vector3d& inv_D,
+                            double max_dist)
+{
+    double t_near = 0;
+    double t_far = max_dist;
+
+    // Written without branches so that it compiles to min and max
+    for (int i = 0; i < 3; i++) {
+        double t0 = (lo[i] - O[i]) * inv_D[i];
+        double t1 = (hi[i] - O[i]) * inv_D[i];
+
+        double t_min = (t0 > t1) ? t1 : t0;
+        double t_max = (t0 > t1) ? t0 : t1;
+
+        // NaN (ray parallel to and touching a slab) keeps the interval
+        t_near = (t_min > t_near) ? t_min : t_near;
+        t_far = (t_max < t_far) ? t_max : t_far;
+    }
+
+    return (t_near <= t_far) ? t_near : -1;
+}
+
+
+template <typename F>
+double BoundingVolumeHierarchy::find_closest(const Vector3d& O,
+                                             const Vector3d& D,
+                                             double max_dist,
+                                             F visit) const
+{
+    return find_closest_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            double closest = -1;
+            for (unsigned int i = first; i < first + count; i++) {
+                double distance = visit(indices_[i], max_leaf_dist);
+                if (distance > 0 && distance < max_leaf_dist) {
+                    max_leaf_dist = distance;
+                    closest = distance;
+                }
+            }
+            return closest;
+        });
+}
+
+
+template <typename F>
+bool BoundingVolumeHierarchy::find_any(const Vector3d& O,
+                                       const Vector3d& D,
+                                       double max_dist,
+                                       F visit) const
+{
+    return find_any_leaf(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double max_leaf_dist) {
+            for (unsigned int i = first; i < first + count; i++) {
+                if (visit(indices_[i], max_leaf_dist)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+}
+
+
+template <typename F>
+double BoundingVolumeHierarchy::find_closest_leaf(const Vector3d& O,
+                                                  const Vector3d& D,
+                                                  double max_dist,
+                                                  F visit) const
+{
+    double closest = -1;
+    if (nodes_.empty()) {
+        return closest;
+    }
+
+    Vector3d inv_D = D.cwiseInverse();
+
+    unsigned int stack[kMaxDepth];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+
+        if (intersect_box(node.lo, node.hi, O, inv_D, max_dist) < 0) {
+            continue;
+        }
+
+        if (node.count) {
+            double distance = visit(node.first, node.count, max_dist);
+            if (distance > 0 && distance < max_dist) {
+                max_dist = distance;
+                closest = distance;
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        unsigned int left = node.first;
+        unsigned int right = node.first + 1;
+
+        double t_left = intersect_box(nodes_[left].lo, nodes_[left].hi, O, inv_D, max_dist);
+        double t_right = intersect_box(nodes_[right].lo, nodes_[right].hi, O, inv_D, max_dist);
+
+        if (t_left >= 0 && t_right >= 0) {
+            if (t_left < t_right) {
+                stack[stack_size++] = right;
+                stack[stack_size++] = left;
+            } else {
+                stack[stack_size++] = left;
+                stack[stack_size++] = right;
+            }
+        } else if (t_left >= 0) {
+            stack[stack_size++] = left;
+        } else if (t_right >= 0) {
+            stack[stack_size++] = right;
+        }
+    }
+
+    return closest;
+}
+
+
+template <typename F>
+bool BoundingVolumeHierarchy::find_any_leaf(const Vector3d& O,
+                                            const Vector3d& D,
+                                            double max_dist,
+                                            F visit) const
+{
+    if (nodes_.empty()) {
+        return false;
+    }
+
+    Vector3d inv_D = D.cwiseInverse();
+
+    unsigned int stack[kMaxDepth];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+
+        if (intersect_box(node.lo, node.hi, O, inv_D, max_dist) < 0) {
+            continue;
+        }
+
+        if (node.count) {
+            if (visit(node.first, node.count, max_dist)) {
+                return true;
+            }
+            continue;
+        }
+
+        stack[stack_size++] = node.first + 1;
+        stack[stack_size++] = node.first;
+    }
+
+    return false;
+}
+
+
+template <typename T, typename F>
+void BoundingVolumeHierarchy::visit_leaves(T test_node, F visit) const
+{
+    if (nodes_.empty()) {
+        return;
+    }
+
+    unsigned int stack[kMaxDepth];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+
+        // Visitors may have shortened the rays since the node was pushed
+        if (test_node(node) < 0) {
+            continue;
+        }
+
+        if (node.count) {
+            visit(node);
+            continue;
+        }
+
+        unsigned int left = node.first;
+        unsigned int right = node.first + 1;
+
+        double t_left = test_node(nodes_[left]);
+        double t_right = test_node(nodes_[right]);
+
+        if (t_left >= 0 && t_right >= 0) {
+            if (t_left < t_right) {
+                stack[stack_size++] = right;
+                stack[stack_size++] = left;
+            } else {
+                stack[stack_size++] = left;
+                stack[stack_size++] = right;
+            }
+        } else if (t_left >= 0) {
+            stack[stack_size++] = left;
+        } else if (t_right >= 0) {
+            stack[stack_size++] = right;
+        }
+    }
+}
+
+
+} // namespace mrtp
+
+#endif // _BVH_H
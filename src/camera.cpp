@@ -61,9 +61,40 @@ Eigen::Vector3d Camera::calculate_origin(unsigned int windowx,
 }
 
 
+// Pixel i covers the window from i - 0.5 to i + 0.5
+Eigen::Vector3d Camera::calculate_subpixel_origin(double windowx,
+                                                  double windowy) const {
+    return wo_ + windowx * wh_ + windowy * wv_;
+}
+
+
 Eigen::Vector3d Camera::calculate_direction(const Eigen::Vector3d& origin) const {
     Eigen::Vector3d direction = origin - eye_;
     return direction * (1 / direction.norm());
 }
 
+
+bool Camera::calculate_window_point(const Eigen::Vector3d& point,
+                                    double* windowx,
+                                    double* windowy) const {
+    // Axis from the eye through the window, which is perpendicular to it
+    Eigen::Vector3d i = wh_.cross(wv_);
+    i *= (1 / i.norm());
+
+    double depth = (point - eye_).dot(i);
+    if (depth <= 0) {
+        return false;
+    }
+
+    Eigen::Vector3d w = eye_ + (wo_ - eye_).dot(i) / depth * (point - eye_) - wo_;
+    *windowx = w.dot(wh_) / wh_.squaredNorm();
+    *windowy = w.dot(wv_) / wv_.squaredNorm();
+    return true;
+}
+
+
+const Eigen::Vector3d& Camera::get_eye() const {
+    return eye_;
+}
+
 } //namespace mrtp
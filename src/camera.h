@@ -15,8 +15,16 @@ public:
     void calculate_window(unsigned int width, unsigned int height, double perspective);
 
     Eigen::Vector3d calculate_origin(unsigned int windowx, unsigned int windowy) const;
+    Eigen::Vector3d calculate_subpixel_origin(double windowx, double windowy) const;
     Eigen::Vector3d calculate_direction(const Eigen::Vector3d& origin) const;
 
+    // Window coordinates of a point seen from the eye, in pixels, or false
+    // for points not in front of the eye
+    bool calculate_window_point(const Eigen::Vector3d& point, double* windowx, double* windowy) const;
+
+    // All primary rays pass through the eye
+    const Eigen::Vector3d& get_eye() const;
+
 private:
     double roll_;
 
@@ -1,6 +1,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <limits>
 #include <Eigen/Core>
 
 
@@ -16,6 +17,67 @@ struct StandardBasis
     Vector3d vk { 0, 0, 1 };
 };
 
+struct BoundingBox
+{
+    Vector3d lo { std::numeric_limits<double>::max(),
+                  std::numeric_limits<double>::max(),
+                  std::numeric_limits<double>::max() };
+    Vector3d hi { std::numeric_limits<double>::lowest(),
+                  std::numeric_limits<double>::lowest(),
+                  std::numeric_limits<double>::lowest() };
+
+    void extend(const Vector3d& v)
+    {
+        lo = lo.cwiseMin(v);
+        hi = hi.cwiseMax(v);
+    }
+
+    void extend(const BoundingBox& box)
+    {
+        lo = lo.cwiseMin(box.lo);
+        hi = hi.cwiseMax(box.hi);
+    }
+
+    Vector3d center() const
+    {
+        return (lo + hi) / 2;
+    }
+
+    double area() const
+    {
+        Vector3d e = hi - lo;
+        return 2 * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+    }
+};
+
+// Primitives recently tested by one ray, for structures which list a
+// primitive in several cells. Testing one again cannot find a closer hit.
+struct Mailbox
+{
+    static const unsigned int kSize = 8;
+
+    unsigned int indices[kSize];
+    unsigned int count = 0;
+    unsigned int next = 0;
+
+    // True when the primitive was tested already, otherwise remembers it
+    bool check(unsigned int index)
+    {
+        for (unsigned int i = 0; i < count; i++) {
+            if (indices[i] == index) {
+                return true;
+            }
+        }
+
+        indices[next] = index;
+        next = (next + 1) % kSize;
+        if (count < kSize) {
+            count++;
+        }
+        return false;
+    }
+};
+
 enum class ActorType 
 {
     Plane,
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+
+#include "grid.h"
+
+
+namespace mrtp {
+
+// Padding of primitive boxes against rounding at cell borders
+static const double kBoundsPadding = 1e-6;
+
+// Cells per primitive, molecules fill about one cell per atom with this
+static const double kCellDensity = 2;
+
+
+void UniformGrid::build(const std::vector<BoundingBox>& boxes, double slack)
+{
+    cell_starts_.clear();
+    indices_.clear();
+    resolution_[0] = resolution_[1] = resolution_[2] = 0;
+
+    if (boxes.empty()) {
+        return;
+    }
+
+    Vector3d padding{kBoundsPadding, kBoundsPadding, kBoundsPadding};
+
+    BoundingBox bounds;
+    for (const BoundingBox& box : boxes) {
+        bounds.extend(box);
+    }
+    Vector3d room = (bounds.hi - bounds.lo) * slack;
+    lo_ = bounds.lo - room - padding;
+    hi_ = bounds.hi + room + padding;
+
+    // Flat scenes still get cells of a sensible thickness
+    Vector3d extent = hi_ - lo_;
+    double min_extent = 1e-3 * extent.maxCoeff();
+    extent = extent.cwiseMax(Vector3d{min_extent, min_extent, min_extent});
+
+    double volume = extent[0] * extent[1] * extent[2];
+    double cell_edge = std::cbrt(volume / (kCellDensity * boxes.size()));
+
+    for (int a = 0; a < 3; a++) {
+        double r = std::ceil(extent[a] / cell_edge);
+        resolution_[a] = static_cast<int>(std::min(std::max(r, 1.0),
+                                                   static_cast<double>(kMaxResolution)));
+        cell_size_[a] = (hi_[a] - lo_[a]) / resolution_[a];
+    }
+
+    fill_cells(boxes);
+}
+
+
+bool UniformGrid::refit(const std::vector<BoundingBox>& boxes)
+{
+    if (cell_starts_.empty() || boxes.empty()) {
+        return false;
+    }
+
+    for (const BoundingBox& box : boxes) {
+        for (int a = 0; a < 3; a++) {
+            if (box.lo[a] < lo_[a] || box.hi[a] > hi_[a]) {
+                return false;
+            }
+        }
+    }
+
+    fill_cells(boxes);
+    return true;
+}
+
+
+// Lists the boxes in the cells of the current layout, reusing the arrays
+void UniformGrid::fill_cells(const std::vector<BoundingBox>& boxes)
+{
+    unsigned int num_cells = resolution_[0] * resolution_[1] * resolution_[2];
+
+    auto cell_range = [&](const BoundingBox& box, int a, int* c0, int* c1) {
+        int c_lo = static_cast<int>(std::floor((box.lo[a] - kBoundsPadding - lo_[a]) / cell_size_[a]));
+        int c_hi = static_cast<int>(std::floor((box.hi[a] + kBoundsPadding - lo_[a]) / cell_size_[a]));
+        *c0 = std::min(std::max(c_lo, 0), resolution_[a] - 1);
+        *c1 = std::min(std::max(c_hi, 0), resolution_[a] - 1);
+    };
+
+    // Count, then fill, as for the light buffer
+    std::vector<unsigned int> counts(num_cells, 0);
+
+    auto visit_cells = [&](const BoundingBox& box, auto visit) {
+        int x0, x1, y0, y1, z0, z1;
+        cell_range(box, 0, &x0, &x1);
+        cell_range(box, 1, &y0, &y1);
+        cell_range(box, 2, &z0, &z1);
+
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    visit((z * resolution_[1] + y) * resolution_[0] + x);
+                }
+            }
+        }
+    };
+
+    for (const BoundingBox& box : boxes) {
+        visit_cells(box, [&](unsigned int cell) {
+            counts[cell]++;
+        });
+    }
+
+    cell_starts_.resize(num_cells + 1);
+    cell_starts_[0] = 0;
+    for (unsigned int i = 0; i < num_cells; i++) {
+        cell_starts_[i + 1] = cell_starts_[i] + counts[i];
+    }
+
+    indices_.resize(cell_starts_[num_cells]);
+    std::copy(cell_starts_.begin(), cell_starts_.end() - 1, counts.begin());
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        visit_cells(boxes[i], [&](unsigned int cell) {
+            indices_[counts[cell]++] = i;
+        });
+    }
+}
+
+
+bool UniformGrid::is_empty() const
+{
+    return cell_starts_.empty();
+}
+
+
+unsigned int UniformGrid::get_num_cells() const
+{
+    return static_cast<unsigned int>(resolution_[0] * resolution_[1] * resolution_[2]);
+}
+
+
+size_t UniformGrid::get_memory_size() const
+{
+    return cell_starts_.capacity() * sizeof(unsigned int) +
+           indices_.capacity() * sizeof(unsigned int);
+}
+
+
+} // namespace mrtp
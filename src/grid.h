@@ -0,0 +1,245 @@
+#ifndef _GRID_H
+#define _GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+/*
+Uniform grid over the boxes of its primitives. Cells are about cubes, with
+a few primitives per cell on average, and list every primitive whose box
+overlaps them. Rays walk the cells they pierce in order (3D-DDA) and a
+mailbox skips most primitives met again in the next cells. Queries take
+the same callbacks as the hierarchy.
+*/
+class UniformGrid
+{
+public:
+    UniformGrid() = default;
+    ~UniformGrid() = default;
+
+    // Slack grows the grid by that share of its extent on each side, room
+    // for primitives which move before a refit
+    void build(const std::vector<BoundingBox>&, double = 0);
+
+    // Lists moved primitives again in the cells of the last build. Returns
+    // false, leaving the grid as it was, when one of them left the grid.
+    bool refit(const std::vector<BoundingBox>&);
+
+    bool is_empty() const;
+    unsigned int get_num_cells() const;
+    size_t get_memory_size() const;
+
+    // Visitor: double(unsigned int index, double max_dist)
+    template <typename F>
+    double find_closest(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Visitor: bool(unsigned int index, double max_dist)
+    template <typename F>
+    bool find_any(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Primitives listed in the cells which overlap a box, those in several
+    // cells once for each of them. Visitor: void(unsigned int index)
+    template <typename F>
+    void find_in_box(const BoundingBox&, F) const;
+
+private:
+    static const unsigned int kMaxResolution = 256;
+
+    // Visits the cells along a ray with the distance at which the ray
+    // leaves them, until the visitor returns true.
+    // Visitor: bool(unsigned int first, unsigned int last, double t_exit)
+    template <typename F>
+    void walk_cells(const Vector3d&, const Vector3d&, double, F) const;
+
+    void fill_cells(const std::vector<BoundingBox>&);
+
+    Vector3d lo_{0, 0, 0};
+    Vector3d hi_{0, 0, 0};
+    Vector3d cell_size_{1, 1, 1};
+    int resolution_[3] = {0, 0, 0};
+
+    // Primitives of cell i are [cell_starts_[i], cell_starts_[i + 1])
+    std::vector<unsigned int> cell_starts_;
+    std::vector<unsigned int> indices_;
+};
+
+
+template <typename F>
+void UniformGrid::walk_cells(const Vector3d& O,
+                             const Vector3d& D,
+                             double max_dist,
+                             F visit) const
+{
+    if (cell_starts_.empty()) {
+        return;
+    }
+
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // Clip the ray to the grid
+    double t_near = 0;
+    double t_far = max_dist;
+
+    for (int a = 0; a < 3; a++) {
+        if (D[a] == 0) {
+            if (O[a] < lo_[a] || O[a] > hi_[a]) {
+                return;
+            }
+            continue;
+        }
+
+        double t0 = (lo_[a] - O[a]) / D[a];
+        double t1 = (hi_[a] - O[a]) / D[a];
+        t_near = std::max(t_near, std::min(t0, t1));
+        t_far = std::min(t_far, std::max(t0, t1));
+    }
+
+    if (t_near > t_far) {
+        return;
+    }
+
+    Vector3d P = O + D * t_near;
+
+    int cell[3];
+    int step[3];
+    double t_next[3];
+    double t_delta[3];
+
+    for (int a = 0; a < 3; a++) {
+        int c = static_cast<int>((P[a] - lo_[a]) / cell_size_[a]);
+        cell[a] = std::min(std::max(c, 0), resolution_[a] - 1);
+
+        if (D[a] > 0) {
+            step[a] = 1;
+            t_next[a] = (lo_[a] + (cell[a] + 1) * cell_size_[a] - O[a]) / D[a];
+            t_delta[a] = cell_size_[a] / D[a];
+        } else if (D[a] < 0) {
+            step[a] = -1;
+            t_next[a] = (lo_[a] + cell[a] * cell_size_[a] - O[a]) / D[a];
+            t_delta[a] = -cell_size_[a] / D[a];
+        } else {
+            step[a] = 0;
+            t_next[a] = inf;
+            t_delta[a] = inf;
+        }
+    }
+
+    for (;;) {
+        int a = (t_next[0] < t_next[1]) ? ((t_next[0] < t_next[2]) ? 0 : 2)
+                                        : ((t_next[1] < t_next[2]) ? 1 : 2);
+        double t_exit = std::min(t_next[a], t_far);
+
+        unsigned int c = (cell[2] * resolution_[1] + cell[1]) * resolution_[0] + cell[0];
+        if (visit(cell_starts_[c], cell_starts_[c + 1], t_exit) || t_next[a] >= t_far) {
+            return;
+        }
+
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= resolution_[a]) {
+            return;
+        }
+        t_next[a] += t_delta[a];
+    }
+}
+
+
+template <typename F>
+double UniformGrid::find_closest(const Vector3d& O,
+                                 const Vector3d& D,
+                                 double max_dist,
+                                 F visit) const
+{
+    double closest = -1;
+    Mailbox mailbox;
+
+    walk_cells(O, D, max_dist,
+        [&](unsigned int first, unsigned int last, double t_exit) {
+            for (unsigned int i = first; i < last; i++) {
+                if (mailbox.check(indices_[i])) {
+                    continue;
+                }
+
+                double distance = visit(indices_[i], max_dist);
+                if (distance > 0 && distance < max_dist) {
+                    max_dist = distance;
+                    closest = distance;
+                }
+            }
+
+            // Hits beyond the cell may still be beaten in the next cells
+            return closest > 0 && closest <= t_exit;
+        });
+
+    return closest;
+}
+
+
+template <typename F>
+bool UniformGrid::find_any(const Vector3d& O,
+                           const Vector3d& D,
+                           double max_dist,
+                           F visit) const
+{
+    bool found = false;
+    Mailbox mailbox;
+
+    walk_cells(O, D, max_dist,
+        [&](unsigned int first, unsigned int last, double) {
+            for (unsigned int i = first; i < last; i++) {
+                if (!mailbox.check(indices_[i]) && visit(indices_[i], max_dist)) {
+                    found = true;
+                    break;
+                }
+            }
+            return found;
+        });
+
+    return found;
+}
+
+
+template <typename F>
+void UniformGrid::find_in_box(const BoundingBox& box, F visit) const
+{
+    if (cell_starts_.empty()) {
+        return;
+    }
+
+    int c0[3];
+    int c1[3];
+
+    for (int a = 0; a < 3; a++) {
+        if (box.hi[a] < lo_[a] || box.lo[a] > hi_[a]) {
+            return;
+        }
+
+        int c_lo = static_cast<int>(std::floor((box.lo[a] - lo_[a]) / cell_size_[a]));
+        int c_hi = static_cast<int>(std::floor((box.hi[a] - lo_[a]) / cell_size_[a]));
+        c0[a] = std::min(std::max(c_lo, 0), resolution_[a] - 1);
+        c1[a] = std::min(std::max(c_hi, 0), resolution_[a] - 1);
+    }
+
+    for (int z = c0[2]; z <= c1[2]; z++) {
+        for (int y = c0[1]; y <= c1[1]; y++) {
+            for (int x = c0[0]; x <= c1[0]; x++) {
+                unsigned int c = (z * resolution_[1] + y) * resolution_[0] + x;
+                for (unsigned int i = cell_starts_[c]; i < cell_starts_[c + 1]; i++) {
+                    visit(indices_[i]);
+                }
+            }
+        }
+    }
+}
+
+
+} // namespace mrtp
+
+#endif // _GRID_H
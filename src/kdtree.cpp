@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+
+#include "kdtree.h"
+
+
+namespace mrtp {
+
+// Padding of primitive boxes against rounding in the traversal
+static const double kBoundsPadding = 1e-6;
+
+// Costs of a traversal step and of a primitive test
+static const double kTraversalCost = 1;
+static const double kIntersectionCost = 1.5;
+
+// Splits which leave one side empty look this much cheaper
+static const double kEmptyBonus = 0.8;
+
+static const unsigned int kMaxLeafSize = 2;
+
+
+struct KdBuildItem
+{
+    BoundingBox box;
+    unsigned int index;
+};
+
+
+class KdTreeBuilder
+{
+public:
+    KdTreeBuilder(std::vector<KdNode>* nodes,
+                  std::vector<unsigned int>* indices,
+                  unsigned int max_depth)
+        : nodes_(nodes)
+        , indices_(indices)
+        , max_depth_(max_depth)
+    {
+    }
+
+    void build(std::vector<KdBuildItem>&& items, const BoundingBox& bounds)
+    {
+        nodes_->clear();
+        indices_->clear();
+        nodes_->push_back(KdNode());
+
+        build_r(0, std::move(items), bounds, 0);
+        nodes_->shrink_to_fit();
+        indices_->shrink_to_fit();
+    }
+
+private:
+    void make_leaf(unsigned int node_index, const std::vector<KdBuildItem>& items)
+    {
+        KdNode& node = (*nodes_)[node_index];
+        node.split = 0;
+        node.axis = 3;
+        node.first = static_cast<unsigned int>(indices_->size());
+        node.count = static_cast<unsigned int>(items.size());
+
+        for (const KdBuildItem& item : items) {
+            indices_->push_back(item.index);
+        }
+    }
+
+    // Cheapest split plane strictly inside the node, or false for none
+    bool find_split(const std::vector<KdBuildItem>& items, const BoundingBox& node_box,
+                    int* best_axis, double* best_split, double* best_cost) const
+    {
+        size_t num_items = items.size();
+        double node_area = node_box.area();
+        if (node_area <= 0) {
+            return false;
+        }
+
+        *best_cost = std::numeric_limits<double>::max();
+        *best_axis = -1;
+
+        std::vector<double> los(num_items);
+        std::vector<double> his(num_items);
+        std::vector<double> planars;
+
+        for (int axis = 0; axis < 3; axis++) {
+            double axis_lo = node_box.lo[axis];
+            double axis_hi = node_box.hi[axis];
+            if (axis_hi <= axis_lo) {
+                continue;
+            }
+
+            planars.clear();
+            for (size_t i = 0; i < num_items; i++) {
+                los[i] = std::max(items[i].box.lo[axis], axis_lo);
+                his[i] = std::min(items[i].box.hi[axis], axis_hi);
+                if (los[i] == his[i]) {
+                    planars.push_back(los[i]);
+                }
+            }
+
+            std::sort(los.begin(), los.end());
+            std::sort(his.begin(), his.end());
+            std::sort(planars.begin(), planars.end());
+
+            int b = (axis + 1) % 3;
+            int c = (axis + 2) % 3;
+            double eb = node_box.hi[b] - node_box.lo[b];
+            double ec = node_box.hi[c] - node_box.lo[c];
+
+            auto evaluate = [&](double split) {
+                if (split <= axis_lo || split >= axis_hi) {
+                    return;
+                }
+
+                // Left holds boxes starting before the plane and flat boxes
+                // on it, right holds boxes ending after it
+                size_t num_planar = std::upper_bound(planars.begin(), planars.end(), split) -
+                                    std::lower_bound(planars.begin(), planars.end(), split);
+                size_t num_left = std::lower_bound(los.begin(), los.end(), split) - los.begin() +
+                                  num_planar;
+                size_t num_right = his.end() - std::upper_bound(his.begin(), his.end(), split);
+
+                double left_width = split - axis_lo;
+                double right_width = axis_hi - split;
+                double left_area = 2 * (eb * ec + left_width * (eb + ec));
+                double right_area = 2 * (eb * ec + right_width * (eb + ec));
+
+                double cost = kTraversalCost + kIntersectionCost *
+                        (left_area * num_left + right_area * num_right) / node_area;
+                if (num_left == 0 || num_right == 0) {
+                    cost *= kEmptyBonus;
+                }
+
+                if (cost < *best_cost) {
+                    *best_cost = cost;
+                    *best_axis = axis;
+                    *best_split = split;
+                }
+            };
+
+            for (size_t i = 0; i < num_items; i++) {
+                evaluate(los[i]);
+                evaluate(his[i]);
+            }
+        }
+
+        return *best_axis >= 0;
+    }
+
+    void build_r(unsigned int node_index, std::vector<KdBuildItem>&& items,
+                 const BoundingBox& node_box, unsigned int depth)
+    {
+        double leaf_cost = kIntersectionCost * items.size();
+
+        int axis;
+        double split, cost;
+        if (items.size() <= kMaxLeafSize || depth + 1 >= max_depth_ ||
+            !find_split(items, node_box, &axis, &split, &cost) || cost >= leaf_cost) {
+            make_leaf(node_index, items);
+            return;
+        }
+
+        std::vector<KdBuildItem> left_items;
+        std::vector<KdBuildItem> right_items;
+
+        for (const KdBuildItem& item : items) {
+            double lo = item.box.lo[axis];
+            double hi = item.box.hi[axis];
+
+            if (lo < split || hi <= split) {
+                left_items.push_back(item);
+            }
+            if (hi > split) {
+                right_items.push_back(item);
+            }
+        }
+
+        // The parent list is no longer needed below this node
+        std::vector<KdBuildItem>().swap(items);
+
+        BoundingBox left_box = node_box;
+        BoundingBox right_box = node_box;
+        left_box.hi[axis] = split;
+        right_box.lo[axis] = split;
+
+        unsigned int left = static_cast<unsigned int>(nodes_->size());
+        nodes_->push_back(KdNode());
+        nodes_->push_back(KdNode());
+
+        KdNode& node = (*nodes_)[node_index];
+        node.split = split;
+        node.axis = static_cast<unsigned int>(axis);
+        node.first = left;
+        node.count = 0;
+
+        build_r(left, std::move(left_items), left_box, depth + 1);
+        build_r(left + 1, std::move(right_items), right_box, depth + 1);
+    }
+
+    std::vector<KdNode>* nodes_;
+    std::vector<unsigned int>* indices_;
+    unsigned int max_depth_;
+};
+
+
+void KdTree::build(const std::vector<BoundingBox>& boxes)
+{
+    nodes_.clear();
+    indices_.clear();
+    bounds_ = BoundingBox();
+
+    if (boxes.empty()) {
+        return;
+    }
+
+    Vector3d padding{kBoundsPadding, kBoundsPadding, kBoundsPadding};
+
+    std::vector<KdBuildItem> items;
+    items.reserve(boxes.size());
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        KdBuildItem item;
+        item.box.lo = boxes[i].lo - padding;
+        item.box.hi = boxes[i].hi + padding;
+        item.index = i;
+        items.push_back(item);
+        bounds_.extend(item.box);
+    }
+
+    // Deeper trees rarely pay off, see Pharr and Humphreys
+    double depth = 8 + 1.3 * std::log2(static_cast<double>(boxes.size()));
+    unsigned int max_depth = std::min(static_cast<unsigned int>(depth), kMaxDepth);
+
+    KdTreeBuilder builder(&nodes_, &indices_, max_depth);
+    builder.build(std::move(items), bounds_);
+}
+
+
+bool KdTree::is_empty() const
+{
+    return nodes_.empty();
+}
+
+
+unsigned int KdTree::get_num_nodes() const
+{
+    return static_cast<unsigned int>(nodes_.size());
+}
+
+
+size_t KdTree::get_memory_size() const
+{
+    return nodes_.capacity() * sizeof(KdNode) +
+           indices_.capacity() * sizeof(unsigned int);
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,207 @@
+#ifndef _KDTREE_H
+#define _KDTREE_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+struct KdNode
+{
+    double split;
+    unsigned int axis;   // 3 for leaves
+    unsigned int first;  // first index for leaves, left child otherwise
+    unsigned int count;
+};
+
+
+/*
+Kd-tree built with the surface area heuristic, with a bonus for cutting
+off empty space. Primitives which straddle a split plane are listed on
+both sides, where a mailbox skips most repeated tests. Rays visit the leaves
+they pierce front to back and closest-hit queries stop at the first leaf
+which contains their hit. Queries take the same callbacks as the
+hierarchy.
+*/
+class KdTree
+{
+public:
+    KdTree() = default;
+    ~KdTree() = default;
+
+    void build(const std::vector<BoundingBox>&);
+
+    bool is_empty() const;
+    unsigned int get_num_nodes() const;
+    size_t get_memory_size() const;
+
+    // Visitor: double(unsigned int index, double max_dist)
+    template <typename F>
+    double find_closest(const Vector3d&, const Vector3d&, double, F) const;
+
+    // Visitor: bool(unsigned int index, double max_dist)
+    template <typename F>
+    bool find_any(const Vector3d&, const Vector3d&, double, F) const;
+
+private:
+    static const unsigned int kMaxDepth = 48;
+
+    // Hands the leaves along a ray to the visitor front to back, with the
+    // distance at which the ray leaves them, until the visitor returns true.
+    // Visitor: bool(unsigned int first, unsigned int count, double t_exit)
+    template <typename F>
+    void walk_leaves(const Vector3d&, const Vector3d&, double, F) const;
+
+    BoundingBox bounds_;
+    std::vector<KdNode> nodes_;
+    std::vector<unsigned int> indices_;
+};
+
+
+template <typename F>
+void KdTree::walk_leaves(const Vector3d& O,
+                         const Vector3d& D,
+                         double max_dist,
+                         F visit) const
+{
+    if (nodes_.empty()) {
+        return;
+    }
+
+    Vector3d inv_D = D.cwiseInverse();
+
+    double t_min = 0;
+    double t_max = max_dist;
+
+    for (int a = 0; a < 3; a++) {
+        double t0 = (bounds_.lo[a] - O[a]) * inv_D[a];
+        double t1 = (bounds_.hi[a] - O[a]) * inv_D[a];
+
+        // NaN (ray parallel to and touching a slab) keeps the interval
+        double t_lo = (t0 > t1) ? t1 : t0;
+        double t_hi = (t0 > t1) ? t0 : t1;
+        t_min = (t_lo > t_min) ? t_lo : t_min;
+        t_max = (t_hi < t_max) ? t_hi : t_max;
+    }
+
+    if (t_min > t_max) {
+        return;
+    }
+
+    struct StackItem
+    {
+        unsigned int node;
+        double t_min;
+        double t_max;
+    };
+
+    StackItem stack[kMaxDepth];
+    unsigned int stack_size = 0;
+
+    unsigned int index = 0;
+
+    for (;;) {
+        const KdNode* node = &nodes_[index];
+
+        while (node->axis < 3) {
+            unsigned int a = node->axis;
+            double t_split = (node->split - O[a]) * inv_D[a];
+
+            bool left_first = O[a] < node->split || (O[a] == node->split && D[a] <= 0);
+            unsigned int near = left_first ? node->first : node->first + 1;
+            unsigned int far = left_first ? node->first + 1 : node->first;
+
+            if (t_split > t_max || t_split <= 0) {
+                index = near;
+            } else if (t_split < t_min) {
+                index = far;
+            } else {
+                // Also taken for NaN, which visits both sides
+                double t_far = (t_split > t_min) ? t_split : t_min;
+                stack[stack_size++] = StackItem{far, t_far, t_max};
+                index = near;
+                if (t_split < t_max) {
+                    t_max = t_split;
+                }
+            }
+
+            node = &nodes_[index];
+        }
+
+        if (node->count && visit(node->first, node->count, t_max)) {
+            return;
+        }
+
+        if (!stack_size) {
+            return;
+        }
+
+        const StackItem& item = stack[--stack_size];
+        index = item.node;
+        t_min = item.t_min;
+        t_max = item.t_max;
+    }
+}
+
+
+template <typename F>
+double KdTree::find_closest(const Vector3d& O,
+                            const Vector3d& D,
+                            double max_dist,
+                            F visit) const
+{
+    double closest = -1;
+    Mailbox mailbox;
+
+    walk_leaves(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double t_exit) {
+            for (unsigned int i = first; i < first + count; i++) {
+                if (mailbox.check(indices_[i])) {
+                    continue;
+                }
+
+                double distance = visit(indices_[i], max_dist);
+                if (distance > 0 && distance < max_dist) {
+                    max_dist = distance;
+                    closest = distance;
+                }
+            }
+
+            // Hits beyond the leaf may still be beaten in the next leaves
+            return closest > 0 && closest <= t_exit;
+        });
+
+    return closest;
+}
+
+
+template <typename F>
+bool KdTree::find_any(const Vector3d& O,
+                      const Vector3d& D,
+                      double max_dist,
+                      F visit) const
+{
+    bool found = false;
+    Mailbox mailbox;
+
+    walk_leaves(O, D, max_dist,
+        [&](unsigned int first, unsigned int count, double) {
+            for (unsigned int i = first; i < first + count; i++) {
+                if (!mailbox.check(indices_[i]) && visit(indices_[i], max_dist)) {
+                    found = true;
+                    break;
+                }
+            }
+            return found;
+        });
+
+    return found;
+}
+
+
+} // namespace mrtp
+
+#endif // _KDTREE_H
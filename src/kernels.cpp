@@ -0,0 +1,482 @@
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#if !defined(MRTP_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "kernels.h"
+
+
+namespace mrtp {
+
+// Widening of the float tests, the double refinement makes the final call
+static const float kLaneEpsilon = 1e-4f;
+
+// Faces with a determinant below this share of twice their area are
+// rejected by the double test
+static const double kMinDeterminant = 1e-4;
+
+// Bound on the relative rounding of a few float operations, scaled by the
+// magnitude of their operands
+static const float kFloatError = 16 * std::numeric_limits<float>::epsilon();
+
+
+/*
+Lanes wraps one SIMD register of kPacketWidth floats so that the kernels
+are written once for AVX2, SSE2 and plain C++.
+*/
+#if defined(__AVX2__) && !defined(MRTP_NO_SIMD)
+
+struct Lanes
+{
+    __m256 v;
+
+    static Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    static Lanes fill(float x) { return { _mm256_set1_ps(x) }; }
+};
+
+struct LaneMask
+{
+    __m256 m;
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Lanes abs(Lanes a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline Lanes sqrt(Lanes a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+
+inline LaneMask operator<(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm256_and_ps(a.m, b.m) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm256_or_ps(a.m, b.m) }; }
+inline unsigned int to_bits(LaneMask a) { return static_cast<unsigned int>(_mm256_movemask_ps(a.m)); }
+
+#elif defined(__SSE2__) && !defined(MRTP_NO_SIMD)
+
+struct Lanes
+{
+    __m128 v;
+
+    static Lanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+    static Lanes fill(float x) { return { _mm_set1_ps(x) }; }
+};
+
+struct LaneMask
+{
+    __m128 m;
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Lanes abs(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Lanes sqrt(Lanes a) { return { _mm_sqrt_ps(a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+
+inline LaneMask operator<(Lanes a, Lanes b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm_and_ps(a.m, b.m) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm_or_ps(a.m, b.m) }; }
+inline unsigned int to_bits(LaneMask a) { return static_cast<unsigned int>(_mm_movemask_ps(a.m)); }
+
+#else
+
+struct Lanes
+{
+    float v[kPacketWidth];
+
+    static Lanes load(const float* p)
+    {
+        Lanes r;
+        for (unsigned int i = 0; i < kPacketWidth; i++) r.v[i] = p[i];
+        return r;
+    }
+
+    static Lanes fill(float x)
+    {
+        Lanes r;
+        for (unsigned int i = 0; i < kPacketWidth; i++) r.v[i] = x;
+        return r;
+    }
+};
+
+struct LaneMask
+{
+    unsigned int m;
+};
+
+#define MRTP_LANE_OP(op)                                         \
+inline Lanes operator op(Lanes a, Lanes b)                       \
+{                                                                \
+    Lanes r;                                                     \
+    for (unsigned int i = 0; i < kPacketWidth; i++) {            \
+        r.v[i] = a.v[i] op b.v[i];                               \
+    }                                                            \
+    return r;                                                    \
+}
+
+MRTP_LANE_OP(+)
+MRTP_LANE_OP(-)
+MRTP_LANE_OP(*)
+MRTP_LANE_OP(/)
+#undef MRTP_LANE_OP
+
+#define MRTP_LANE_FUNCTION(name, expr)                           \
+inline Lanes name(Lanes a, Lanes b)                              \
+{                                                                \
+    Lanes r;                                                     \
+    for (unsigned int i = 0; i < kPacketWidth; i++) {            \
+        r.v[i] = expr;                                           \
+    }                                                            \
+    return r;                                                    \
+}
+
+MRTP_LANE_FUNCTION(min, (a.v[i] < b.v[i]) ? a.v[i] : b.v[i])
+MRTP_LANE_FUNCTION(max, (a.v[i] > b.v[i]) ? a.v[i] : b.v[i])
+#undef MRTP_LANE_FUNCTION
+
+inline Lanes abs(Lanes a)
+{
+    Lanes r;
+    for (unsigned int i = 0; i < kPacketWidth; i++) r.v[i] = std::fabs(a.v[i]);
+    return r;
+}
+
+inline Lanes sqrt(Lanes a)
+{
+    Lanes r;
+    for (unsigned int i = 0; i < kPacketWidth; i++) r.v[i] = std::sqrt(a.v[i]);
+    return r;
+}
+
+inline LaneMask operator<(Lanes a, Lanes b)
+{
+    LaneMask r = { 0 };
+    for (unsigned int i = 0; i < kPacketWidth; i++) r.m |= (a.v[i] < b.v[i]) << i;
+    return r;
+}
+
+inline LaneMask operator>(Lanes a, Lanes b)
+{
+    return b < a;
+}
+
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { a.m & b.m }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { a.m | b.m }; }
+inline unsigned int to_bits(LaneMask a) { return a.m; }
+
+#endif
+
+
+PacketRay::PacketRay(const Vector3d& O, const Vector3d& D)
+{
+    for (int i = 0; i < 3; i++) {
+        o[i] = static_cast<float>(O[i]);
+        d[i] = static_cast<float>(D[i]);
+    }
+}
+
+
+// Widened bounds of the distance range
+static Lanes low_bound(float min_dist)
+{
+    return Lanes::fill(min_dist - kLaneEpsilon * (1 + std::fabs(min_dist)));
+}
+
+
+static Lanes high_bound(float max_dist)
+{
+    return Lanes::fill(max_dist + kLaneEpsilon * (1 + std::fabs(max_dist)));
+}
+
+
+void TrianglePackets::reserve(unsigned int num_triangles)
+{
+    for (std::vector<float>* a : { &ax_, &ay_, &az_, &e1x_, &e1y_, &e1z_, &e2x_, &e2y_, &e2z_,
+                                   &min_det_ }) {
+        a->reserve(num_triangles + kPacketWidth);
+    }
+}
+
+
+void TrianglePackets::add(const Eigen::Vector3f& A,
+                          const Eigen::Vector3f& B,
+                          const Eigen::Vector3f& C)
+{
+    Eigen::Vector3f E1 = B - A;
+    Eigen::Vector3f E2 = C - A;
+
+    ax_.push_back(A[0]);
+    ay_.push_back(A[1]);
+    az_.push_back(A[2]);
+    e1x_.push_back(E1[0]);
+    e1y_.push_back(E1[1]);
+    e1z_.push_back(E1[2]);
+    e2x_.push_back(E2[0]);
+    e2y_.push_back(E2[1]);
+    e2z_.push_back(E2[2]);
+
+    // As in TriangleMesh::intersect_face, from the float vertices in double
+    Vector3d N = E1.cast<double>().cross(E2.cast<double>());
+    min_det_.push_back(static_cast<float>(kMinDeterminant * N.norm()));
+}
+
+
+// Pad with degenerate triangles which never pass the determinant test
+void TrianglePackets::finish()
+{
+    for (unsigned int i = 0; i < kPacketWidth; i++) {
+        add(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero());
+    }
+}
+
+
+size_t TrianglePackets::get_memory_size() const
+{
+    return 10 * ax_.capacity() * sizeof(float);
+}
+
+
+/*
+Moller-Trumbore on kPacketWidth triangles at once. The float error of u, v
+and t grows with the distance of the ray origin from the world origin over
+the size of the face, and with grazing rays through the determinant, so
+the bounds are widened by that much on top of kLaneEpsilon.
+*/
+unsigned int TrianglePackets::find_candidates(unsigned int first,
+                                              const PacketRay& ray,
+                                              float min_dist,
+                                              float max_dist) const
+{
+    Lanes dx = Lanes::fill(ray.d[0]);
+    Lanes dy = Lanes::fill(ray.d[1]);
+    Lanes dz = Lanes::fill(ray.d[2]);
+
+    Lanes e1x = Lanes::load(&e1x_[first]);
+    Lanes e1y = Lanes::load(&e1y_[first]);
+    Lanes e1z = Lanes::load(&e1z_[first]);
+    Lanes e2x = Lanes::load(&e2x_[first]);
+    Lanes e2y = Lanes::load(&e2y_[first]);
+    Lanes e2z = Lanes::load(&e2z_[first]);
+
+    Lanes px = dy * e2z - dz * e2y;
+    Lanes py = dz * e2x - dx * e2z;
+    Lanes pz = dx * e2y - dy * e2x;
+
+    Lanes det = e1x * px + e1y * py + e1z * pz;
+    Lanes inv_det = Lanes::fill(1.0f) / det;
+
+    Lanes tx = Lanes::fill(ray.o[0]) - Lanes::load(&ax_[first]);
+    Lanes ty = Lanes::fill(ray.o[1]) - Lanes::load(&ay_[first]);
+    Lanes tz = Lanes::fill(ray.o[2]) - Lanes::load(&az_[first]);
+
+    Lanes u = (tx * px + ty * py + tz * pz) * inv_det;
+
+    Lanes qx = ty * e1z - tz * e1y;
+    Lanes qy = tz * e1x - tx * e1z;
+    Lanes qz = tx * e1y - ty * e1x;
+
+    Lanes v = (dx * qx + dy * qy + dz * qz) * inv_det;
+    Lanes t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+    Lanes e1_size = abs(e1x) + abs(e1y) + abs(e1z);
+    Lanes e2_size = abs(e2x) + abs(e2y) + abs(e2z);
+    Lanes origin_size = Lanes::fill(std::fabs(ray.o[0]) + std::fabs(ray.o[1]) + std::fabs(ray.o[2]));
+    Lanes reach = origin_size + abs(tx) + abs(ty) + abs(tz);
+
+    Lanes error = Lanes::fill(kFloatError);
+    Lanes det_error = error * e1_size * e2_size;
+    Lanes inv_abs_det = abs(inv_det);
+
+    Lanes uv_error = (error * reach * (e1_size + e2_size) + det_error) * inv_abs_det;
+    Lanes t_error = (reach + abs(t)) * det_error * inv_abs_det;
+
+    Lanes low = Lanes::fill(-kLaneEpsilon) - uv_error;
+    Lanes high = Lanes::fill(1 + kLaneEpsilon) + uv_error + uv_error;
+
+    LaneMask hits = (abs(det) + det_error > Lanes::load(&min_det_[first])) &
+                    (u > low) & (v > low) & (u + v < high) &
+                    (t + t_error > low_bound(min_dist)) & (t - t_error < high_bound(max_dist));
+
+    return to_bits(hits);
+}
+
+
+void SpherePackets::reserve(unsigned int num_spheres)
+{
+    for (std::vector<float>* a : { &cx_, &cy_, &cz_, &r_ }) {
+        a->reserve(num_spheres + kPacketWidth);
+    }
+}
+
+
+void SpherePackets::add(const Vector3d& center, double radius)
+{
+    cx_.push_back(static_cast<float>(center[0]));
+    cy_.push_back(static_cast<float>(center[1]));
+    cz_.push_back(static_cast<float>(center[2]));
+    r_.push_back(static_cast<float>(radius));
+}
+
+
+// Pad with spheres of zero radius, which are masked out
+void SpherePackets::finish()
+{
+    for (unsigned int i = 0; i < kPacketWidth; i++) {
+        add(Vector3d{0, 0, 0}, 0);
+    }
+}
+
+
+size_t SpherePackets::get_memory_size() const
+{
+    return 4 * cx_.capacity() * sizeof(float);
+}
+
+
+/*
+The smaller root of a t^2 + b t + c = 0 is bounded from below with the
+discriminant widened by its rounding error. Near-tangent rays, where
+solve_quadratic() falls back to -b / 2a, get the midpoint as the upper
+bound. A lane is a candidate when this range meets the distance range.
+*/
+unsigned int SpherePackets::find_candidates(unsigned int first,
+                                            const PacketRay& ray,
+                                            float min_dist,
+                                            float max_dist) const
+{
+    Lanes dx = Lanes::fill(ray.d[0]);
+    Lanes dy = Lanes::fill(ray.d[1]);
+    Lanes dz = Lanes::fill(ray.d[2]);
+
+    Lanes tx = Lanes::fill(ray.o[0]) - Lanes::load(&cx_[first]);
+    Lanes ty = Lanes::fill(ray.o[1]) - Lanes::load(&cy_[first]);
+    Lanes tz = Lanes::fill(ray.o[2]) - Lanes::load(&cz_[first]);
+    Lanes r = Lanes::load(&r_[first]);
+
+    Lanes a = Lanes::fill(ray.d[0] * ray.d[0] + ray.d[1] * ray.d[1] + ray.d[2] * ray.d[2]);
+    Lanes b = Lanes::fill(2.0f) * (dx * tx + dy * ty + dz * tz);
+    Lanes tt = tx * tx + ty * ty + tz * tz;
+    Lanes rr = r * r;
+    Lanes four_a = Lanes::fill(4.0f) * a;
+
+    Lanes delta = b * b - four_a * (tt - rr);
+    Lanes tolerance = Lanes::fill(kLaneEpsilon) * (b * b + four_a * (tt + rr));
+
+    Lanes inv_2a = Lanes::fill(0.5f) / a;
+    Lanes t_low = (Lanes::fill(0.0f) - b - sqrt(max(delta, Lanes::fill(0.0f)) + tolerance)) * inv_2a;
+    Lanes t_mid = (Lanes::fill(0.0f) - b) * inv_2a;
+
+    LaneMask hits = (delta + tolerance > Lanes::fill(0.0f)) &
+                    (t_low < high_bound(max_dist)) & (t_mid > low_bound(min_dist)) &
+                    (r > Lanes::fill(0.0f));
+
+    return to_bits(hits);
+}
+
+
+void CylinderPackets::reserve(unsigned int num_cylinders)
+{
+    for (std::vector<float>* a : { &ox_, &oy_, &oz_, &kx_, &ky_, &kz_, &r_, &span_ }) {
+        a->reserve(num_cylinders + kPacketWidth);
+    }
+}
+
+
+void CylinderPackets::add(const Vector3d& center, const Vector3d& axis,
+                          double radius, double span)
+{
+    ox_.push_back(static_cast<float>(center[0]));
+    oy_.push_back(static_cast<float>(center[1]));
+    oz_.push_back(static_cast<float>(center[2]));
+    kx_.push_back(static_cast<float>(axis[0]));
+    ky_.push_back(static_cast<float>(axis[1]));
+    kz_.push_back(static_cast<float>(axis[2]));
+    r_.push_back(static_cast<float>(radius));
+    span_.push_back(static_cast<float>(span));
+}
+
+
+void CylinderPackets::finish()
+{
+    for (unsigned int i = 0; i < kPacketWidth; i++) {
+        add(Vector3d{0, 0, 0}, Vector3d{0, 0, 1}, 0, 0);
+    }
+}
+
+
+size_t CylinderPackets::get_memory_size() const
+{
+    return 8 * ox_.capacity() * sizeof(float);
+}
+
+
+// Same root bounds as for spheres, plus the span test along the axis
+unsigned int CylinderPackets::find_candidates(unsigned int first,
+                                              const PacketRay& ray,
+                                              float min_dist,
+                                              float max_dist) const
+{
+    Lanes dx = Lanes::fill(ray.d[0]);
+    Lanes dy = Lanes::fill(ray.d[1]);
+    Lanes dz = Lanes::fill(ray.d[2]);
+
+    Lanes vx = Lanes::fill(ray.o[0]) - Lanes::load(&ox_[first]);
+    Lanes vy = Lanes::fill(ray.o[1]) - Lanes::load(&oy_[first]);
+    Lanes vz = Lanes::fill(ray.o[2]) - Lanes::load(&oz_[first]);
+
+    Lanes kx = Lanes::load(&kx_[first]);
+    Lanes ky = Lanes::load(&ky_[first]);
+    Lanes kz = Lanes::load(&kz_[first]);
+    Lanes r = Lanes::load(&r_[first]);
+    Lanes span = Lanes::load(&span_[first]);
+
+    Lanes a = dx * vx + dy * vy + dz * vz;
+    Lanes b = dx * kx + dy * ky + dz * kz;
+    Lanes d = vx * kx + vy * ky + vz * kz;
+    Lanes vv = vx * vx + vy * vy + vz * vz;
+    Lanes rr = r * r;
+
+    Lanes aa = Lanes::fill(1.0f) - b * b;
+    Lanes bb = Lanes::fill(2.0f) * (a - b * d);
+    Lanes cc = vv - d * d - rr;
+
+    Lanes four_aa = Lanes::fill(4.0f) * aa;
+    Lanes delta = bb * bb - four_aa * cc;
+    Lanes tolerance = Lanes::fill(kLaneEpsilon) * (bb * bb + four_aa * (vv + d * d + rr));
+
+    Lanes inv_2aa = Lanes::fill(0.5f) / aa;
+    Lanes t_low = (Lanes::fill(0.0f) - bb - sqrt(max(delta, Lanes::fill(0.0f)) + tolerance)) * inv_2aa;
+    Lanes t_mid = (Lanes::fill(0.0f) - bb) * inv_2aa;
+
+    // The hit lies between the two distances, so does its axial position
+    Lanes alpha_low = d + t_low * b;
+    Lanes alpha_mid = d + t_mid * b;
+    Lanes alpha_margin = Lanes::fill(kLaneEpsilon) *
+                         (Lanes::fill(1.0f) + abs(d) + abs(t_low) + abs(t_mid));
+    Lanes alpha_max = span + alpha_margin;
+
+    LaneMask in_span = (min(alpha_low, alpha_mid) < alpha_max) &
+                       (max(alpha_low, alpha_mid) > Lanes::fill(0.0f) - alpha_max);
+
+    LaneMask hits = (delta + tolerance > Lanes::fill(0.0f)) &
+                    (t_low < high_bound(max_dist)) & (t_mid > low_bound(min_dist)) &
+                    in_span;
+
+    // Rays almost parallel to the axis are left to the exact test
+    LaneMask parallel = aa < Lanes::fill(kLaneEpsilon);
+
+    return to_bits(hits | parallel) & to_bits(r > Lanes::fill(0.0f));
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,177 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+#if defined(__AVX2__) && !defined(MRTP_NO_SIMD)
+const unsigned int kPacketWidth = 8;
+#else
+const unsigned int kPacketWidth = 4;
+#endif
+
+
+struct PacketRay
+{
+    float o[3];
+    float d[3];
+
+    PacketRay() = default;
+    PacketRay(const Vector3d&, const Vector3d&);
+};
+
+
+/*
+Triangles in structure-of-arrays layout for the wide kernels, stored as
+the first vertex, two edges and the cutoff of the determinant. The arrays
+carry kPacketWidth spare entries so a packet may start at any triangle.
+*/
+class TrianglePackets
+{
+public:
+    TrianglePackets() = default;
+    ~TrianglePackets() = default;
+
+    void reserve(unsigned int);
+    void add(const Eigen::Vector3f&, const Eigen::Vector3f&, const Eigen::Vector3f&);
+    void finish();
+
+    // Bit i is set when triangle first + i may be hit inside the range.
+    // The mask is conservative, candidates must be confirmed in double.
+    unsigned int find_candidates(unsigned int, const PacketRay&, float, float) const;
+
+    size_t get_memory_size() const;
+
+private:
+    std::vector<float> ax_, ay_, az_;
+    std::vector<float> e1x_, e1y_, e1z_;
+    std::vector<float> e2x_, e2y_, e2z_;
+
+    // Determinant below which the double test rejects the face
+    std::vector<float> min_det_;
+};
+
+
+// Spheres as centers and radii
+class SpherePackets
+{
+public:
+    SpherePackets() = default;
+    ~SpherePackets() = default;
+
+    void reserve(unsigned int);
+    void add(const Vector3d&, double);
+    void finish();
+
+    // Conservative mask, as for triangles
+    unsigned int find_candidates(unsigned int, const PacketRay&, float, float) const;
+
+    size_t get_memory_size() const;
+
+private:
+    std::vector<float> cx_, cy_, cz_;
+    std::vector<float> r_;
+};
+
+
+// Finite cylinders as centers, unit axes, radii and half lengths
+class CylinderPackets
+{
+public:
+    CylinderPackets() = default;
+    ~CylinderPackets() = default;
+
+    void reserve(unsigned int);
+    void add(const Vector3d&, const Vector3d&, double, double);
+    void finish();
+
+    // Conservative mask, as for triangles
+    unsigned int find_candidates(unsigned int, const PacketRay&, float, float) const;
+
+    size_t get_memory_size() const;
+
+private:
+    std::vector<float> ox_, oy_, oz_;
+    std::vector<float> kx_, ky_, kz_;
+    std::vector<float> r_;
+    std::vector<float> span_;
+};
+
+
+// Mask of the first count lanes of a packet
+inline unsigned int lane_mask(unsigned int count)
+{
+    return (count >= kPacketWidth) ? (1u << kPacketWidth) - 1 : (1u << count) - 1;
+}
+
+
+// Index of the lowest set bit, the mask must not be zero
+inline unsigned int count_trailing_zeros(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#else
+    unsigned int n = 0;
+    for (; !(mask & 1); mask >>= 1) {
+        n++;
+    }
+    return n;
+#endif
+}
+
+
+// Closest candidate of the packets [first, first + count) confirmed by
+// the visitor: double(unsigned int index, double max_dist)
+template <typename P, typename F>
+double find_closest_candidate(const P& packets, unsigned int first, unsigned int count,
+                              const PacketRay& ray, double min_dist, double max_dist,
+                              F confirm)
+{
+    double closest = -1;
+
+    for (unsigned int p = first; p < first + count; p += kPacketWidth) {
+        unsigned int candidates = lane_mask(first + count - p) &
+            packets.find_candidates(p, ray, static_cast<float>(min_dist),
+                                    static_cast<float>(max_dist));
+
+        for (; candidates; candidates &= candidates - 1) {
+            double distance = confirm(p + count_trailing_zeros(candidates), max_dist);
+            if (distance > 0 && distance < max_dist) {
+                max_dist = distance;
+                closest = distance;
+            }
+        }
+    }
+
+    return closest;
+}
+
+
+// Visitor: bool(unsigned int index, double max_dist)
+template <typename P, typename F>
+bool find_any_candidate(const P& packets, unsigned int first, unsigned int count,
+                        const PacketRay& ray, double max_dist, F confirm)
+{
+    for (unsigned int p = first; p < first + count; p += kPacketWidth) {
+        unsigned int candidates = lane_mask(first + count - p) &
+            packets.find_candidates(p, ray, 0, static_cast<float>(max_dist));
+
+        for (; candidates; candidates &= candidates - 1) {
+            if (confirm(p + count_trailing_zeros(candidates), max_dist)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+} // namespace mrtp
+
+#endif // _KERNELS_H
@@ -12,4 +12,9 @@ Eigen::Vector3d Light::calculate_ray(const Eigen::Vector3d& hit) const
     return (center_ - hit);
 }
 
+const Eigen::Vector3d& Light::get_center() const
+{
+    return center_;
+}
+
 } // namespace mrtp
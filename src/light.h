@@ -12,6 +12,7 @@ public:
     ~Light() = default;
 
     Eigen::Vector3d calculate_ray(const Eigen::Vector3d& hit) const;
+    const Eigen::Vector3d& get_center() const;
 
 private:
     Eigen::Vector3d center_;
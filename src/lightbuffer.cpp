@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "lightbuffer.h"
+
+
+namespace mrtp {
+
+// Padding of projected ranges against rounding at cell borders
+static const double kCellPadding = 1e-9;
+
+static const unsigned int kNumFaces = 6;
+
+
+struct LightBufferItem
+{
+    Vector3d lo;  // relative to the light
+    Vector3d hi;
+    float near_dist;
+};
+
+
+// Cells of a face cover [-1, 1] in both directions
+static unsigned int to_cell_index(double r, unsigned int resolution)
+{
+    double x = std::floor((r + 1) * 0.5 * resolution);
+    return static_cast<unsigned int>(std::min(std::max(x, 0.0), resolution - 1.0));
+}
+
+
+// Range of u / w over u in [u_lo, u_hi] and w in [w_lo, w_hi] with
+// 0 <= w_lo < w_hi, unbounded when the range reaches w = 0
+static void project_range(double u_lo, double u_hi, double w_lo, double w_hi,
+                          double* r_lo, double* r_hi)
+{
+    *r_lo = u_lo / ((u_lo < 0) ? w_lo : w_hi) - kCellPadding;
+    *r_hi = u_hi / ((u_hi > 0) ? w_lo : w_hi) + kCellPadding;
+}
+
+
+/*
+Face 2 * axis + side looks along the axis, towards negative values for
+side 1. Directions on a face are the other two components divided by the
+one along the axis, as in LightBuffer::find_cell().
+Visitor: void(unsigned int cell)
+*/
+template <typename F>
+static void visit_box_cells(const LightBufferItem& item, unsigned int resolution, F visit)
+{
+    const Vector3d& lo = item.lo;
+    const Vector3d& hi = item.hi;
+
+    // Boxes around the light are seen in every direction
+    if (item.near_dist == 0) {
+        for (unsigned int cell = 0; cell < kNumFaces * resolution * resolution; cell++) {
+            visit(cell);
+        }
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        int b = (axis + 1) % 3;
+        int c = (axis + 2) % 3;
+
+        for (int side = 0; side < 2; side++) {
+            double w_lo = (side == 0) ? lo[axis] : -hi[axis];
+            double w_hi = (side == 0) ? hi[axis] : -lo[axis];
+            if (w_hi <= 0) {
+                continue;
+            }
+            w_lo = std::max(w_lo, 0.0);
+
+            double u_lo, u_hi, v_lo, v_hi;
+            project_range(lo[b], hi[b], w_lo, w_hi, &u_lo, &u_hi);
+            project_range(lo[c], hi[c], w_lo, w_hi, &v_lo, &v_hi);
+
+            if (u_lo > 1 || u_hi < -1 || v_lo > 1 || v_hi < -1) {
+                continue;
+            }
+
+            unsigned int i0 = to_cell_index(u_lo, resolution);
+            unsigned int i1 = to_cell_index(u_hi, resolution);
+            unsigned int j0 = to_cell_index(v_lo, resolution);
+            unsigned int j1 = to_cell_index(v_hi, resolution);
+
+            unsigned int face = 2 * axis + side;
+            for (unsigned int j = j0; j <= j1; j++) {
+                for (unsigned int i = i0; i <= i1; i++) {
+                    visit((face * resolution + j) * resolution + i);
+                }
+            }
+        }
+    }
+}
+
+
+void LightBuffer::build(const Vector3d& center,
+                        const std::vector<BoundingBox>& boxes,
+                        double margin)
+{
+    center_ = center;
+    margin_ = margin;
+    resolution_ = 0;
+
+    cell_starts_.clear();
+    indices_.clear();
+    near_dists_.clear();
+
+    if (boxes.empty()) {
+        return;
+    }
+
+    Vector3d grow{margin, margin, margin};
+
+    std::vector<LightBufferItem> items(boxes.size());
+    std::vector<std::pair<float, unsigned int>> order(boxes.size());
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        LightBufferItem& item = items[i];
+        item.lo = boxes[i].lo - grow - center;
+        item.hi = boxes[i].hi + grow - center;
+
+        // Rounded down, so that no box is skipped too early
+        double near_dist = Vector3d::Zero().cwiseMax(item.lo).cwiseMin(item.hi).norm();
+        item.near_dist = static_cast<float>(near_dist);
+        if (item.near_dist > near_dist) {
+            item.near_dist = std::nextafter(item.near_dist, 0.0f);
+        }
+
+        order[i] = std::make_pair(item.near_dist, i);
+    }
+
+    // Filling the cells in this order sorts every list
+    std::sort(order.begin(), order.end());
+
+    // Start from a few cells per box and coarsen while the lists get too long
+    unsigned int resolution = static_cast<unsigned int>(
+            std::ceil(2 * std::sqrt(static_cast<double>(boxes.size()))));
+    resolution = std::min(std::max(resolution, kMinResolution), kMaxResolution);
+
+    std::vector<unsigned int> counts;
+    size_t num_entries = 0;
+
+    for (;;) {
+        counts.assign(kNumFaces * resolution * resolution, 0);
+        num_entries = 0;
+
+        for (const LightBufferItem& item : items) {
+            visit_box_cells(item, resolution, [&](unsigned int cell) {
+                counts[cell]++;
+            });
+        }
+        for (unsigned int count : counts) {
+            num_entries += count;
+        }
+
+        if (num_entries <= kMaxEntries || resolution == 1) {
+            break;
+        }
+        resolution /= 2;
+    }
+
+    resolution_ = resolution;
+
+    cell_starts_.resize(counts.size() + 1);
+    cell_starts_[0] = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        cell_starts_[i + 1] = cell_starts_[i] + counts[i];
+    }
+
+    indices_.resize(num_entries);
+    near_dists_.resize(num_entries);
+
+    // Counts become the next free slot of each cell
+    std::copy(cell_starts_.begin(), cell_starts_.end() - 1, counts.begin());
+
+    for (const auto& entry : order) {
+        const LightBufferItem& item = items[entry.second];
+        visit_box_cells(item, resolution, [&](unsigned int cell) {
+            unsigned int slot = counts[cell]++;
+            indices_[slot] = entry.second;
+            near_dists_[slot] = item.near_dist;
+        });
+    }
+}
+
+
+bool LightBuffer::is_empty() const
+{
+    return resolution_ == 0;
+}
+
+
+unsigned int LightBuffer::get_resolution() const
+{
+    return resolution_;
+}
+
+
+size_t LightBuffer::get_num_entries() const
+{
+    return indices_.size();
+}
+
+
+size_t LightBuffer::get_memory_size() const
+{
+    return cell_starts_.capacity() * sizeof(unsigned int) +
+           indices_.capacity() * sizeof(unsigned int) +
+           near_dists_.capacity() * sizeof(float);
+}
+
+
+unsigned int LightBuffer::find_cell(const Vector3d& v) const
+{
+    Vector3d a = v.cwiseAbs();
+    int axis = (a[0] >= a[1]) ? ((a[0] >= a[2]) ? 0 : 2) : ((a[1] >= a[2]) ? 1 : 2);
+
+    // Only boxes around the light are that close, and they are in every cell
+    double w = a[axis];
+    if (w == 0) {
+        return 0;
+    }
+
+    unsigned int side = (v[axis] < 0) ? 1 : 0;
+    unsigned int i = to_cell_index(v[(axis + 1) % 3] / w, resolution_);
+    unsigned int j = to_cell_index(v[(axis + 2) % 3] / w, resolution_);
+
+    unsigned int face = 2 * axis + side;
+    return (face * resolution_ + j) * resolution_ + i;
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,86 @@
+#ifndef _LIGHTBUFFER_H
+#define _LIGHTBUFFER_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+/*
+Cube of directions around a point light. Each cell of its six faces lists
+the boxes seen from the light through that cell, nearest first. A segment
+from a point to the light only meets boxes listed in the cell of the point.
+Boxes are grown by the margin, so segments may end up to the margin away
+from the light. Like the hierarchy, the buffer only knows the boxes of its
+primitives.
+*/
+class LightBuffer
+{
+public:
+    LightBuffer() = default;
+    ~LightBuffer() = default;
+
+    void build(const Vector3d&, const std::vector<BoundingBox>&, double);
+
+    bool is_empty() const;
+    unsigned int get_resolution() const;
+    size_t get_num_entries() const;
+    size_t get_memory_size() const;
+
+    // True when the segment ends close enough to the light for a lookup
+    bool covers(const Vector3d& O, const Vector3d& D, double max_dist) const
+    {
+        return !is_empty() &&
+               (O + D * max_dist - center_).squaredNorm() <= margin_ * margin_;
+    }
+
+    // Visits the candidates of a covered segment, stops at the first true
+    // Visitor: bool(unsigned int index)
+    template <typename F>
+    bool find_any(const Vector3d&, F) const;
+
+private:
+    static const unsigned int kMinResolution = 32;
+    static const unsigned int kMaxResolution = 256;
+    static const size_t kMaxEntries = 1 << 23;
+
+    unsigned int find_cell(const Vector3d&) const;
+
+    Vector3d center_{0, 0, 0};
+    double margin_ = 0;
+    unsigned int resolution_ = 0;
+
+    // Candidates of cell i are [cell_starts_[i], cell_starts_[i + 1])
+    std::vector<unsigned int> cell_starts_;
+    std::vector<unsigned int> indices_;
+    std::vector<float> near_dists_;
+};
+
+
+template <typename F>
+bool LightBuffer::find_any(const Vector3d& O, F visit) const
+{
+    Vector3d v = O - center_;
+    double distance = v.norm();
+    unsigned int cell = find_cell(v);
+
+    // Boxes further from the light than the point cannot be in the way
+    for (unsigned int i = cell_starts_[cell]; i < cell_starts_[cell + 1]; i++) {
+        if (near_dists_[i] > distance) {
+            break;
+        }
+        if (visit(indices_[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+} // namespace mrtp
+
+#endif // _LIGHTBUFFER_H
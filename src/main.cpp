@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdlib>
 #include <list>
 #include <vector>
 #include <string>
@@ -9,18 +11,72 @@
 #include "texture.h"
 #include "writer.h"
 #include "logger.h"
+#include "stats.h"
 
 #include "CLI/App.hpp"
 #include "CLI/Formatter.hpp"
 #include "CLI/Config.hpp"
 
 
+// Differences of two images of the same size, channel by channel
+static mrtp::ShadowComparison compare_images(const std::vector<mrtp::TexturePixel>& a,
+                                             const std::vector<mrtp::TexturePixel>& b)
+{
+    mrtp::ShadowComparison comparison;
+    unsigned long long total_error = 0;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        unsigned int errors[3] = {
+            static_cast<unsigned int>(std::abs(a[i].red - b[i].red)),
+            static_cast<unsigned int>(std::abs(a[i].green - b[i].green)),
+            static_cast<unsigned int>(std::abs(a[i].blue - b[i].blue))
+        };
+
+        if (errors[0] || errors[1] || errors[2]) {
+            comparison.num_diff_pixels++;
+        }
+        for (unsigned int error : errors) {
+            total_error += error;
+            comparison.max_error = std::max(comparison.max_error, error);
+        }
+    }
+
+    if (!a.empty()) {
+        comparison.mean_error = static_cast<double>(total_error) / (3.0 * a.size());
+    }
+    return comparison;
+}
+
+
+// name.png becomes name_0012.png for frame 12 of an animated scene
+static std::string number_output_file(const std::string& output_file, unsigned int frame)
+{
+    std::stringstream number;
+    number << "_" << std::setw(4) << std::setfill('0') << frame;
+
+    size_t pos = output_file.rfind(".");
+    if (pos == std::string::npos) {
+        return output_file + number.str();
+    }
+    return output_file.substr(0, pos) + number.str() + output_file.substr(pos);
+}
+
+
 int main(int argc, char* argv[])
 {
     std::vector<std::string> input_files;
 
     std::string output_file;
     std::string output_format = "png";
+    std::vector<std::string> accel_names{"bvh"};
+    std::string backend_name = "native";
+    std::string mode_name = "recursive";
+    std::string stats_file;
+    bool no_mirror_packets = false;
+    bool light_buffer = false;
+    std::string shadow_mode_name = "rays";
+    bool compare_shadows = false;
+    unsigned int max_frames = 0;
 
     mrtp::RendererConfig config;
 
@@ -39,8 +95,46 @@ int main(int argc, char* argv[])
 
     app.add_option("-t,--threads", config.num_thread, "Rendering threads (0 for auto)")->default_val(config.num_thread)->check(CLI::Range(config.num_min_thread, config.num_max_thread));
 
+    app.add_option("--backend", backend_name, "Threading backend")->default_val("native")->check(CLI::IsMember({"native", "openmp"}));
+
+    app.add_option("--mode", mode_name, "Trace pixels depth first or bounce by bounce")->default_val("recursive")->check(CLI::IsMember({"recursive", "wavefront"}));
+
+    app.add_option("--max-recurse", config.max_recurse, "Most reflections of one ray")->default_val(config.max_recurse)->check(CLI::Range(config.max_recurse_min, config.max_recurse_max));
+
+    app.add_option("--min-path-weight", config.min_path_weight, "Stop reflecting once a ray adds less than this to its pixel")->default_val(config.min_path_weight)->check(CLI::Range(config.path_weight_min, config.path_weight_max));
+
+    app.add_option("--roulette-weight", config.roulette_weight, "Continue lighter rays by chance (0 for no roulette)")->default_val(config.roulette_weight)->check(CLI::Range(config.path_weight_min, config.path_weight_max));
+
+    app.add_option("--tile-size", config.tile_size, "Tile size in pixels")->default_val(config.tile_size)->check(CLI::Range(config.tile_size_min, config.tile_size_max));
+
+    app.add_option("--packet-size", config.packet_size, "Trace primary rays in packets of n x n (1 for single rays)")->default_val(config.packet_size)->check(CLI::Range(config.packet_size_min, config.packet_size_max));
+
+    app.add_flag("--no-mirror-packets", no_mirror_packets, "Trace reflections off flat mirrors one ray at a time");
+
+    app.add_flag("--screen-bins", config.screen_bins, "Find primary hits among the actors binned by screen tile");
+    app.add_flag("--raster-primary", config.raster_primary, "Bound primary rays by a rasterized visibility prepass");
+
+    app.add_option("--aa-max-samples", config.aa_max_samples, "Samples for pixels on edges (1 for no anti-aliasing)")->default_val(config.aa_max_samples)->check(CLI::Range(config.aa_max_samples_min, config.aa_max_samples_max));
+
+    app.add_option("--stats-json", stats_file, "Write timings and ray counts to a JSON file");
+
+    app.add_option("--accel", accel_names, "Acceleration structure, several are rendered in turn and compared (default bvh)")->delimiter(',')->check(CLI::IsMember({"none", "bvh", "grid", "kdtree"}));
+
+    app.add_flag("--light-buffer", light_buffer, "Find shadow casters through a direction cube around the light");
+
+    app.add_option("--shadows", shadow_mode_name, "Exact shadow rays or an approximate shadow map")->default_val("rays")->check(CLI::IsMember({"rays", "shadowmap"}));
+    app.add_option("--shadow-map-size", config.shadow_map_size, "Shadow map texels along each edge of a cube face")->default_val(config.shadow_map_size)->check(CLI::Range(config.shadow_map_size_min, config.shadow_map_size_max));
+    app.add_flag("--compare-shadows", compare_shadows, "Render again with shadow rays and report how the shadow map image differs");
+
+    app.add_option("--max-frames", max_frames, "Most frames rendered of a molecule trajectory (0 for all)")->default_val(max_frames);
+
     CLI11_PARSE(app, argc, argv);
 
+    config.backend = (backend_name == "openmp") ? mrtp::RendererBackend::OpenMP : mrtp::RendererBackend::Native;
+    config.mode = (mode_name == "wavefront") ? mrtp::RendererMode::Wavefront : mrtp::RendererMode::Recursive;
+    config.mirror_packets = !no_mirror_packets;
+    config.shadows = (shadow_mode_name == "shadowmap") ? mrtp::ShadowMode::ShadowMap : mrtp::ShadowMode::Rays;
+
 
     bool auto_name = input_files.size() > 1 || output_file.empty();
     if (auto_name && !output_file.empty()) {
@@ -64,16 +158,36 @@ int main(int argc, char* argv[])
 
     mrtp::WriterType writer_type = (output_format == "png") ? mrtp::WriterType::PNG : mrtp::WriterType::JPEG;
 
+    std::vector<mrtp::AccelType> accel_types;
+    for (const std::string& accel_name : accel_names) {
+        mrtp::AccelType accel_type;
+        if (mrtp::parse_accel_type(accel_name, &accel_type)) {
+            accel_types.push_back(accel_type);
+        }
+    }
+
+    // Comparisons time the any-hit queries of each structure too, which
+    // the light buffer would answer for most shadow rays
+    if (light_buffer && accel_types.size() > 1) {
+        LOG_WARNING("Light buffer off while comparing acceleration structures");
+        light_buffer = false;
+    }
+
     auto scene_renderer = mrtp::create_renderer(config);
     //FIXME pointer to renderer
     auto scene_writer = mrtp::create_writer(scene_renderer.get(), writer_type);
 
+    std::vector<mrtp::SceneReport> reports;
+
     // Iterate over all input files
     for (std::string& input_file : input_files) {
         LOG_INFO(std::string("Processing " + input_file + " ..."));
 
+        mrtp::SceneTimings world_timings;
+
         mrtp::TextureFactory texture_factory(&texture_cache);
-        auto world_ptr = mrtp::build_world(input_file, &texture_factory);
+        auto world_ptr = mrtp::build_world(input_file, &texture_factory, accel_types[0],
+                                            light_buffer, &world_timings);
         if (!world_ptr) {
             return EXIT_FAILURE;
         }
@@ -87,13 +201,238 @@ int main(int argc, char* argv[])
             output_file = foo + "." + output_format;
         }
 
-        float render_t = scene_renderer->do_render(world_ptr.get());
+        // Frames of animated scenes are numbered from the first one
+        bool is_animated = world_ptr->is_animated();
+        std::string frame_file = is_animated ? number_output_file(output_file, 0) : output_file;
+
+        size_t first_report = reports.size();
+
+        // The world is parsed once, later structures only compile it again
+        for (size_t a = 0; a < accel_types.size(); a++) {
+            mrtp::SceneReport report;
+            report.input_file = input_file;
+            report.num_threads = scene_renderer->config_.num_thread;
+
+            if (a == 0) {
+                report.timings = world_timings;
+            } else {
+                mrtp::StopWatch compile_watch;
+                world_ptr->compile(accel_types[a], light_buffer);
+                report.timings.build = compile_watch.elapsed();
+            }
+
+            const mrtp::SceneSnapshot* snapshot = world_ptr->get_snapshot();
+            report.accel_name = snapshot->get_accelerator().get_name();
+            report.accel_build_time = snapshot->get_accel_build_time();
+            report.accel_memory = snapshot->get_accelerator().get_memory_size();
+            report.light_buffer = light_buffer;
 
-        std::stringstream render_time;
-        render_time << "Done in " << std::setprecision(2) << render_t << "s";
-        LOG_INFO(render_time.str());
+            float render_t = scene_renderer->do_render(world_ptr.get());
+            report.timings.render = render_t;
 
-        scene_writer->write_to_file(output_file);
+            std::stringstream render_time;
+            render_time << "Done in " << std::setprecision(2) << render_t << "s";
+            LOG_INFO(render_time.str());
+
+            const mrtp::RenderStats& render_stats = scene_renderer->get_stats();
+            if (render_stats.num_pixels) {
+                double num_pixels = static_cast<double>(render_stats.num_pixels);
+
+                std::stringstream shadow_stats;
+                shadow_stats << "Shadow rays per pixel " << std::setprecision(3)
+                             << render_stats.num_shadow_rays / num_pixels
+                             << ", tests per pixel "
+                             << render_stats.num_shadow_tests / num_pixels
+                             << ", cached occluder hits " << render_stats.num_occluder_hits;
+                LOG_DEBUG(shadow_stats.str());
+
+                std::stringstream tile_stats;
+                tile_stats << "Rendered " << render_stats.num_tiles << " tiles, "
+                           << render_stats.num_steals << " stolen runs";
+                LOG_DEBUG(tile_stats.str());
+
+                std::stringstream primary_stats;
+                primary_stats << "Primary rays per thread second " << std::setprecision(3)
+                              << render_stats.get_primary_rays_per_second()
+                              << ", " << render_stats.num_packets << " packets, "
+                              << render_stats.num_frustum_culls << " frustum culls";
+                LOG_DEBUG(primary_stats.str());
+
+                unsigned long long num_bin_actors = render_stats.num_bin_tests + render_stats.num_bin_skips;
+                if (num_bin_actors) {
+                    std::stringstream bin_stats;
+                    bin_stats << "Binned actors in " << std::setprecision(3)
+                              << render_stats.bin_time * 1000 << "ms, "
+                              << render_stats.num_bin_entries << " entries, primary rays skipped "
+                              << 100.0 * render_stats.num_bin_skips / num_bin_actors
+                              << "% of bounded actors";
+                    LOG_DEBUG(bin_stats.str());
+                }
+
+                if (render_stats.num_raster_pixels) {
+                    std::stringstream raster_stats;
+                    raster_stats << "Rasterized " << render_stats.num_raster_pixels
+                                 << " pixels in " << std::setprecision(3)
+                                 << render_stats.raster_time * 1000 << "ms, "
+                                 << render_stats.num_raster_misses << " primary rays traced again";
+                    LOG_DEBUG(raster_stats.str());
+                }
+
+                if (render_stats.num_mirror_packets) {
+                    std::stringstream mirror_stats;
+                    mirror_stats << "Traced " << render_stats.num_mirror_rays
+                                 << " mirror reflections in " << render_stats.num_mirror_packets
+                                 << " packets";
+                    LOG_DEBUG(mirror_stats.str());
+                }
+
+                std::stringstream path_stats;
+                path_stats << "Paths by reflections";
+                for (size_t i = 0; i < render_stats.num_paths_by_bounces.size(); i++) {
+                    path_stats << ((i > 0) ? ", " : " ") << i << ": "
+                               << render_stats.num_paths_by_bounces[i];
+                }
+                path_stats << ", cut by weight " << render_stats.num_weight_cuts
+                           << ", by roulette " << render_stats.num_roulette_cuts;
+                LOG_DEBUG(path_stats.str());
+
+                if (render_stats.num_aa_uniform_rays) {
+                    std::stringstream aa_stats;
+                    aa_stats << "Anti-aliased " << render_stats.num_aa_pixels << " pixels with "
+                             << render_stats.num_aa_rays << " extra rays, "
+                             << std::setprecision(3)
+                             << 100.0 * render_stats.num_aa_rays / render_stats.num_aa_uniform_rays
+                             << "% of uniform supersampling";
+                    LOG_DEBUG(aa_stats.str());
+                }
+            }
+
+            report.stats = render_stats;
+
+            if (config.shadows == mrtp::ShadowMode::ShadowMap) {
+                report.shadow_mode = shadow_mode_name;
+                report.shadow_map_size = config.shadow_map_size;
+
+                std::stringstream map_stats;
+                map_stats << "Shadow map rendered in " << std::setprecision(3)
+                          << render_stats.shadow_map_time * 1000 << "ms, "
+                          << render_stats.num_shadow_lookups << " lookups";
+                LOG_DEBUG(map_stats.str());
+            }
+
+            // The shadow map image is kept for writing
+            if (config.shadows == mrtp::ShadowMode::ShadowMap && compare_shadows) {
+                std::vector<mrtp::TexturePixel> image = scene_renderer->framebuffer_;
+
+                scene_renderer->config_.shadows = mrtp::ShadowMode::Rays;
+                float reference_t = scene_renderer->do_render(world_ptr.get());
+                scene_renderer->config_.shadows = mrtp::ShadowMode::ShadowMap;
+
+                report.has_shadow_comparison = true;
+                report.shadow_comparison = compare_images(image, scene_renderer->framebuffer_);
+                report.shadow_comparison.reference_render = reference_t;
+                scene_renderer->framebuffer_ = image;
+
+                const mrtp::ShadowComparison& c = report.shadow_comparison;
+                std::stringstream comparison;
+                comparison << "Shadow map render " << std::setprecision(3) << render_t
+                           << "s, shadow rays " << reference_t << "s, "
+                           << c.num_diff_pixels << " pixels differ, mean error "
+                           << c.mean_error << ", max error " << c.max_error;
+                LOG_INFO(comparison.str());
+            }
+
+            mrtp::StopWatch write_watch;
+            scene_writer->write_to_file(frame_file);
+            report.timings.write = write_watch.elapsed();
+
+            std::stringstream phase_times;
+            phase_times << std::setprecision(3)
+                        << "Parse " << report.timings.parse
+                        << "s, assets " << report.timings.assets
+                        << "s, build " << report.timings.build
+                        << "s, render " << report.timings.render
+                        << "s, write " << report.timings.write << "s";
+            LOG_DEBUG(phase_times.str());
+
+            report.output_file = frame_file;
+            reports.push_back(report);
+        }
+
+        if (accel_types.size() > 1) {
+            LOG_INFO(std::string("Acceleration structures for " + input_file +
+                                 (light_buffer ? " with" : " without") + " light buffer:"));
+
+            for (size_t i = first_report; i < reports.size(); i++) {
+                const mrtp::SceneReport& r = reports[i];
+                double rays_per_second = (r.timings.render > 0) ?
+                            r.stats.get_num_rays() / r.timings.render : 0;
+
+                std::stringstream comparison;
+                comparison << std::left << std::setw(8) << r.accel_name << std::right
+                           << std::setprecision(3)
+                           << " build " << r.accel_build_time * 1000 << "ms"
+                           << ", memory " << r.accel_memory / 1024 << "KiB"
+                           << ", render " << r.timings.render << "s"
+                           << ", rays/s " << rays_per_second;
+                LOG_INFO(comparison.str());
+            }
+        }
+
+        // The next frames stream through the last structure, each one
+        // moves the actors in place and compiles the snapshot again. They
+        // share one report of running totals, so that memory does not
+        // grow with the length of the animation.
+        mrtp::SceneReport frames_report;
+        frames_report.input_file = input_file;
+        frames_report.frame = 1;
+        frames_report.num_frames = 0;
+        frames_report.num_threads = scene_renderer->config_.num_thread;
+        frames_report.light_buffer = light_buffer;
+
+        if (config.shadows == mrtp::ShadowMode::ShadowMap) {
+            frames_report.shadow_mode = shadow_mode_name;
+            frames_report.shadow_map_size = config.shadow_map_size;
+        }
+
+        for (unsigned int frame = 1; is_animated && (max_frames == 0 || frame < max_frames); frame++) {
+            mrtp::StopWatch advance_watch;
+            if (!world_ptr->advance_frame()) {
+                break;
+            }
+            double advance_t = advance_watch.elapsed();
+
+            const mrtp::SceneSnapshot* snapshot = world_ptr->get_snapshot();
+            frames_report.accel_name = snapshot->get_accelerator().get_name();
+            frames_report.accel_build_time += snapshot->get_accel_build_time();
+            frames_report.accel_memory = std::max(frames_report.accel_memory,
+                                                  snapshot->get_accelerator().get_memory_size());
+
+            float render_t = scene_renderer->do_render(world_ptr.get());
+            frames_report.stats.add_frame(scene_renderer->get_stats());
+
+            frames_report.output_file = number_output_file(output_file, frame);
+            mrtp::StopWatch write_watch;
+            scene_writer->write_to_file(frames_report.output_file);
+
+            frames_report.timings.build += advance_t;
+            frames_report.timings.render += render_t;
+            frames_report.timings.write += write_watch.elapsed();
+            frames_report.num_frames++;
+
+            std::stringstream frame_times;
+            frame_times << "Frame " << frame << " moved in " << std::setprecision(3)
+                        << advance_t << "s, rendered in " << render_t << "s";
+            LOG_INFO(frame_times.str());
+        }
+
+        if (frames_report.num_frames) {
+            reports.push_back(frames_report);
+        }
+    }
+
+    if (!stats_file.empty() && !mrtp::write_stats_json(stats_file, reports)) {
+        return EXIT_FAILURE;
     }
     
     return EXIT_SUCCESS;  // All done
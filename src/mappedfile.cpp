@@ -0,0 +1,87 @@
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+
+namespace mrtp {
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files cannot be mapped, but are valid views of nothing
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    // Parsers read the file once from start to end
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(data);
+    size_ = size;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    released_ = 0;
+}
+
+
+void MappedFile::release(const char* until)
+{
+    if (!data_ || until <= data_) {
+        return;
+    }
+
+    // Only whole pages, the one holding the point may still be read
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t length = std::min(static_cast<size_t>(until - data_), size_) / page_size * page_size;
+    if (length <= released_) {
+        return;
+    }
+
+    madvise(const_cast<char*>(data_) + released_, length - released_, MADV_DONTNEED);
+    released_ = length;
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,42 @@
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+
+namespace mrtp {
+
+/*
+Read-only view of a whole file mapped into memory. Parsers walk the bytes
+in place, so large inputs are neither copied nor split into strings.
+*/
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const std::string&);
+    void close();
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+    // Gives back the pages before a point that streaming readers are done
+    // with. They are read again from the file if touched later.
+    void release(const char*);
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0;
+};
+
+
+} // namespace mrtp
+
+#endif // _MAPPEDFILE_H
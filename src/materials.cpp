@@ -0,0 +1,211 @@
+#include <fstream>
+#include <cmath>
+
+#include "logger.h"
+#include "materials.h"
+
+constexpr double pi() { return std::atan(1) * 4; }
+
+
+namespace mrtp {
+
+bool Material::operator==(const Material& other) const
+{
+    return type == other.type &&
+           color.red == other.color.red &&
+           color.green == other.color.green &&
+           color.blue == other.color.blue &&
+           reflection_coeff == other.reflection_coeff &&
+           texture == other.texture &&
+           scale_coeff == other.scale_coeff &&
+           radius == other.radius;
+}
+
+
+MaterialTable::MaterialTable(TextureFactory* texture_factory)
+    : texture_factory_(texture_factory)
+{
+}
+
+
+// Scenes have few distinct materials, so a linear search is enough
+MaterialId MaterialTable::add_material(const Material& material)
+{
+    for (size_t i = 0; i < materials_.size(); i++) {
+        if (materials_[i] == material) {
+            return static_cast<MaterialId>(i);
+        }
+    }
+
+    materials_.push_back(material);
+    return static_cast<MaterialId>(materials_.size() - 1);
+}
+
+
+const Material& MaterialTable::get_material(MaterialId id) const
+{
+    return materials_[id];
+}
+
+
+unsigned int MaterialTable::get_num_materials() const
+{
+    return static_cast<unsigned int>(materials_.size());
+}
+
+
+TextureFactory* MaterialTable::get_texture_factory() const
+{
+    return texture_factory_;
+}
+
+
+static MyPixel pick_plane_pixel(const Material& material,
+                                const Vector3d& hit,
+                                const StandardBasis& local_basis)
+{
+    Vector3d v = hit - local_basis.o;
+    double tx_i = v.dot(local_basis.vi);
+    double tx_j = v.dot(local_basis.vj);
+
+    return MyPixel{material.texture->pick_pixel(tx_i, tx_j, material.scale_coeff),
+                   material.reflection_coeff};
+}
+
+
+static MyPixel pick_sphere_pixel(const Material& material,
+                                 const Vector3d& normal_at_hit,
+                                 const StandardBasis& local_basis)
+{
+    // Taken from https://www.cs.unc.edu/~rademach/xroads-RT/RTarticle.html
+    double dot_vj = normal_at_hit.dot(local_basis.vj);
+    double phi = std::acos(-dot_vj);
+    double fracy = phi / pi();
+
+    double dot_vi = normal_at_hit.dot(local_basis.vi);
+    double theta = std::acos(dot_vi / std::sin(phi)) / (2 * pi());
+
+    double dot_vk = normal_at_hit.dot(local_basis.vk);
+    double fracx = (dot_vk > 0) ? theta : (1 - theta);
+
+    return MyPixel{material.texture->pick_pixel(fracx, fracy, material.scale_coeff),
+                   material.reflection_coeff};
+}
+
+
+static MyPixel pick_cylinder_pixel(const Material& material,
+                                   const Vector3d& hit,
+                                   const Vector3d& normal_at_hit,
+                                   const StandardBasis& local_basis)
+{
+    Vector3d t = hit - local_basis.o;
+
+    double alpha = t.dot(local_basis.vk);
+    double dot = normal_at_hit.dot(local_basis.vi);
+    double frac_x = acos(dot) / pi();
+    double frac_y = alpha / (2 * pi() * material.radius);
+
+    return MyPixel{material.texture->pick_pixel(frac_x, frac_y, material.scale_coeff),
+                   material.reflection_coeff};
+}
+
+
+MyPixel pick_texture_pixel(const Material& material,
+                           const Vector3d& hit,
+                           const Vector3d& normal_at_hit,
+                           const StandardBasis& local_basis)
+{
+    switch (material.type) {
+    case MaterialType::PlaneTexture:
+        return pick_plane_pixel(material, hit, local_basis);
+    case MaterialType::SphereTexture:
+        return pick_sphere_pixel(material, normal_at_hit, local_basis);
+    case MaterialType::CylinderTexture:
+        return pick_cylinder_pixel(material, hit, normal_at_hit, local_basis);
+    default:
+        return MyPixel{material.color, material.reflection_coeff};
+    }
+}
+
+
+bool create_material(MaterialTable* materials,
+                     std::shared_ptr<ConfigTable> actor_items,
+                     ActorType actor_type,
+                     MaterialId* id)
+{
+    Material material;
+    material.reflection_coeff = actor_items->get_value("reflect", 0);
+
+    std::string actor_texture = actor_items->get_text("texture");
+
+    if (!actor_texture.empty()) {
+
+        Vector3d actor_color = actor_items->get_vector("color");
+        if (!actor_color.size()) {
+            LOG_WARNING("Ignoring color and using texture file");
+        }
+
+        std::fstream check(actor_texture);
+        if (!check.good()) {
+            LOG_ERROR(std::string("Cannot open texture file " + actor_texture));
+            return false;
+        }
+
+        double default_coef = (actor_type == ActorType::Sphere) ? 1 : 0.15;
+        material.scale_coeff = actor_items->get_value("scale", default_coef);
+        material.texture = materials->get_texture_factory()->load_texture(actor_texture);
+
+        if (actor_type == ActorType::Plane) {
+            material.type = MaterialType::PlaneTexture;
+        }
+        else if (actor_type == ActorType::Sphere) {
+            material.type = MaterialType::SphereTexture;
+        }
+        else if (actor_type == ActorType::Cylinder) {
+            material.type = MaterialType::CylinderTexture;
+            material.radius = actor_items->get_value("radius", 1);
+        }
+        else {
+            // Unknown actor type
+            return false;
+        }
+
+        *id = materials->add_material(material);
+        return true;
+    }
+
+    Vector3d actor_color = actor_items->get_vector("color");
+    if (actor_color.size()) {
+        material.color = TexturePixel(actor_color);
+        *id = materials->add_material(material);
+        return true;
+    }
+
+    LOG_ERROR("Cannot parse texture file and color for material");
+    return false;
+}
+
+
+bool create_solid_material(MaterialTable* materials,
+                           std::shared_ptr<ConfigTable> items,
+                           const std::string& color_str,
+                           const std::string& reflect_str,
+                           MaterialId* id)
+{
+    Vector3d actor_color = items->get_vector(color_str);
+
+    if (actor_color.size()) {
+        Material material;
+        material.color = TexturePixel(actor_color);
+        material.reflection_coeff = items->get_value(reflect_str, 0);
+
+        *id = materials->add_material(material);
+        return true;
+    }
+
+    LOG_ERROR("Color for material not found");
+    return false;
+}
+
+
+}
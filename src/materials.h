@@ -0,0 +1,96 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+
+#include "config.h"
+#include "common.h"
+#include "texture.h"
+
+
+namespace mrtp {
+
+using Vector3d = Eigen::Vector3d;
+
+// Index into the material table of a world
+using MaterialId = unsigned int;
+
+
+enum class MaterialType
+{
+    Solid,
+    PlaneTexture,
+    SphereTexture,
+    CylinderTexture
+};
+
+
+struct Material
+{
+    MaterialType type = MaterialType::Solid;
+    TexturePixel color;
+    double reflection_coeff = 0;
+
+    // Only used by textures
+    const TextureSharedState* texture = nullptr;
+    double scale_coeff = 1;
+    double radius = 1;
+
+    bool operator==(const Material&) const;
+};
+
+
+/*
+Materials of all actors in one contiguous array. Actors keep the index of
+their material, and actors with the same color and reflection share one
+entry.
+*/
+class MaterialTable
+{
+public:
+    MaterialTable(TextureFactory*);
+    MaterialTable() = delete;
+    ~MaterialTable() = default;
+
+    MaterialId add_material(const Material&);
+    const Material& get_material(MaterialId) const;
+    unsigned int get_num_materials() const;
+
+    TextureFactory* get_texture_factory() const;
+
+private:
+    std::vector<Material> materials_;
+    TextureFactory* texture_factory_;
+};
+
+
+MyPixel pick_texture_pixel(const Material&, const Vector3d&, const Vector3d&,
+                           const StandardBasis&);
+
+
+// Solid colors are resolved here, textures need a lookup
+inline MyPixel pick_material_pixel(const Material& material,
+                                   const Vector3d& hit,
+                                   const Vector3d& normal_at_hit,
+                                   const StandardBasis& local_basis)
+{
+    if (material.type == MaterialType::Solid) {
+        return MyPixel{material.color, material.reflection_coeff};
+    }
+    return pick_texture_pixel(material, hit, normal_at_hit, local_basis);
+}
+
+
+bool create_material(MaterialTable*, std::shared_ptr<ConfigTable>, ActorType,
+                     MaterialId*);
+
+bool create_solid_material(MaterialTable*, std::shared_ptr<ConfigTable>,
+                           const std::string&, const std::string&, MaterialId*);
+
+
+}
+
+#endif // MATERIALS_H
@@ -0,0 +1,118 @@
+#include <Eigen/Geometry>
+
+#include "packet.h"
+
+
+namespace mrtp {
+
+void RayPacket::add_ray(const Vector3d& O, const Vector3d& D, double max_ray_dist)
+{
+    unsigned int i = num_rays++;
+    last_hit_ray = 0;
+
+    ox[i] = O[0];
+    oy[i] = O[1];
+    oz[i] = O[2];
+
+    dx[i] = D[0];
+    dy[i] = D[1];
+    dz[i] = D[2];
+
+    inv_dx[i] = 1 / D[0];
+    inv_dy[i] = 1 / D[1];
+    inv_dz[i] = 1 / D[2];
+
+    max_dist[i] = max_ray_dist;
+}
+
+
+/*
+Blocks of a single row or column give planes which contain all rays.
+Either orientation of such a plane is safe, boxes hit by a ray touch it.
+*/
+void RayPacket::set_frustum(const Vector3d& frustum_apex, const Vector3d corners[4],
+                            double frustum_margin)
+{
+    apex = frustum_apex;
+    margin = frustum_margin;
+
+    Vector3d center = corners[0] + corners[1] + corners[2] + corners[3];
+
+    for (int k = 0; k < 4; k++) {
+        Vector3d n = corners[k].cross(corners[(k + 1) % 4]);
+        double length = n.norm();
+
+        if (length > 0) {
+            n *= (n.dot(center) < 0) ? -1 / length : 1 / length;
+        }
+        normals[k] = n;
+    }
+}
+
+
+bool RayPacket::is_outside_frustum(const Vector3d& lo, const Vector3d& hi) const
+{
+    for (int k = 0; k < 4; k++) {
+        const Vector3d& n = normals[k];
+
+        // Corner of the box furthest along the normal
+        Vector3d p{(n[0] >= 0) ? hi[0] : lo[0],
+                   (n[1] >= 0) ? hi[1] : lo[1],
+                   (n[2] >= 0) ? hi[2] : lo[2]};
+        Vector3d v = p - apex;
+
+        // Keep boxes that only touch the plane within rounding
+        if (n.dot(v) < -margin - 1e-9 * v.cwiseAbs().sum()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Same slab test as for single rays
+double RayPacket::intersect_box(unsigned int i, const Vector3d& lo, const Vector3d& hi) const
+{
+    double t_near = 0;
+    double t_far = max_dist[i];
+
+    double o[3] = {ox[i], oy[i], oz[i]};
+    double inv_d[3] = {inv_dx[i], inv_dy[i], inv_dz[i]};
+
+    for (int k = 0; k < 3; k++) {
+        double t0 = (lo[k] - o[k]) * inv_d[k];
+        double t1 = (hi[k] - o[k]) * inv_d[k];
+
+        double t_min = (t0 > t1) ? t1 : t0;
+        double t_max = (t0 > t1) ? t0 : t1;
+
+        t_near = (t_min > t_near) ? t_min : t_near;
+        t_far = (t_max < t_far) ? t_max : t_far;
+    }
+
+    return (t_near <= t_far) ? t_near : -1;
+}
+
+
+double RayPacket::intersect_box(const Vector3d& lo, const Vector3d& hi,
+                                unsigned int rays) const
+{
+    for (unsigned int k = 0; k < num_rays; k++) {
+        unsigned int i = (last_hit_ray + k) % num_rays;
+        if (!(rays & (1u << i))) {
+            continue;
+        }
+
+        double distance = intersect_box(i, lo, hi);
+        if (distance >= 0) {
+            last_hit_ray = i;
+            return distance;
+        }
+    }
+
+    return -1;
+}
+
+
+}
@@ -0,0 +1,113 @@
+#ifndef _PACKET_H
+#define _PACKET_H
+
+#include <Eigen/Core>
+
+#include "bvh.h"
+#include "common.h"
+
+
+namespace mrtp {
+
+/*
+Bundle of up to 4x4 primary rays, stored as arrays of components.
+All rays leave the camera window away from the eye, so they lie in the
+pyramid spanned by the eye and the rays through the corners of the block.
+Nodes outside that frustum are skipped for the whole bundle.
+*/
+struct RayPacket
+{
+    static const unsigned int kMaxRays = 16;
+
+    unsigned int num_rays = 0;
+
+    double ox[kMaxRays], oy[kMaxRays], oz[kMaxRays];
+    double dx[kMaxRays], dy[kMaxRays], dz[kMaxRays];
+    double inv_dx[kMaxRays], inv_dy[kMaxRays], inv_dz[kMaxRays];
+
+    // Closest hit so far, rays do not look further
+    double max_dist[kMaxRays];
+
+    // Neighbouring boxes are usually hit by the same ray, so searches start there
+    mutable unsigned int last_hit_ray = 0;
+
+    // Side planes through the apex with normals pointing inwards. Rays may
+    // pass up to the margin away from the apex.
+    Vector3d apex;
+    Vector3d normals[4];
+    double margin = 0;
+
+    void add_ray(const Vector3d&, const Vector3d&, double);
+
+    // Bit i stands for ray i in masks of rays
+    unsigned int get_all_rays() const
+    {
+        return (1u << num_rays) - 1;
+    }
+
+    Vector3d get_origin(unsigned int i) const
+    {
+        return Vector3d{ox[i], oy[i], oz[i]};
+    }
+
+    Vector3d get_direction(unsigned int i) const
+    {
+        return Vector3d{dx[i], dy[i], dz[i]};
+    }
+
+    // Corner directions go around the block
+    void set_frustum(const Vector3d&, const Vector3d[4], double = 0);
+    bool is_outside_frustum(const Vector3d&, const Vector3d&) const;
+
+    // Entry distance of one ray into a box, or -1 when missed
+    double intersect_box(unsigned int, const Vector3d&, const Vector3d&) const;
+
+    // Entry distance of the first of the rays that hits a box, or -1
+    double intersect_box(const Vector3d&, const Vector3d&, unsigned int) const;
+};
+
+
+/*
+Walks a hierarchy once for all rays of a packet, skipping nodes outside
+the frustum or missed by every ray. Each ray which reaches a leaf box
+tests the leaf on its own. Returns the rays which found a closer hit.
+Leaf function: double(unsigned int ray, unsigned int first,
+                      unsigned int count, double max_dist, unsigned int* part)
+*/
+template <typename F>
+unsigned int solve_packet_leaves(const BoundingVolumeHierarchy& bvh,
+                                 RayPacket* packet, unsigned int rays,
+                                 unsigned int* parts, F solve_leaf)
+{
+    unsigned int hit_rays = 0;
+
+    bvh.visit_leaves(
+        [&](const BvhNode& node) {
+            if (packet->is_outside_frustum(node.lo, node.hi)) {
+                return -1.0;
+            }
+            return packet->intersect_box(node.lo, node.hi, rays);
+        },
+        [&](const BvhNode& node) {
+            for (unsigned int i = 0; i < packet->num_rays; i++) {
+                if (!(rays & (1u << i)) ||
+                    packet->intersect_box(i, node.lo, node.hi) < 0) {
+                    continue;
+                }
+
+                double distance = solve_leaf(i, node.first, node.count,
+                                             packet->max_dist[i], &parts[i]);
+                if (distance > 0 && distance < packet->max_dist[i]) {
+                    packet->max_dist[i] = distance;
+                    hit_rays |= 1u << i;
+                }
+            }
+        });
+
+    return hit_rays;
+}
+
+
+}
+
+#endif // _PACKET_H
@@ -0,0 +1,92 @@
+#include "pool.h"
+
+
+namespace mrtp {
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+    : job_(nullptr)
+    , generation_(0)
+    , num_busy_(0)
+    , stopping_(false)
+{
+    for (unsigned int i = 1; i < num_threads; i++) {
+        threads_.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_up_.notify_all();
+
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+
+void ThreadPool::run(const std::function<void(unsigned int)>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        num_busy_ = static_cast<unsigned int>(threads_.size());
+        generation_++;
+    }
+    wake_up_.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return num_busy_ == 0; });
+    job_ = nullptr;
+}
+
+
+unsigned int ThreadPool::get_num_threads() const
+{
+    return static_cast<unsigned int>(threads_.size()) + 1;
+}
+
+
+void ThreadPool::worker_loop(unsigned int worker)
+{
+    unsigned long long seen_generation = 0;
+
+    while (true) {
+        const std::function<void(unsigned int)>* job = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_up_.wait(lock, [&] {
+                return stopping_ || generation_ != seen_generation;
+            });
+
+            if (stopping_) {
+                return;
+            }
+
+            seen_generation = generation_;
+            job = job_;
+        }
+
+        (*job)(worker);
+
+        bool is_last = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_last = (--num_busy_ == 0);
+        }
+
+        if (is_last) {
+            all_done_.notify_one();
+        }
+    }
+}
+
+
+} // namespace mrtp
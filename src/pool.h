@@ -0,0 +1,50 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace mrtp {
+
+/*
+Persistent pool of render threads. The calling thread takes part in every
+job as worker 0, so a pool of N threads starts N - 1 of its own. Idle
+threads are parked on a condition variable until the next job arrives.
+*/
+class ThreadPool
+{
+public:
+    ThreadPool(unsigned int);
+    ThreadPool() = delete;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    // Runs the job once on every worker and waits for all of them
+    void run(const std::function<void(unsigned int)>&);
+
+    unsigned int get_num_threads() const;
+
+private:
+    void worker_loop(unsigned int);
+
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_up_;
+    std::condition_variable all_done_;
+
+    const std::function<void(unsigned int)>* job_;
+    unsigned long long generation_;
+    unsigned int num_busy_;
+    bool stopping_;
+};
+
+
+} // namespace mrtp
+
+#endif // _POOL_H
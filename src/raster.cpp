@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include "raster.h"
+#include "actors/sphere.h"
+
+
+namespace mrtp {
+
+void VisibilityBuffer::reset(const Camera* camera,
+                             unsigned int width,
+                             unsigned int height)
+{
+    camera_ = camera;
+    width_ = width;
+    height_ = height;
+
+    VisibilitySample empty{std::numeric_limits<float>::infinity(), 0, nullptr};
+    samples_.assign(static_cast<size_t>(width) * height, empty);
+}
+
+
+// Pixel i is centered at window coordinate i
+bool VisibilityBuffer::find_pixel_range(double x_lo, double x_hi,
+                                        double y_lo, double y_hi,
+                                        unsigned int* x0, unsigned int* x1,
+                                        unsigned int* y0, unsigned int* y1) const
+{
+    if (x_hi < 0 || y_hi < 0 || x_lo > width_ - 1.0 || y_lo > height_ - 1.0) {
+        return false;
+    }
+
+    *x0 = static_cast<unsigned int>(std::ceil(std::max(x_lo, 0.0)));
+    *y0 = static_cast<unsigned int>(std::ceil(std::max(y_lo, 0.0)));
+    *x1 = static_cast<unsigned int>(std::floor(std::min(x_hi, width_ - 1.0)));
+    *y1 = static_cast<unsigned int>(std::floor(std::min(y_hi, height_ - 1.0)));
+    return *x0 <= *x1 && *y0 <= *y1;
+}
+
+
+void VisibilityBuffer::store(unsigned int x, unsigned int y, double depth,
+                             const ActorBase* actor, unsigned int part)
+{
+    // Rounded up, so that the stored depth never cuts off its own hit
+    float rounded = static_cast<float>(depth);
+    if (rounded < depth) {
+        rounded = std::nextafter(rounded, std::numeric_limits<float>::infinity());
+    }
+
+    VisibilitySample& sample = samples_[y * width_ + x];
+    if (rounded < sample.depth) {
+        sample.depth = rounded;
+        sample.part = part;
+        sample.actor = actor;
+    }
+}
+
+
+void VisibilityBuffer::draw_triangle(const Vector3d& A, const Vector3d& B, const Vector3d& C,
+                                     const ActorBase* actor, unsigned int part)
+{
+    double ax, ay, bx, by, cx, cy;
+    if (!camera_->calculate_window_point(A, &ax, &ay) ||
+        !camera_->calculate_window_point(B, &bx, &by) ||
+        !camera_->calculate_window_point(C, &cx, &cy)) {
+        return;
+    }
+
+    // Seen edge-on
+    double area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if (area == 0) {
+        return;
+    }
+    double sign = (area > 0) ? 1 : -1;
+
+    unsigned int x0, x1, y0, y1;
+    if (!find_pixel_range(std::min({ax, bx, cx}), std::max({ax, bx, cx}),
+                          std::min({ay, by, cy}), std::max({ay, by, cy}),
+                          &x0, &x1, &y0, &y1)) {
+        return;
+    }
+
+    Vector3d normal = (B - A).cross(C - A);
+
+    for (unsigned int j = y0; j <= y1; j++) {
+        for (unsigned int i = x0; i <= x1; i++) {
+            double w_ab = sign * ((bx - ax) * (j - ay) - (by - ay) * (i - ax));
+            double w_bc = sign * ((cx - bx) * (j - by) - (cy - by) * (i - bx));
+            double w_ca = sign * ((ax - cx) * (j - cy) - (ay - cy) * (i - cx));
+            if (w_ab < 0 || w_bc < 0 || w_ca < 0) {
+                continue;
+            }
+
+            // Depth where the primary ray of the pixel meets the plane
+            Vector3d O = camera_->calculate_origin(i, j);
+            Vector3d D = camera_->calculate_direction(O);
+            double dn = D.dot(normal);
+            if (dn == 0) {
+                continue;
+            }
+
+            double t = (A - O).dot(normal) / dn;
+            if (t > 0) {
+                store(i, j, t, actor, part);
+            }
+        }
+    }
+}
+
+
+// Spheres are solved for every pixel of their projected box, which covers
+// the ellipse they project to
+void VisibilityBuffer::draw_sphere(const Vector3d& center, double radius,
+                                   const ActorBase* actor, unsigned int part)
+{
+    double x_lo = std::numeric_limits<double>::max();
+    double x_hi = std::numeric_limits<double>::lowest();
+    double y_lo = x_lo;
+    double y_hi = x_hi;
+
+    for (int corner = 0; corner < 8; corner++) {
+        Vector3d p{center[0] + ((corner & 1) ? radius : -radius),
+                   center[1] + ((corner & 2) ? radius : -radius),
+                   center[2] + ((corner & 4) ? radius : -radius)};
+
+        double x, y;
+        if (!camera_->calculate_window_point(p, &x, &y)) {
+            return;
+        }
+
+        x_lo = std::min(x_lo, x);
+        x_hi = std::max(x_hi, x);
+        y_lo = std::min(y_lo, y);
+        y_hi = std::max(y_hi, y);
+    }
+
+    unsigned int x0, x1, y0, y1;
+    if (!find_pixel_range(x_lo, x_hi, y_lo, y_hi, &x0, &x1, &y0, &y1)) {
+        return;
+    }
+
+    for (unsigned int j = y0; j <= y1; j++) {
+        for (unsigned int i = x0; i <= x1; i++) {
+            Vector3d O = camera_->calculate_origin(i, j);
+            Vector3d D = camera_->calculate_direction(O);
+
+            double t = solve_sphere_ray(center, radius, O, D, 0,
+                                        std::numeric_limits<double>::max());
+            if (t > 0) {
+                store(i, j, t, actor, part);
+            }
+        }
+    }
+}
+
+
+unsigned int VisibilityBuffer::count_covered() const
+{
+    return static_cast<unsigned int>(std::count_if(samples_.begin(), samples_.end(),
+        [](const VisibilitySample& sample) { return sample.actor != nullptr; }));
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,69 @@
+#ifndef _RASTER_H
+#define _RASTER_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "camera.h"
+#include "common.h"
+
+
+namespace mrtp {
+
+class ActorBase;
+
+
+struct VisibilitySample
+{
+    float depth;  // along the primary ray, rounded up
+    unsigned int part;
+    const ActorBase* actor;  // nullptr where nothing was drawn
+};
+
+
+/*
+Nearest actor and its distance for the primary ray of every pixel, drawn
+by the actors which can rasterize themselves. Triangles are covered with
+edge functions in window coordinates, spheres over their projected boxes.
+Depths are those of the pixel rays, so a drawn depth bounds the primary
+hit of its pixel from above unless coverage was off at an edge. Parts
+behind the eye are left out.
+*/
+class VisibilityBuffer
+{
+public:
+    VisibilityBuffer() = default;
+    ~VisibilityBuffer() = default;
+
+    // The camera window has to be calculated for the frame
+    void reset(const Camera*, unsigned int, unsigned int);
+
+    void draw_triangle(const Vector3d&, const Vector3d&, const Vector3d&,
+                       const ActorBase*, unsigned int);
+    void draw_sphere(const Vector3d&, double, const ActorBase*, unsigned int);
+
+    const VisibilitySample& get_sample(unsigned int x, unsigned int y) const
+    {
+        return samples_[y * width_ + x];
+    }
+
+    unsigned int count_covered() const;
+
+private:
+    // Frame pixels whose window coordinates lie in a box, false for none
+    bool find_pixel_range(double, double, double, double,
+                          unsigned int*, unsigned int*,
+                          unsigned int*, unsigned int*) const;
+    void store(unsigned int, unsigned int, double, const ActorBase*, unsigned int);
+
+    const Camera* camera_ = nullptr;
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+
+    std::vector<VisibilitySample> samples_;
+};
+
+
+} // namespace mrtp
+
+#endif // _RASTER_H
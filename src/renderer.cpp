@@ -1,17 +1,22 @@
 #include <Eigen/Geometry>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <ctime>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
 
 #ifdef _OPENMP
 #include <omp.h>
-#include <iostream>
 #endif
 
 #include "renderer.h"
 #include "camera.h"
 #include "light.h"
 #include "logger.h"
+#include "pool.h"
 
 constexpr double pi() { return std::atan(1) * 4; }
 
@@ -21,132 +26,847 @@ namespace mrtp {
 SceneRendererBase::SceneRendererBase(const RendererConfig& config,
                                      std::shared_ptr<ProgressSlider> slider)
     : config_(config)
+    , scene_world_(nullptr)
+    , scene_snapshot_(nullptr)
     , progress_slider_(slider)
+    , tile_scheduler_(config.width, config.height, config.tile_size)
 {
     ratio_ = static_cast<double>(config_.width) / static_cast<double>(config_.height);
     perspective_ = ratio_ / (2 * std::tan(pi() / 180 * config_.fov / 2));
 
-    framebuffer_.reserve(config_.width * config_.height);
+    framebuffer_.resize(config_.width * config_.height);
+}
+
+
+const RenderStats& SceneRendererBase::get_stats() const {
+    return stats_;
+}
+
+
+// Bins follow the camera window, so they are built again for every frame
+void SceneRendererBase::bin_actors() {
+    if (!config_.screen_bins) {
+        return;
+    }
+
+    StopWatch bin_watch;
+    screen_bins_.build(scene_world_, config_.width, config_.height, config_.tile_size);
+    double bin_time = bin_watch.elapsed();
+
+    std::stringstream convert;
+    convert << "Binned " << screen_bins_.get_num_actors() << " actors into "
+            << count_tiles(config_.width, config_.height, config_.tile_size)
+            << " tiles with " << screen_bins_.get_num_entries() << " entries in "
+            << std::setprecision(3) << bin_time * 1000 << "ms";
+    LOG_DEBUG(convert.str());
+
+    stats_.bin_time = bin_time;
+}
+
+
+// Drawn once per frame ahead of the tiles, like the bins
+void SceneRendererBase::rasterize_primary() {
+    if (!config_.raster_primary) {
+        return;
+    }
+
+    StopWatch raster_watch;
+    visibility_buffer_.reset(scene_world_->get_camera_ptr(), config_.width, config_.height);
+    for (ActorIterator it = scene_world_->get_actor_iterator(); !it.is_done(); it.next()) {
+        it.current()->get()->rasterize(&visibility_buffer_);
+    }
+    double raster_time = raster_watch.elapsed();
+
+    unsigned int num_pixels = visibility_buffer_.count_covered();
+
+    std::stringstream convert;
+    convert << "Rasterized primary visibility of " << num_pixels << " pixels in "
+            << std::setprecision(3) << raster_time * 1000 << "ms";
+    LOG_DEBUG(convert.str());
+
+    stats_.raster_time = raster_time;
+    stats_.num_raster_pixels = num_pixels;
+}
+
+
+// The map follows the light, so it is rendered again for every frame. Its
+// rows are handed out to the render threads one at a time.
+void SceneRendererBase::build_shadow_map() {
+    if (config_.shadows != ShadowMode::ShadowMap) {
+        return;
+    }
+
+    StopWatch map_watch;
+    shadow_map_.reset(scene_world_->get_light_ptr()->get_center(), config_.shadow_map_size);
+
+    std::atomic<unsigned int> next_row(0);
+    run_workers([&](unsigned int) {
+        unsigned int row;
+        while ((row = next_row.fetch_add(1, std::memory_order_relaxed)) < shadow_map_.get_num_rows()) {
+            shadow_map_.render_row(scene_snapshot_, row);
+        }
+    });
+    double map_time = map_watch.elapsed();
+
+    std::stringstream convert;
+    convert << "Rendered shadow map of " << config_.shadow_map_size << " texels per edge, "
+            << shadow_map_.get_memory_size() / 1024 << "KiB in "
+            << std::setprecision(3) << map_time * 1000 << "ms";
+    LOG_DEBUG(convert.str());
+
+    stats_.shadow_map_time = map_time;
+}
+
+
+void SceneRendererBase::collect_stats(const std::vector<TraceContext>& contexts) {
+    double bin_time = stats_.bin_time;
+    double raster_time = stats_.raster_time;
+    unsigned long long num_raster_pixels = stats_.num_raster_pixels;
+    double shadow_map_time = stats_.shadow_map_time;
+
+    stats_ = RenderStats();
+    for (const TraceContext& context : contexts) {
+        stats_.merge(context.stats);
+    }
+
+    if (config_.screen_bins) {
+        stats_.bin_time = bin_time;
+        stats_.num_bin_entries = screen_bins_.get_num_entries();
+    }
+
+    if (config_.raster_primary) {
+        stats_.raster_time = raster_time;
+        stats_.num_raster_pixels = num_raster_pixels;
+    }
+
+    if (config_.shadows == ShadowMode::ShadowMap) {
+        stats_.shadow_map_time = shadow_map_time;
+    }
 }
 
 
 bool SceneRendererBase::solve_shadows(const Vector3d& O,
                                       const Vector3d& D,
-                                      double max_dist) const {
-    ActorIterator actor_iterator = scene_world_->get_actor_iterator();
+                                      double max_dist,
+                                      unsigned int depth,
+                                      TraceContext* context) const {
+    return scene_snapshot_->solve_shadows(O, D, max_dist, depth, context);
+}
 
-    for (; !actor_iterator.is_done(); actor_iterator.next()) {
-        std::shared_ptr<ActorBase> actor = *actor_iterator.current();
-        if (actor->has_shadow()) {
-            double distance = actor->solve_light_ray(O, D, 0, max_dist);
-            if (distance > 0) {
-                return true;
-            }
-        }
+
+double SceneRendererBase::solve_occlusion(const ShadePoint& point,
+                                          unsigned int depth,
+                                          TraceContext* context) const {
+    if (config_.shadows == ShadowMode::ShadowMap) {
+        context->stats.num_shadow_lookups++;
+        return shadow_map_.calculate_occlusion(point.inter_corr, point.intensity);
     }
-    return false;
+
+    return solve_shadows(point.inter_corr, point.to_light, point.light_dist,
+                         depth, context) ? 1 : 0;
 }
 
 
 ActorBase* SceneRendererBase::solve_hits(const Vector3d& O,
                                          const Vector3d& D,
-                                         double* curr_dist) const {
-    ActorBase* hit_actor = nullptr;
+                                         double* curr_dist,
+                                         unsigned int* hit_part) const {
+    return scene_snapshot_->solve_hits(O, D, curr_dist, hit_part);
+}
 
-    ActorIterator actor_iterator = scene_world_->get_actor_iterator();
 
-    for (; !actor_iterator.is_done(); actor_iterator.next()) {
-        std::shared_ptr<ActorBase> actor = *actor_iterator.current();
-        double distance = actor->solve_light_ray(O, D, 0, config_.light_dist);
-        if (distance > 0 && distance < *curr_dist) {
-            *curr_dist = distance;
-            hit_actor = actor.get();
-        }
+ActorBase* SceneRendererBase::solve_primary_ray(unsigned int bin,
+                                                const Vector3d& O,
+                                                const Vector3d& D,
+                                                double* curr_dist,
+                                                unsigned int* hit_part,
+                                                TraceContext* context) const {
+    if (config_.screen_bins) {
+        return screen_bins_.solve_hits(bin, O, D, curr_dist, hit_part, &context->stats);
+    }
+    return solve_hits(O, D, curr_dist, hit_part);
+}
+
+
+/*
+Primary rays of pixels drawn by the prepass end just past the drawn depth,
+which prunes whatever lies behind it. They still find their own hits, so
+images stay the same. Rays which find nothing there missed the drawn actor
+at an edge and are traced again to the full distance.
+*/
+double SceneRendererBase::get_primary_dist(unsigned int x, unsigned int y) const {
+    // Drawn and traced depths of one hit differ by rounding
+    const double kDepthSlack = 1e-6;
+
+    if (!config_.raster_primary) {
+        return config_.light_dist;
     }
-    return hit_actor;
+
+    const VisibilitySample& sample = visibility_buffer_.get_sample(x, y);
+    if (!sample.actor) {
+        return config_.light_dist;
+    }
+
+    double depth = sample.depth * (1 + kDepthSlack) + kDepthSlack;
+    return std::min(depth, config_.light_dist);
 }
 
 
-Vector3d SceneRendererBase::trace_ray_r(const Vector3d& O,
-                                        const Vector3d& D,
-                                        unsigned int depth) const
+// Same number for the same path and depth on any thread
+static double random_unit(unsigned long long path_id, unsigned int depth)
+{
+    // SplitMix64 finalizer
+    unsigned long long z = path_id * 64 + depth + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+
+    return static_cast<double>(z >> 11) / 9007199254740992.0;
+}
+
+
+// Blends bounce colors back to front, as a recursive tracer would
+static Vector3d blend_path(const PathVertex* path, unsigned int path_length)
 {
     Vector3d pixel_vec{0, 0, 0};
 
-    double curr_dist = config_.light_dist;
-    ActorBase* hit_actor = solve_hits(O, D, &curr_dist);
+    for (unsigned int d = path_length; d-- > 0; ) {
+        double coeff = path[d].reflection_coeff;
+        pixel_vec = (1 - coeff) * path[d].reflection_scale * pixel_vec + coeff * path[d].color;
+    }
+
+    return pixel_vec;
+}
+
+
+unsigned long long SceneRendererBase::get_path_id(unsigned int x, unsigned int y,
+                                                  unsigned int sample) const
+{
+    return (static_cast<unsigned long long>(y) * config_.width + x) *
+            config_.aa_max_samples_max + sample;
+}
+
+
+// Hits facing away from the light stay black and end their path
+bool SceneRendererBase::prepare_shade_point(const Vector3d& O,
+                                            const Vector3d& D,
+                                            const RayHit& hit,
+                                            ShadePoint* point) const
+{
+    Light* my_light = scene_world_->get_light_ptr();
+
+    point->inter = (D * hit.distance) + O;
+    point->normal = hit.actor->calculate_part_normal(point->inter, hit.part);
+    point->to_light = my_light->calculate_ray(point->inter);
+
+    // Calculate light intensity
+    point->light_dist = point->to_light.norm();
+    point->to_light *= (1 / point->light_dist);
+
+    point->intensity = point->to_light.dot(point->normal);
+    if (point->intensity <= 0) {
+        return false;
+    }
+
+    // Prevent self-intersection
+    point->inter_corr = point->inter + config_.ray_bias * point->normal;
+    return true;
+}
+
+
+// Color of a hit once its shadow ray is known
+Vector3d SceneRendererBase::shade_point(const ShadePoint& point,
+                                        const RayHit& hit,
+                                        double* reflection_coeff) const
+{
+    // Partly blocked light is blended, fully blocked light keeps the
+    // exact coefficient of shadow rays
+    double shadow = (point.occlusion >= 1) ? config_.shadow_coeff :
+                    1 - point.occlusion * (1 - config_.shadow_coeff);
+
+    // Decrease light intensity for actors away from light
+    double ambient = 1 - std::pow(point.light_dist / config_.light_dist, 2);
+
+    // Combine pixels
+    double lambda = point.intensity * shadow * ambient;
+
+    const Material& material = scene_snapshot_->get_material(
+                hit.actor->get_part_material(hit.part));
+    MyPixel my_pick = pick_material_pixel(material, point.inter, point.normal,
+                                          hit.actor->get_local_basis());
+
+    *reflection_coeff = my_pick.reflection_coeff;
+    return lambda * my_pick.pixel.to_vec();
+}
+
+
+/*
+Decides whether a path reflects off a hit. The weight of a path is how
+much its next bounce can still change the pixel. Paths lighter than
+min_path_weight stop as if they had reached max_recurse. Paths lighter
+than roulette_weight go on by chance, and the survivors count for the
+ones that were dropped. Without a context the cuts are not counted.
+*/
+PathStep SceneRendererBase::choose_path_step(double reflection_coeff,
+                                             unsigned int depth,
+                                             unsigned long long path_id,
+                                             double* weight,
+                                             double* reflection_scale,
+                                             TraceContext* context) const
+{
+    if (depth >= config_.max_recurse || reflection_coeff <= 0) {
+        return PathStep::Stop;
+    }
+
+    double next_weight = *weight * (1 - reflection_coeff);
+
+    if (next_weight < config_.min_path_weight) {
+        if (context) {
+            context->stats.num_weight_cuts++;
+        }
+        return PathStep::Stop;
+    }
+
+    if (next_weight < config_.roulette_weight) {
+        double survival = next_weight / config_.roulette_weight;
+
+        if (random_unit(path_id, depth) >= survival) {
+            if (context) {
+                context->stats.num_roulette_cuts++;
+            }
+            return PathStep::Drop;
+        }
+
+        *reflection_scale = 1 / survival;
+        next_weight = config_.roulette_weight;
+    }
+
+    *weight = next_weight;
+    return PathStep::Reflect;
+}
+
+
+/*
+Follows a path from its first hit through its reflections in a loop. The
+colors of the bounces wait on an explicit stack until the path ends.
+*/
+Vector3d SceneRendererBase::trace_path(const Vector3d& O,
+                                       const Vector3d& D,
+                                       const RayHit& first_hit,
+                                       unsigned long long path_id,
+                                       TraceContext* context,
+                                       const RayHit* mirror_hit) const
+{
+    PathVertex path[kMaxPathLength];
+    unsigned int path_length = 0;
+
+    Vector3d origin = O;
+    Vector3d direction = D;
+    RayHit hit = first_hit;
+    double weight = 1;
+
+    unsigned int depth = 0;
+    for (;; depth++) {
+        if (depth == 1 && mirror_hit) {
+            context->stats.num_reflection_rays++;
+            hit = *mirror_hit;
+        } else if (depth > 0) {
+            context->stats.num_reflection_rays++;
+
+            hit = RayHit();
+            hit.distance = config_.light_dist;
+            hit.actor = solve_hits(origin, direction, &hit.distance, &hit.part);
+        }
+
+        ShadePoint point;
+        if (!hit.actor || !prepare_shade_point(origin, direction, hit, &point)) {
+            break;
+        }
+
+        // Check if intersection is in shadow
+        point.occlusion = solve_occlusion(point, depth, context);
+
+        PathVertex& vertex = path[path_length++];
+        vertex.color = shade_point(point, hit, &vertex.reflection_coeff);
+        vertex.reflection_scale = 1;
+
+        PathStep step = choose_path_step(vertex.reflection_coeff, depth, path_id,
+                                         &weight, &vertex.reflection_scale, context);
+        if (step == PathStep::Stop) {
+            vertex.reflection_coeff = 1;
+        }
+        if (step != PathStep::Reflect) {
+            break;
+        }
+
+        direction = direction - (2 * direction.dot(point.normal)) * point.normal;
+        origin = point.inter_corr;
+    }
 
-    if (hit_actor) {
-        Light* my_light = scene_world_->get_light_ptr();
+    context->stats.add_path(depth);
 
-        Vector3d inter = (D * curr_dist) + O;
-        Vector3d normal = hit_actor->calculate_normal_at_hit(inter);
-        Vector3d to_light = my_light->calculate_ray(inter);
+    return blend_path(path, path_length);
+}
 
-        // Calculate light intensity
-        double light_dist = to_light.norm();
-        to_light *= (1 / light_dist);
 
-        double intensity = to_light.dot(normal);
+// One ray at a time, as for reflections
+void SceneRendererBase::solve_primary_hits(const RenderTile& tile,
+                                           TraceContext* context,
+                                           std::vector<PrimaryRay>* rays) const
+{
+    Camera* my_camera = scene_world_->get_camera_ptr();
+    PrimaryRay* ray = rays->data();
+    unsigned int bin = config_.screen_bins ? screen_bins_.find_bin(tile.x0, tile.y0) : 0;
 
-        if (intensity > 0) {
-            // Prevent self-intersection
-            Vector3d inter_corr = inter + config_.ray_bias * normal;
+    for (unsigned int j = tile.y0; j < tile.y1; j++) {
+        for (unsigned int i = tile.x0; i < tile.x1; i++) {
+            ray->origin = my_camera->calculate_origin(i, j);
+            ray->direction = my_camera->calculate_direction(ray->origin);
 
-            // Check if intersection is in shadow
-            bool is_shadow = solve_shadows(inter_corr, to_light, light_dist);
-            double shadow = (is_shadow) ? config_.shadow_coeff : 1;
+            ray->hit = RayHit();
+            ray->has_mirror_hit = false;
 
-            // Decrease light intensity for actors away from light
-            double ambient = 1 - std::pow(light_dist / config_.light_dist, 2);
+            double max_dist = get_primary_dist(i, j);
+            ray->hit.distance = max_dist;
+            ray->hit.actor = solve_primary_ray(bin, ray->origin, ray->direction,
+                                               &ray->hit.distance, &ray->hit.part, context);
+
+            if (!ray->hit.actor && max_dist < config_.light_dist) {
+                context->stats.num_raster_misses++;
+                ray->hit.distance = config_.light_dist;
+                ray->hit.actor = solve_primary_ray(bin, ray->origin, ray->direction,
+                                                   &ray->hit.distance, &ray->hit.part, context);
+            }
+            ray++;
+        }
+    }
+}
+
+
+// Blocks of n x n neighbouring rays share one walk through the hierarchy
+void SceneRendererBase::solve_packet_hits(const RenderTile& tile,
+                                          TraceContext* context,
+                                          std::vector<PrimaryRay>* rays) const
+{
+    Camera* my_camera = scene_world_->get_camera_ptr();
+    unsigned int tile_width = tile.x1 - tile.x0;
+    unsigned int n = config_.packet_size;
 
-            // Combine pixels
-            double lambda = intensity * shadow * ambient;
+    RayPacket packet;
+    RayHit hits[RayPacket::kMaxRays];
+    unsigned int bin = config_.screen_bins ? screen_bins_.find_bin(tile.x0, tile.y0) : 0;
 
-            MyPixel my_pick = hit_actor->pick_pixel(inter, normal);
-            Vector3d pick = my_pick.pixel.to_vec();
-            pixel_vec = (1 - lambda) * pixel_vec + lambda * pick;
+    for (unsigned int y0 = tile.y0; y0 < tile.y1; y0 += n) {
+        for (unsigned int x0 = tile.x0; x0 < tile.x1; x0 += n) {
+            unsigned int x1 = std::min(x0 + n, tile.x1);
+            unsigned int y1 = std::min(y0 + n, tile.y1);
 
-            // If hit actor is reflective, trace reflected ray
-            if (depth < config_.max_recurse) {
-                if (my_pick.reflection_coeff > 0) {
-                    Vector3d reflected_ray = D - (2 * D.dot(normal)) * normal;
-                    Vector3d reflected_pixel = trace_ray_r(inter_corr, reflected_ray, depth + 1);
-                    pixel_vec = (1 - my_pick.reflection_coeff) * reflected_pixel + my_pick.reflection_coeff * pixel_vec;
+            packet.num_rays = 0;
+            for (unsigned int j = y0; j < y1; j++) {
+                for (unsigned int i = x0; i < x1; i++) {
+                    Vector3d origin = my_camera->calculate_origin(i, j);
+                    packet.add_ray(origin, my_camera->calculate_direction(origin),
+                                   get_primary_dist(i, j));
+                }
+            }
+
+            unsigned int last_x = x1 - 1;
+            unsigned int last_y = y1 - 1;
+
+            Vector3d corners[4] = {
+                packet.get_direction(0),
+                packet.get_direction(last_x - x0),
+                packet.get_direction(packet.num_rays - 1),
+                packet.get_direction((last_y - y0) * (x1 - x0))
+            };
+            packet.set_frustum(my_camera->get_eye(), corners);
+
+            if (config_.screen_bins) {
+                screen_bins_.solve_packet_hits(bin, &packet, hits, &context->stats);
+            } else {
+                scene_snapshot_->solve_packet_hits(&packet, hits, context);
+            }
+
+            unsigned int k = 0;
+            for (unsigned int j = y0; j < y1; j++) {
+                for (unsigned int i = x0; i < x1; i++) {
+                    PrimaryRay& ray = (*rays)[(j - tile.y0) * tile_width + (i - tile.x0)];
+                    ray.origin = packet.get_origin(k);
+                    ray.direction = packet.get_direction(k);
+                    ray.hit = hits[k];
+                    ray.has_mirror_hit = false;
+
+                    // Missed the actor drawn for the pixel, see get_primary_dist()
+                    if (!ray.hit.actor && get_primary_dist(i, j) < config_.light_dist) {
+                        context->stats.num_raster_misses++;
+                        ray.hit.distance = config_.light_dist;
+                        ray.hit.actor = solve_primary_ray(bin, ray.origin, ray.direction,
+                                                          &ray.hit.distance, &ray.hit.part,
+                                                          context);
+                    }
+                    k++;
                 }
             }
         }
     }
+}
 
-    return pixel_vec;
+
+/*
+Rays reflected off a flat mirror are the primary rays of a camera mirrored
+behind it, so a block which sees one mirror reflects into a frustum too.
+Its apex is the mirrored eye and its corners are the reflected corner
+rays. The reflected rays start off the mirror by the ray bias, so the
+frustum is widened by as much. Rays which hit another mirror of the block
+reflect one at a time later on. Only rays whose path reflects at its first
+hit join a packet, so images do not change.
+*/
+void SceneRendererBase::solve_mirror_hits(const RenderTile& tile,
+                                          TraceContext* context,
+                                          std::vector<PrimaryRay>* rays) const
+{
+    Camera* my_camera = scene_world_->get_camera_ptr();
+    unsigned int tile_width = tile.x1 - tile.x0;
+    unsigned int n = config_.packet_size;
+
+    RayPacket packet;
+    RayHit hits[RayPacket::kMaxRays];
+    PrimaryRay* members[RayPacket::kMaxRays];
+
+    for (unsigned int y0 = tile.y0; y0 < tile.y1; y0 += n) {
+        for (unsigned int x0 = tile.x0; x0 < tile.x1; x0 += n) {
+            unsigned int x1 = std::min(x0 + n, tile.x1);
+            unsigned int y1 = std::min(y0 + n, tile.y1);
+
+            auto get_ray = [&](unsigned int i, unsigned int j) -> PrimaryRay& {
+                return (*rays)[(j - tile.y0) * tile_width + (i - tile.x0)];
+            };
+
+            const ActorBase* mirror = nullptr;
+            packet.num_rays = 0;
+
+            for (unsigned int j = y0; j < y1; j++) {
+                for (unsigned int i = x0; i < x1; i++) {
+                    PrimaryRay& ray = get_ray(i, j);
+                    const ActorBase* actor = ray.hit.actor;
+
+                    if (!actor || (mirror && actor != mirror) || !actor->is_planar()) {
+                        continue;
+                    }
+
+                    ShadePoint point;
+                    if (!prepare_shade_point(ray.origin, ray.direction, ray.hit, &point)) {
+                        continue;
+                    }
+
+                    // Same first step as the path of the pixel will take
+                    const Material& material = scene_snapshot_->get_material(
+                                actor->get_part_material(ray.hit.part));
+                    MyPixel my_pick = pick_material_pixel(material, point.inter, point.normal,
+                                                          actor->get_local_basis());
+                    double weight = 1;
+                    double reflection_scale = 1;
+                    if (choose_path_step(my_pick.reflection_coeff, 0, get_path_id(i, j, 0),
+                                         &weight, &reflection_scale, nullptr) != PathStep::Reflect) {
+                        continue;
+                    }
+
+                    // Same reflected ray as in trace_path()
+                    const Vector3d& D = ray.direction;
+                    Vector3d reflected_ray = D - (2 * D.dot(point.normal)) * point.normal;
+
+                    mirror = actor;
+                    members[packet.num_rays] = &ray;
+                    packet.add_ray(point.inter_corr, reflected_ray, config_.light_dist);
+                }
+            }
+
+            // Single rays are cheaper to reflect on their own
+            if (packet.num_rays < 2) {
+                continue;
+            }
+
+            const StandardBasis& basis = mirror->get_local_basis();
+            auto reflect = [&](const Vector3d& v) {
+                return Vector3d(v - (2 * v.dot(basis.vk)) * basis.vk);
+            };
+
+            const Vector3d& eye = my_camera->get_eye();
+            Vector3d mirrored_eye = eye - (2 * (eye - basis.o).dot(basis.vk)) * basis.vk;
+
+            Vector3d corners[4] = {
+                reflect(get_ray(x0, y0).direction),
+                reflect(get_ray(x1 - 1, y0).direction),
+                reflect(get_ray(x1 - 1, y1 - 1).direction),
+                reflect(get_ray(x0, y1 - 1).direction)
+            };
+            packet.set_frustum(mirrored_eye, corners, config_.ray_bias);
+
+            scene_snapshot_->solve_packet_hits(&packet, hits, context);
+
+            for (unsigned int k = 0; k < packet.num_rays; k++) {
+                members[k]->mirror_hit = hits[k];
+                members[k]->has_mirror_hit = true;
+            }
+
+            context->stats.num_mirror_packets++;
+            context->stats.num_mirror_rays += packet.num_rays;
+        }
+    }
+}
+
+
+// Primary hits come first so that their cost can be timed on its own
+void SceneRendererBase::solve_tile_hits(const RenderTile& tile,
+                                        TraceContext* context,
+                                        std::vector<PrimaryRay>* primary_rays) const
+{
+    StopWatch primary_watch;
+    unsigned int num_rays = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+
+    primary_rays->resize(num_rays);
+    if (config_.packet_size > 1) {
+        solve_packet_hits(tile, context, primary_rays);
+    } else {
+        solve_primary_hits(tile, context, primary_rays);
+    }
+
+    context->stats.primary_time += primary_watch.elapsed();
+    context->stats.num_primary_rays += num_rays;
+
+    if (config_.packet_size > 1 && config_.mirror_packets && config_.max_recurse > 0) {
+        solve_mirror_hits(tile, context, primary_rays);
+    }
 }
 
 
-void SceneRendererBase::render_block(unsigned int block_index,
-                                     unsigned int num_lines)
+static bool is_same_surface(const RayHit& a, const RayHit& b)
 {
+    if (a.actor != b.actor) {
+        return false;
+    }
+    return !a.actor || a.actor->get_part_material(a.part) == b.actor->get_part_material(b.part);
+}
+
+
+/*
+Adaptive anti-aliasing. Pixels whose surface or color differs from a
+neighbour are sampled again at jittered points, until the samples agree
+or the budget of aa_max_samples is spent. Neighbours in other tiles are
+only compared by surface, found with one extra ray each, so that tiles
+never wait for each other. The jitter is seeded by the tile position,
+which keeps images the same for any number of threads.
+*/
+void SceneRendererBase::refine_tile(const RenderTile& tile,
+                                    TraceContext* context,
+                                    const std::vector<PrimaryRay>& primary_rays,
+                                    std::vector<Vector3d>* tile_colors) const
+{
+    static const unsigned int kMinSamples = 4;
+
     Camera* my_camera = scene_world_->get_camera_ptr();
 
-    TexturePixel* pixel = &framebuffer_[block_index * num_lines * config_.width];
+    unsigned int tile_width = tile.x1 - tile.x0;
+    unsigned int tile_height = tile.y1 - tile.y0;
+    unsigned int num_rays = tile_width * tile_height;
+    unsigned int max_samples = config_.aa_max_samples;
 
-    for (unsigned int j = 0; j < num_lines; j++) {
-        for (unsigned int i = 0; i < config_.width; i++) {
-            Vector3d origin = my_camera->calculate_origin(i, j + block_index * num_lines);
-            Vector3d direction = my_camera->calculate_direction(origin);
-            Vector3d work_pixel = trace_ray_r(origin, direction, 0);
-            *pixel = TexturePixel(work_pixel);
-            pixel++;
+    context->stats.num_aa_uniform_rays += num_rays * (max_samples - 1);
+
+    auto solve_pixel_hit = [&](double x, double y, Vector3d* origin, Vector3d* direction) {
+        *origin = my_camera->calculate_subpixel_origin(x, y);
+        *direction = my_camera->calculate_direction(*origin);
+
+        RayHit hit;
+        hit.distance = config_.light_dist;
+        hit.actor = solve_hits(*origin, *direction, &hit.distance, &hit.part);
+
+        context->stats.num_aa_rays++;
+        return hit;
+    };
+
+    auto is_step = [&](const Vector3d& a, const Vector3d& b) {
+        return (a - b).cwiseAbs().maxCoeff() > config_.aa_threshold;
+    };
+
+    std::vector<unsigned char> is_edge(num_rays, 0);
+
+    for (unsigned int j = 0; j < tile_height; j++) {
+        for (unsigned int i = 0; i < tile_width; i++) {
+            unsigned int k = j * tile_width + i;
+            unsigned int neighbours[2] = {k + 1, k + tile_width};
+            bool has_neighbour[2] = {i + 1 < tile_width, j + 1 < tile_height};
+
+            for (int n = 0; n < 2; n++) {
+                unsigned int m = neighbours[n];
+                if (has_neighbour[n] &&
+                    (!is_same_surface(primary_rays[k].hit, primary_rays[m].hit) ||
+                     is_step((*tile_colors)[k], (*tile_colors)[m]))) {
+                    is_edge[k] = 1;
+                    is_edge[m] = 1;
+                }
+            }
+        }
+    }
+
+    // Pixels along the border against the first pixels of the next tiles
+    auto compare_apron = [&](unsigned int x, unsigned int y, unsigned int k) {
+        Vector3d origin, direction;
+        RayHit hit = solve_pixel_hit(x, y, &origin, &direction);
+        if (!is_same_surface(hit, primary_rays[k].hit)) {
+            is_edge[k] = 1;
         }
+    };
+
+    for (unsigned int j = 0; j < tile_height; j++) {
+        if (tile.x0 > 0) {
+            compare_apron(tile.x0 - 1, tile.y0 + j, j * tile_width);
+        }
+        if (tile.x1 < config_.width) {
+            compare_apron(tile.x1, tile.y0 + j, j * tile_width + tile_width - 1);
+        }
+    }
+
+    for (unsigned int i = 0; i < tile_width; i++) {
+        if (tile.y0 > 0) {
+            compare_apron(tile.x0 + i, tile.y0 - 1, i);
+        }
+        if (tile.y1 < config_.height) {
+            compare_apron(tile.x0 + i, tile.y1, (tile_height - 1) * tile_width + i);
+        }
+    }
+
+    std::minstd_rand generator(tile.y0 * config_.width + tile.x0 + 1);
+    std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+
+    for (unsigned int k = 0; k < num_rays; k++) {
+        if (!is_edge[k]) {
+            continue;
+        }
+
+        unsigned int x = tile.x0 + k % tile_width;
+        unsigned int y = tile.y0 + k / tile_width;
+
+        Vector3d first = (*tile_colors)[k];
+        Vector3d sum = first;
+        Vector3d lo = first;
+        Vector3d hi = first;
+
+        unsigned int num_samples = 1;
+        while (num_samples < max_samples) {
+            // Two statements, the order of arguments is unspecified
+            double dx = jitter(generator);
+            double dy = jitter(generator);
+
+            Vector3d origin, direction;
+            RayHit hit = solve_pixel_hit(x + dx, y + dy, &origin, &direction);
+            Vector3d sample = trace_path(origin, direction, hit,
+                                         get_path_id(x, y, num_samples), context);
+
+            sum += sample;
+            lo = lo.cwiseMin(sample);
+            hi = hi.cwiseMax(sample);
+            num_samples++;
+
+            if (num_samples >= kMinSamples && !is_step(lo, hi)) {
+                break;
+            }
+        }
+
+        (*tile_colors)[k] = sum / num_samples;
+        context->stats.num_aa_pixels++;
+    }
+}
+
+
+// Copy whole tile rows to the frame
+void SceneRendererBase::store_tile(const RenderTile& tile,
+                                   const std::vector<Vector3d>& tile_colors)
+{
+    unsigned int tile_width = tile.x1 - tile.x0;
+    unsigned int tile_height = tile.y1 - tile.y0;
+
+    for (unsigned int j = 0; j < tile_height; j++) {
+        const Vector3d* in = &tile_colors[j * tile_width];
+        TexturePixel* out = &framebuffer_[(tile.y0 + j) * config_.width + tile.x0];
+
+        for (unsigned int i = 0; i < tile_width; i++) {
+            out[i] = TexturePixel(in[i]);
+        }
+    }
+}
+
+
+// Render into a private buffer, then copy it to the frame
+void SceneRendererBase::render_tile(const RenderTile& tile,
+                                    TraceContext* context,
+                                    std::vector<PrimaryRay>* primary_rays,
+                                    std::vector<Vector3d>* tile_colors)
+{
+    unsigned int num_rays = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+
+    solve_tile_hits(tile, context, primary_rays);
+
+    tile_colors->resize(num_rays);
+
+    unsigned int k = 0;
+    for (unsigned int j = tile.y0; j < tile.y1; j++) {
+        for (unsigned int i = tile.x0; i < tile.x1; i++, k++) {
+            const PrimaryRay& ray = (*primary_rays)[k];
+            (*tile_colors)[k] = trace_path(ray.origin, ray.direction, ray.hit,
+                                           get_path_id(i, j, 0), context,
+                                           ray.has_mirror_hit ? &ray.mirror_hit : nullptr);
+        }
+    }
+
+    if (config_.aa_max_samples > 1) {
+        refine_tile(tile, context, *primary_rays, tile_colors);
+    }
+
+    store_tile(tile, *tile_colors);
+
+    context->stats.num_pixels += num_rays;
+    context->stats.num_tiles++;
+}
+
+
+void SceneRendererBase::render_tiles(unsigned int worker, TraceContext* context)
+{
+    StopWatch busy_watch;
+
+    std::vector<PrimaryRay> primary_rays;
+    primary_rays.reserve(config_.tile_size * config_.tile_size);
+
+    std::vector<Vector3d> tile_colors;
+    tile_colors.reserve(config_.tile_size * config_.tile_size);
+
+    RenderTile tile;
+    bool stolen = false;
+
+    while (tile_scheduler_.next_tile(worker, &tile, &stolen)) {
+        if (stolen) {
+            context->stats.num_steals++;
+        }
+
+        render_tile(tile, context, &primary_rays, &tile_colors);
         progress_slider_->tick();
     }
+
+    context->stats.busy_time = busy_watch.elapsed();
 }
 
-#ifdef _OPENMP
+void SceneRendererBase::run_workers(const std::function<void(unsigned int)>& job)
+{
+    job(0);
+}
+
+
 class ParallelSceneRenderer : public SceneRendererBase
 {
 public:
     ParallelSceneRenderer(const RendererConfig& config, std::shared_ptr<ProgressSlider> slider)
         : SceneRendererBase(config, slider)
+        , thread_pool_(config.num_thread)
     {
         std::stringstream convert;
         convert << config.num_thread;
@@ -160,34 +880,91 @@ public:
     float do_render(SceneWorld* scene_world) override
     {
         scene_world_ = scene_world;
+        scene_snapshot_ = scene_world_->get_snapshot();
         Camera* my_camera = scene_world_->get_camera_ptr();
         my_camera->calculate_window(config_.width, config_.height, perspective_);
-        
-        if (config_.num_thread != 0) {
-            omp_set_num_threads(static_cast<int>(config_.num_thread));
-        }
 
-        clock_t time_start = clock();
+        StopWatch render_watch;
+        bin_actors();
+        rasterize_primary();
+        build_shadow_map();
 
-#pragma omp parallel for
-        for (unsigned int i = 0; i < config_.num_thread; i++) {
-            render_block(i, config_.height / config_.num_thread);
-        }
+        tile_scheduler_.reset(config_.num_thread);
+        std::vector<TraceContext> contexts(config_.num_thread);
+
+        thread_pool_.run([&](unsigned int worker) {
+            render_tiles(worker, &contexts[worker]);
+        });
+
+        collect_stats(contexts);
+
+        return static_cast<float>(render_watch.elapsed());
+    }
 
-        // fill remaining rows if any
-        unsigned int rows_fill = config_.height % config_.num_thread;
-        if (rows_fill) {
-            render_block(config_.num_thread, rows_fill);
+private:
+    ThreadPool thread_pool_;
+
+    void run_workers(const std::function<void(unsigned int)>& job) override
+    {
+        thread_pool_.run(job);
+    }
+};
+
+
+#ifdef _OPENMP
+class OpenMPSceneRenderer : public SceneRendererBase
+{
+public:
+    OpenMPSceneRenderer(const RendererConfig& config, std::shared_ptr<ProgressSlider> slider)
+        : SceneRendererBase(config, slider)
+    {
+        std::stringstream convert;
+        convert << config.num_thread;
+        std::string str_thread(convert.str());
+
+        LOG_INFO(std::string("Using OpenMP renderer with " + str_thread + " threads"));
+    }
+
+    ~OpenMPSceneRenderer() override = default;
+
+    float do_render(SceneWorld* scene_world) override
+    {
+        scene_world_ = scene_world;
+        scene_snapshot_ = scene_world_->get_snapshot();
+        Camera* my_camera = scene_world_->get_camera_ptr();
+        my_camera->calculate_window(config_.width, config_.height, perspective_);
+
+        StopWatch render_watch;
+        bin_actors();
+        rasterize_primary();
+        build_shadow_map();
+
+        tile_scheduler_.reset(config_.num_thread);
+        std::vector<TraceContext> contexts(config_.num_thread);
+
+#pragma omp parallel num_threads(config_.num_thread)
+        {
+            unsigned int worker = static_cast<unsigned int>(omp_get_thread_num());
+            render_tiles(worker, &contexts[worker]);
         }
 
-        clock_t time_elapsed = std::clock() - time_start;
-        float time_used = static_cast<float>(time_elapsed) / CLOCKS_PER_SEC / config_.num_thread;
+        collect_stats(contexts);
 
-        return time_used;
+        return static_cast<float>(render_watch.elapsed());
+    }
+
+private:
+    void run_workers(const std::function<void(unsigned int)>& job) override
+    {
+#pragma omp parallel num_threads(config_.num_thread)
+        {
+            job(static_cast<unsigned int>(omp_get_thread_num()));
+        }
     }
 };
 #endif  // _OPENMP
 
+
 class SceneRenderer : public SceneRendererBase
 {
 public:
@@ -202,30 +979,332 @@ public:
     float do_render(SceneWorld* scene_world) override
     {
         scene_world_ = scene_world;
+        scene_snapshot_ = scene_world_->get_snapshot();
         Camera* my_camera = scene_world_->get_camera_ptr();
         my_camera->calculate_window(config_.width, config_.height, perspective_);
 
-        clock_t time_start = clock();
-        render_block(0, config_.height);
+        StopWatch render_watch;
+        bin_actors();
+        rasterize_primary();
+        build_shadow_map();
+
+        tile_scheduler_.reset(1);
+
+        std::vector<TraceContext> contexts(1);
+        render_tiles(0, &contexts[0]);
 
-        return static_cast<float>(std::clock() - time_start) / CLOCKS_PER_SEC;
+        collect_stats(contexts);
+
+        return static_cast<float>(render_watch.elapsed());
+    }
+};
+
+
+// Ray waiting for its closest hit, in the queue of one bounce
+struct WavefrontRay
+{
+    Vector3d origin;
+    Vector3d direction;
+    RayHit hit;
+    double weight;
+    unsigned long long path_id;
+    unsigned int pixel;
+};
+
+
+// Hit facing the light, waiting for its shadow ray and its color
+struct ShadeRecord
+{
+    const WavefrontRay* ray;
+    ShadePoint point;
+};
+
+
+// Buffers of one render thread, kept from tile to tile
+struct WavefrontQueues
+{
+    std::vector<PrimaryRay> primary_rays;
+    std::vector<WavefrontRay> rays;
+    std::vector<WavefrontRay> next_rays;
+    std::vector<ShadeRecord> shade_records;
+
+    std::vector<PathVertex> paths;  // max_recurse + 1 per pixel
+    std::vector<unsigned int> path_lengths;
+    std::vector<unsigned int> num_reflections;
+    std::vector<Vector3d> tile_colors;
+};
+
+
+/*
+Renders a tile in stages instead of following each pixel depth first.
+All rays of one bounce find their closest hits, then all shadow rays are
+traced, then all hits are shaded, and the reflected rays form the queue
+of the next bounce. Each stage runs one kind of code over many rays, and
+the shadow rays of a bounce share the occluder cache of their depth.
+Paths are blended back to front as in trace_path(), so images are
+identical.
+*/
+class WavefrontSceneRenderer : public SceneRendererBase
+{
+public:
+    WavefrontSceneRenderer(const RendererConfig& config, std::shared_ptr<ProgressSlider> slider)
+        : SceneRendererBase(config, slider)
+        , thread_pool_(config.num_thread)
+    {
+        std::stringstream convert;
+        convert << config.num_thread;
+        std::string str_thread(convert.str());
+
+        LOG_INFO(std::string("Using wavefront renderer with " + str_thread + " threads"));
+    }
+
+    ~WavefrontSceneRenderer() override = default;
+
+    float do_render(SceneWorld* scene_world) override
+    {
+        scene_world_ = scene_world;
+        scene_snapshot_ = scene_world_->get_snapshot();
+        Camera* my_camera = scene_world_->get_camera_ptr();
+        my_camera->calculate_window(config_.width, config_.height, perspective_);
+
+        StopWatch render_watch;
+        bin_actors();
+        rasterize_primary();
+        build_shadow_map();
+
+        tile_scheduler_.reset(config_.num_thread);
+        std::vector<TraceContext> contexts(config_.num_thread);
+
+        thread_pool_.run([&](unsigned int worker) {
+            render_tiles(worker, &contexts[worker]);
+        });
+
+        collect_stats(contexts);
+
+        return static_cast<float>(render_watch.elapsed());
+    }
+
+private:
+    ThreadPool thread_pool_;
+
+    void run_workers(const std::function<void(unsigned int)>& job) override
+    {
+        thread_pool_.run(job);
+    }
+
+    void render_tiles(unsigned int worker, TraceContext* context) override
+    {
+        StopWatch busy_watch;
+
+        WavefrontQueues queues;
+        RenderTile tile;
+        bool stolen = false;
+
+        while (tile_scheduler_.next_tile(worker, &tile, &stolen)) {
+            if (stolen) {
+                context->stats.num_steals++;
+            }
+
+            render_wavefront(tile, context, &queues);
+            progress_slider_->tick();
+        }
+
+        context->stats.busy_time = busy_watch.elapsed();
+    }
+
+    void render_wavefront(const RenderTile& tile, TraceContext* context,
+                          WavefrontQueues* queues)
+    {
+        unsigned int tile_width = tile.x1 - tile.x0;
+        unsigned int num_rays = tile_width * (tile.y1 - tile.y0);
+
+        solve_tile_hits(tile, context, &queues->primary_rays);
+
+        queues->paths.resize(num_rays * (config_.max_recurse + 1));
+        queues->path_lengths.assign(num_rays, 0);
+        queues->num_reflections.assign(num_rays, 0);
+
+        queues->rays.clear();
+        for (unsigned int k = 0; k < num_rays; k++) {
+            const PrimaryRay& ray = queues->primary_rays[k];
+            if (ray.hit.actor) {
+                unsigned long long path_id = get_path_id(tile.x0 + k % tile_width,
+                                                         tile.y0 + k / tile_width, 0);
+                queues->rays.push_back(WavefrontRay{ray.origin, ray.direction, ray.hit,
+                                                    1, path_id, k});
+            }
+        }
+
+        for (unsigned int depth = 0; !queues->rays.empty(); depth++) {
+            if (depth > 0) {
+                solve_ray_hits(depth, context, queues);
+            }
+            prepare_records(queues);
+            solve_shadow_rays(depth, context, queues);
+            shade_bounce(depth, context, queues);
+
+            std::swap(queues->rays, queues->next_rays);
+        }
+
+        blend_paths(num_rays, context, queues);
+
+        // Extra samples of edge pixels follow their paths one by one
+        if (config_.aa_max_samples > 1) {
+            refine_tile(tile, context, queues->primary_rays, &queues->tile_colors);
+        }
+
+        store_tile(tile, queues->tile_colors);
+
+        context->stats.num_pixels += num_rays;
+        context->stats.num_tiles++;
+    }
+
+    // Closest hits of reflected rays, rays which miss leave the queue
+    void solve_ray_hits(unsigned int depth, TraceContext* context,
+                        WavefrontQueues* queues) const
+    {
+        std::vector<WavefrontRay>& rays = queues->rays;
+        size_t num_hits = 0;
+
+        for (WavefrontRay& ray : rays) {
+            queues->num_reflections[ray.pixel]++;
+
+            const PrimaryRay& primary_ray = queues->primary_rays[ray.pixel];
+            if (depth == 1 && primary_ray.has_mirror_hit) {
+                ray.hit = primary_ray.mirror_hit;
+            } else {
+                ray.hit.distance = config_.light_dist;
+                ray.hit.actor = solve_hits(ray.origin, ray.direction,
+                                           &ray.hit.distance, &ray.hit.part);
+            }
+            if (ray.hit.actor) {
+                rays[num_hits++] = ray;
+            }
+        }
+
+        context->stats.num_reflection_rays += rays.size();
+        rays.resize(num_hits);
+    }
+
+    void prepare_records(WavefrontQueues* queues) const
+    {
+        queues->shade_records.clear();
+
+        for (const WavefrontRay& ray : queues->rays) {
+            ShadeRecord record;
+            record.ray = &ray;
+            if (prepare_shade_point(ray.origin, ray.direction, ray.hit, &record.point)) {
+                queues->shade_records.push_back(record);
+            }
+        }
+    }
+
+    void solve_shadow_rays(unsigned int depth, TraceContext* context,
+                           WavefrontQueues* queues) const
+    {
+        for (ShadeRecord& record : queues->shade_records) {
+            ShadePoint& point = record.point;
+            point.occlusion = solve_occlusion(point, depth, context);
+        }
+    }
+
+    // Colors the hits and queues the reflected rays for the next bounce
+    void shade_bounce(unsigned int depth, TraceContext* context,
+                      WavefrontQueues* queues) const
+    {
+        queues->next_rays.clear();
+
+        for (const ShadeRecord& record : queues->shade_records) {
+            const WavefrontRay& ray = *record.ray;
+            const ShadePoint& point = record.point;
+
+            PathVertex& vertex = queues->paths[ray.pixel * (config_.max_recurse + 1) + depth];
+            vertex.color = shade_point(point, ray.hit, &vertex.reflection_coeff);
+            vertex.reflection_scale = 1;
+            queues->path_lengths[ray.pixel] = depth + 1;
+
+            double weight = ray.weight;
+            PathStep step = choose_path_step(vertex.reflection_coeff, depth, ray.path_id,
+                                             &weight, &vertex.reflection_scale, context);
+            if (step == PathStep::Stop) {
+                vertex.reflection_coeff = 1;
+            }
+            if (step != PathStep::Reflect) {
+                continue;
+            }
+
+            Vector3d reflected_ray = ray.direction - (2 * ray.direction.dot(point.normal)) * point.normal;
+            queues->next_rays.push_back(WavefrontRay{point.inter_corr, reflected_ray, RayHit(),
+                                                     weight, ray.path_id, ray.pixel});
+        }
+    }
+
+    void blend_paths(unsigned int num_rays, TraceContext* context,
+                     WavefrontQueues* queues) const
+    {
+        queues->tile_colors.resize(num_rays);
+
+        for (unsigned int k = 0; k < num_rays; k++) {
+            queues->tile_colors[k] = blend_path(&queues->paths[k * (config_.max_recurse + 1)],
+                                                queues->path_lengths[k]);
+            context->stats.add_path(queues->num_reflections[k]);
+        }
     }
 };
 
 
 std::shared_ptr<SceneRendererBase> create_renderer(const RendererConfig& config)
 {
-#ifdef _OPENMP
-    // TODO Implement slider for multiple threads
-    auto dummy_slider = create_progress_slider(config.height, ProgressSliderType::DUMMY);
-    if (config.num_thread > 1) {
-        return std::shared_ptr<SceneRendererBase>(new ParallelSceneRenderer(config, dummy_slider));
+    RendererConfig renderer_config = config;
+
+    if (renderer_config.num_thread == 0) {
+        unsigned int num_cores = std::thread::hardware_concurrency();
+        renderer_config.num_thread = std::min(std::max(num_cores, 1u), config.num_max_thread);
     }
+
+    unsigned int num_tiles = count_tiles(config.width, config.height, config.tile_size);
+
+    if (renderer_config.mode == RendererMode::Wavefront) {
+        ProgressSliderType slider_type = (renderer_config.num_thread > 1) ?
+                    ProgressSliderType::DUMMY : ProgressSliderType::DEFAULT;
+        auto slider = create_progress_slider(num_tiles, slider_type);
+
+        if (renderer_config.backend == RendererBackend::OpenMP) {
+            LOG_WARNING("Wavefront renderer only runs on native threads");
+        }
+
+        return std::shared_ptr<SceneRendererBase>(
+                    new WavefrontSceneRenderer(renderer_config, slider));
+    }
+
+    if (renderer_config.num_thread > 1) {
+        // TODO Implement slider for multiple threads
+        auto dummy_slider = create_progress_slider(num_tiles, ProgressSliderType::DUMMY);
+
+        if (renderer_config.backend == RendererBackend::OpenMP) {
+#ifdef _OPENMP
+            return std::shared_ptr<SceneRendererBase>(
+                        new OpenMPSceneRenderer(renderer_config, dummy_slider));
+#else
+            LOG_WARNING("Built without OpenMP, using native threads");
 #endif  // _OPENMP
+        }
+
+        StopWatch pool_watch;
+        auto renderer = std::shared_ptr<SceneRendererBase>(
+                    new ParallelSceneRenderer(renderer_config, dummy_slider));
+
+        std::stringstream pool_time;
+        pool_time << "Started render threads in " << std::setprecision(3)
+                  << pool_watch.elapsed() * 1000 << "ms";
+        LOG_DEBUG(pool_time.str());
+
+        return renderer;
+    }
 
-    auto slider = create_progress_slider(config.height, ProgressSliderType::DEFAULT);
+    auto slider = create_progress_slider(num_tiles, ProgressSliderType::DEFAULT);
 
-    return std::shared_ptr<SceneRendererBase>(new SceneRenderer(config, slider));
+    return std::shared_ptr<SceneRendererBase>(new SceneRenderer(renderer_config, slider));
 }
 
 
@@ -3,9 +3,15 @@
 
 #include <Eigen/Core>
 #include <vector>
+#include <functional>
 #include <memory>
 
+#include "raster.h"
+#include "scheduler.h"
+#include "screenbins.h"
+#include "shadowmap.h"
 #include "slider.h"
+#include "stats.h"
 #include "actors.h"
 #include "world.h"
 
@@ -14,6 +20,27 @@ using Vector3d = Eigen::Vector3d;
 
 namespace mrtp {
 
+enum class RendererBackend
+{
+    Native,
+    OpenMP
+};
+
+
+enum class ShadowMode
+{
+    Rays,      // exact, one shadow ray per hit
+    ShadowMap  // approximate, a lookup in a depth cube around the light
+};
+
+
+enum class RendererMode
+{
+    Recursive,  // each pixel follows its rays depth first
+    Wavefront   // rays of a tile advance one bounce at a time
+};
+
+
 struct RendererConfig
 {
     double fov = 93;
@@ -25,7 +52,29 @@ struct RendererConfig
     unsigned int height = 480;
 
     unsigned int max_recurse = 3;
+
+    // Reflections stop once they could change a pixel by less than this,
+    // one step of an 8-bit channel by default
+    double min_path_weight = 1.0 / 255;
+
+    // Lighter paths go on by chance, zero turns roulette off
+    double roulette_weight = 0;
     unsigned int num_thread = 1;
+    unsigned int tile_size = 16;
+    unsigned int packet_size = 4;  // primary rays traced as packets of n x n
+    bool mirror_packets = true;    // and their reflections off flat mirrors
+    bool screen_bins = false;      // primary rays test the actors binned by tile
+    bool raster_primary = false;   // and end past the depth drawn for their pixel
+
+    // Pixels on edges get up to this many samples, one turns it off
+    unsigned int aa_max_samples = 1;
+    double aa_threshold = 0.1;  // largest color step between neighbours left alone
+
+    ShadowMode shadows = ShadowMode::Rays;
+    unsigned int shadow_map_size = 256;  // texels along each edge of a cube face
+
+    RendererBackend backend = RendererBackend::Native;
+    RendererMode mode = RendererMode::Recursive;
 
     const double fov_min = 70;
     const double fov_max = 150;
@@ -36,8 +85,69 @@ struct RendererConfig
     const unsigned int height_min = 240;
     const unsigned int height_max = 2400;
 
-    const unsigned int num_min_thread = 1;
+    const unsigned int num_min_thread = 0;
     const unsigned int num_max_thread = 32;
+
+    const unsigned int tile_size_min = 4;
+    const unsigned int tile_size_max = 256;
+
+    const unsigned int max_recurse_min = 0;
+    const unsigned int max_recurse_max = 31;  // paths fit on a stack of 32 bounces
+
+    const double path_weight_min = 0;
+    const double path_weight_max = 1;
+
+    const unsigned int packet_size_min = 1;
+    const unsigned int packet_size_max = 4;
+
+    const unsigned int aa_max_samples_min = 1;
+    const unsigned int aa_max_samples_max = 64;
+
+    const unsigned int shadow_map_size_min = 16;
+    const unsigned int shadow_map_size_max = 4096;
+};
+
+
+struct PrimaryRay
+{
+    Vector3d origin;
+    Vector3d direction;
+    RayHit hit;
+
+    // Hit of the reflection off a flat mirror, found for a whole block
+    RayHit mirror_hit;
+    bool has_mirror_hit = false;
+};
+
+
+// Hit facing the light, with what shading it needs
+struct ShadePoint
+{
+    Vector3d inter;
+    Vector3d inter_corr;  // moved off the surface for the next rays
+    Vector3d normal;
+    Vector3d to_light;
+    double light_dist;
+    double intensity;
+    double occlusion;  // share of the light blocked, 0 or 1 with shadow rays
+};
+
+
+// Color of one bounce, blended with the bounces after it once the path
+// ends. The last bounce of a path has a coefficient of one.
+struct PathVertex
+{
+    Vector3d color;
+    double reflection_coeff;
+    double reflection_scale;  // makes up for paths dropped by roulette
+};
+
+
+enum class PathStep
+{
+    Reflect,
+    Stop,  // the hit keeps its whole color, as at max_recurse
+    Drop   // dropped by roulette, the reflection counts as black
 };
 
 
@@ -50,6 +160,8 @@ public:
 
     virtual float do_render(SceneWorld*) = 0;
 
+    const RenderStats& get_stats() const;
+
     //FIXME
     RendererConfig config_;
     std::vector<TexturePixel> framebuffer_;
@@ -59,12 +171,53 @@ protected:
     double perspective_;
 
     SceneWorld* scene_world_;
+    const SceneSnapshot* scene_snapshot_;
     std::shared_ptr<ProgressSlider> progress_slider_;
 
-    Vector3d trace_ray_r(const Vector3d&, const Vector3d&, unsigned int) const;
-    ActorBase* solve_hits(const Vector3d&, const Vector3d&, double*) const;
-    bool solve_shadows(const Vector3d&, const Vector3d&, double) const;
-    void render_block(unsigned int, unsigned int);
+    TileScheduler tile_scheduler_;
+    ScreenBins screen_bins_;
+    VisibilityBuffer visibility_buffer_;
+    ShadowMap shadow_map_;
+    RenderStats stats_;
+
+    static const unsigned int kMaxPathLength = 32;
+
+    unsigned long long get_path_id(unsigned int, unsigned int, unsigned int) const;
+    bool prepare_shade_point(const Vector3d&, const Vector3d&, const RayHit&,
+                             ShadePoint*) const;
+    Vector3d shade_point(const ShadePoint&, const RayHit&, double*) const;
+    PathStep choose_path_step(double, unsigned int, unsigned long long,
+                              double*, double*, TraceContext*) const;
+    Vector3d trace_path(const Vector3d&, const Vector3d&, const RayHit&,
+                        unsigned long long, TraceContext*,
+                        const RayHit* = nullptr) const;
+    void solve_primary_hits(const RenderTile&, TraceContext*,
+                            std::vector<PrimaryRay>*) const;
+    void solve_packet_hits(const RenderTile&, TraceContext*,
+                           std::vector<PrimaryRay>*) const;
+    void solve_mirror_hits(const RenderTile&, TraceContext*,
+                           std::vector<PrimaryRay>*) const;
+    ActorBase* solve_hits(const Vector3d&, const Vector3d&, double*, unsigned int*) const;
+    ActorBase* solve_primary_ray(unsigned int, const Vector3d&, const Vector3d&,
+                                 double*, unsigned int*, TraceContext*) const;
+    double get_primary_dist(unsigned int, unsigned int) const;
+    bool solve_shadows(const Vector3d&, const Vector3d&, double,
+                       unsigned int, TraceContext*) const;
+    double solve_occlusion(const ShadePoint&, unsigned int, TraceContext*) const;
+    void solve_tile_hits(const RenderTile&, TraceContext*, std::vector<PrimaryRay>*) const;
+    void refine_tile(const RenderTile&, TraceContext*, const std::vector<PrimaryRay>&,
+                     std::vector<Vector3d>*) const;
+    void store_tile(const RenderTile&, const std::vector<Vector3d>&);
+    void render_tile(const RenderTile&, TraceContext*, std::vector<PrimaryRay>*,
+                     std::vector<Vector3d>*);
+    void bin_actors();
+    void rasterize_primary();
+    void build_shadow_map();
+    void collect_stats(const std::vector<TraceContext>&);
+    virtual void render_tiles(unsigned int, TraceContext*);
+
+    // Runs a job once on every render thread, as worker 0 only by default
+    virtual void run_workers(const std::function<void(unsigned int)>&);
 };
 
 
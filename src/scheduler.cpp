@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <utility>
+
+#include "scheduler.h"
+
+
+namespace mrtp {
+
+static unsigned long long pack_run(unsigned int begin, unsigned int end)
+{
+    return (static_cast<unsigned long long>(end) << 32) | begin;
+}
+
+
+static unsigned int run_begin(unsigned long long run)
+{
+    return static_cast<unsigned int>(run & 0xffffffffULL);
+}
+
+
+static unsigned int run_end(unsigned long long run)
+{
+    return static_cast<unsigned int>(run >> 32);
+}
+
+
+// Interleave the lower 16 bits of x and y
+static unsigned int morton_code(unsigned int x, unsigned int y)
+{
+    unsigned int code = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        code |= ((x >> i) & 1) << (2 * i);
+        code |= ((y >> i) & 1) << (2 * i + 1);
+    }
+    return code;
+}
+
+
+unsigned int count_tiles(unsigned int width, unsigned int height,
+                         unsigned int tile_size)
+{
+    unsigned int num_x = (width + tile_size - 1) / tile_size;
+    unsigned int num_y = (height + tile_size - 1) / tile_size;
+    return num_x * num_y;
+}
+
+
+TileScheduler::TileScheduler(unsigned int width,
+                             unsigned int height,
+                             unsigned int tile_size)
+    : tile_size_(tile_size)
+    , num_workers_(0)
+{
+    unsigned int num_x = (width + tile_size - 1) / tile_size;
+    unsigned int num_y = (height + tile_size - 1) / tile_size;
+
+    std::vector<std::pair<unsigned int, RenderTile>> ordered;
+    ordered.reserve(num_x * num_y);
+
+    for (unsigned int ty = 0; ty < num_y; ty++) {
+        for (unsigned int tx = 0; tx < num_x; tx++) {
+            RenderTile tile;
+            tile.x0 = tx * tile_size;
+            tile.y0 = ty * tile_size;
+            tile.x1 = std::min(tile.x0 + tile_size, width);
+            tile.y1 = std::min(tile.y0 + tile_size, height);
+            ordered.push_back(std::make_pair(morton_code(tx, ty), tile));
+        }
+    }
+
+    std::stable_sort(ordered.begin(), ordered.end(),
+        [](const std::pair<unsigned int, RenderTile>& a,
+           const std::pair<unsigned int, RenderTile>& b) {
+            return a.first < b.first;
+        });
+
+    tiles_.reserve(ordered.size());
+    for (const auto& item : ordered) {
+        tiles_.push_back(item.second);
+    }
+}
+
+
+// Split the tiles into one contiguous run per worker
+void TileScheduler::reset(unsigned int num_workers)
+{
+    if (num_workers != num_workers_) {
+        num_workers_ = num_workers;
+        runs_.reset(new WorkerRun[num_workers_]);
+    }
+
+    unsigned int num_tiles = get_num_tiles();
+
+    for (unsigned int i = 0; i < num_workers_; i++) {
+        unsigned int begin = static_cast<unsigned int>(
+                    static_cast<unsigned long long>(num_tiles) * i / num_workers_);
+        unsigned int end = static_cast<unsigned int>(
+                    static_cast<unsigned long long>(num_tiles) * (i + 1) / num_workers_);
+        runs_[i].run.store(pack_run(begin, end), std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+
+bool TileScheduler::take_tile(unsigned int worker, unsigned int* index)
+{
+    std::atomic<unsigned long long>& run = runs_[worker].run;
+    unsigned long long current = run.load(std::memory_order_acquire);
+
+    while (true) {
+        unsigned int begin = run_begin(current);
+        unsigned int end = run_end(current);
+        if (begin >= end) {
+            return false;
+        }
+
+        if (run.compare_exchange_weak(current, pack_run(begin + 1, end),
+                                      std::memory_order_acq_rel)) {
+            *index = begin;
+            return true;
+        }
+    }
+}
+
+
+// Move the upper half of the next non-empty run to this worker
+bool TileScheduler::steal_tiles(unsigned int worker)
+{
+    for (unsigned int i = 1; i < num_workers_; i++) {
+        unsigned int victim = (worker + i) % num_workers_;
+        std::atomic<unsigned long long>& run = runs_[victim].run;
+        unsigned long long current = run.load(std::memory_order_acquire);
+
+        while (true) {
+            unsigned int begin = run_begin(current);
+            unsigned int end = run_end(current);
+            if (begin >= end) {
+                break;
+            }
+
+            unsigned int num_stolen = (end - begin + 1) / 2;
+            unsigned int split = end - num_stolen;
+
+            if (run.compare_exchange_weak(current, pack_run(begin, split),
+                                          std::memory_order_acq_rel)) {
+                runs_[worker].run.store(pack_run(split, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+bool TileScheduler::next_tile(unsigned int worker, RenderTile* tile, bool* stolen)
+{
+    unsigned int index = 0;
+    bool is_stolen = false;
+
+    while (!take_tile(worker, &index)) {
+        if (!steal_tiles(worker)) {
+            return false;
+        }
+        is_stolen = true;
+    }
+
+    if (stolen) {
+        *stolen = is_stolen;
+    }
+
+    *tile = tiles_[index];
+    return true;
+}
+
+
+unsigned int TileScheduler::get_num_tiles() const
+{
+    return static_cast<unsigned int>(tiles_.size());
+}
+
+
+unsigned int TileScheduler::get_tile_size() const
+{
+    return tile_size_;
+}
+
+
+} // namespace mrtp
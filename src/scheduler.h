@@ -0,0 +1,62 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+namespace mrtp {
+
+struct RenderTile
+{
+    unsigned int x0;
+    unsigned int y0;
+    unsigned int x1;  // exclusive
+    unsigned int y1;  // exclusive
+};
+
+
+/*
+Hands out tiles of a frame to render threads. Tiles are sorted in Morton
+order and every thread starts with a contiguous run of them. A thread
+which runs out of tiles steals half of the remaining run of another one.
+A run is a pair of 32-bit indices packed into a single atomic word, so
+both taking and stealing are a single compare-and-swap.
+*/
+class TileScheduler
+{
+public:
+    TileScheduler(unsigned int, unsigned int, unsigned int);
+    TileScheduler() = delete;
+    ~TileScheduler() = default;
+
+    void reset(unsigned int);
+    bool next_tile(unsigned int, RenderTile*, bool* = nullptr);
+
+    unsigned int get_num_tiles() const;
+    unsigned int get_tile_size() const;
+
+private:
+    struct alignas(64) WorkerRun
+    {
+        std::atomic<unsigned long long> run;
+    };
+
+    bool take_tile(unsigned int, unsigned int*);
+    bool steal_tiles(unsigned int);
+
+    unsigned int tile_size_;
+    std::vector<RenderTile> tiles_;
+
+    unsigned int num_workers_;
+    std::unique_ptr<WorkerRun[]> runs_;
+};
+
+
+unsigned int count_tiles(unsigned int, unsigned int, unsigned int);
+
+
+} // namespace mrtp
+
+#endif // _SCHEDULER_H
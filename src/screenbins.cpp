@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+
+#include "screenbins.h"
+
+
+namespace mrtp {
+
+// Rays of a pixel may pass up to half a pixel off its center for
+// anti-aliasing, and projections round at tile borders
+static const double kPixelPadding = 1;
+
+
+// Tile index of a window coordinate, clamped to the frame
+static unsigned int to_tile_index(double x, unsigned int tile_size, unsigned int num_tiles)
+{
+    double t = std::floor(x / tile_size);
+    return static_cast<unsigned int>(std::min(std::max(t, 0.0), num_tiles - 1.0));
+}
+
+
+// False when the box is seen by no pixel of the frame
+bool ScreenBins::find_tile_range(const Camera& camera,
+                                 const BinnedActor& item,
+                                 unsigned int* x0, unsigned int* x1,
+                                 unsigned int* y0, unsigned int* y1) const
+{
+    double x_lo = std::numeric_limits<double>::max();
+    double x_hi = std::numeric_limits<double>::lowest();
+    double y_lo = x_lo;
+    double y_hi = x_hi;
+
+    // A box in front of the eye projects into the hull of its corners
+    for (int corner = 0; corner < 8; corner++) {
+        Vector3d p{(corner & 1) ? item.hi[0] : item.lo[0],
+                   (corner & 2) ? item.hi[1] : item.lo[1],
+                   (corner & 4) ? item.hi[2] : item.lo[2]};
+
+        double x, y;
+        if (!camera.calculate_window_point(p, &x, &y)) {
+            *x0 = 0;
+            *y0 = 0;
+            *x1 = num_x_ - 1;
+            *y1 = num_y_ - 1;
+            return true;
+        }
+
+        x_lo = std::min(x_lo, x);
+        x_hi = std::max(x_hi, x);
+        y_lo = std::min(y_lo, y);
+        y_hi = std::max(y_hi, y);
+    }
+
+    x_lo -= kPixelPadding;
+    y_lo -= kPixelPadding;
+    x_hi += kPixelPadding;
+    y_hi += kPixelPadding;
+
+    if (x_hi < 0 || y_hi < 0 || x_lo > width_ || y_lo > height_) {
+        return false;
+    }
+
+    *x0 = to_tile_index(x_lo, tile_size_, num_x_);
+    *x1 = to_tile_index(x_hi, tile_size_, num_x_);
+    *y0 = to_tile_index(y_lo, tile_size_, num_y_);
+    *y1 = to_tile_index(y_hi, tile_size_, num_y_);
+    return true;
+}
+
+
+// The camera window has to be calculated for the frame
+void ScreenBins::build(SceneWorld* scene_world,
+                       unsigned int width,
+                       unsigned int height,
+                       unsigned int tile_size)
+{
+    width_ = width;
+    height_ = height;
+    tile_size_ = tile_size;
+    num_x_ = (width + tile_size - 1) / tile_size;
+    num_y_ = (height + tile_size - 1) / tile_size;
+
+    actors_.clear();
+    unbounded_actors_.clear();
+    bin_starts_.clear();
+    indices_.clear();
+
+    for (ActorIterator it = scene_world->get_actor_iterator(); !it.is_done(); it.next()) {
+        ActorBase* actor = it.current()->get();
+
+        BoundingBox box;
+        if (actor->calculate_bounds(&box)) {
+            actors_.push_back(BinnedActor{actor, box.lo, box.hi});
+        } else {
+            unbounded_actors_.push_back(actor);
+        }
+    }
+
+    const Camera& camera = *scene_world->get_camera_ptr();
+    unsigned int num_bins = num_x_ * num_y_;
+
+    struct TileRange
+    {
+        unsigned int x0, x1, y0, y1;
+        bool is_seen;
+    };
+
+    std::vector<TileRange> ranges(actors_.size());
+    std::vector<unsigned int> counts(num_bins, 0);
+
+    for (size_t a = 0; a < actors_.size(); a++) {
+        TileRange& r = ranges[a];
+        r.is_seen = find_tile_range(camera, actors_[a], &r.x0, &r.x1, &r.y0, &r.y1);
+        if (!r.is_seen) {
+            continue;
+        }
+
+        for (unsigned int ty = r.y0; ty <= r.y1; ty++) {
+            for (unsigned int tx = r.x0; tx <= r.x1; tx++) {
+                counts[ty * num_x_ + tx]++;
+            }
+        }
+    }
+
+    bin_starts_.resize(num_bins + 1);
+    bin_starts_[0] = 0;
+    for (unsigned int i = 0; i < num_bins; i++) {
+        bin_starts_[i + 1] = bin_starts_[i] + counts[i];
+    }
+
+    indices_.resize(bin_starts_[num_bins]);
+
+    // Counts become the next free slot of each bin, actors keep their order
+    std::copy(bin_starts_.begin(), bin_starts_.end() - 1, counts.begin());
+
+    for (size_t a = 0; a < actors_.size(); a++) {
+        const TileRange& r = ranges[a];
+        if (!r.is_seen) {
+            continue;
+        }
+
+        for (unsigned int ty = r.y0; ty <= r.y1; ty++) {
+            for (unsigned int tx = r.x0; tx <= r.x1; tx++) {
+                indices_[counts[ty * num_x_ + tx]++] = static_cast<unsigned int>(a);
+            }
+        }
+    }
+}
+
+
+bool ScreenBins::is_empty() const
+{
+    return bin_starts_.empty();
+}
+
+
+unsigned int ScreenBins::get_num_actors() const
+{
+    return static_cast<unsigned int>(actors_.size());
+}
+
+
+size_t ScreenBins::get_num_entries() const
+{
+    return indices_.size();
+}
+
+
+size_t ScreenBins::get_memory_size() const
+{
+    return actors_.capacity() * sizeof(BinnedActor) +
+           unbounded_actors_.capacity() * sizeof(ActorBase*) +
+           bin_starts_.capacity() * sizeof(unsigned int) +
+           indices_.capacity() * sizeof(unsigned int);
+}
+
+
+unsigned int ScreenBins::find_bin(unsigned int x, unsigned int y) const
+{
+    return (y / tile_size_) * num_x_ + x / tile_size_;
+}
+
+
+ActorBase* ScreenBins::solve_hits(unsigned int bin,
+                                  const Vector3d& O,
+                                  const Vector3d& D,
+                                  double* curr_dist,
+                                  unsigned int* hit_part,
+                                  RenderStats* stats) const
+{
+    ActorBase* hit_actor = nullptr;
+
+    auto test_actor = [&](ActorBase* actor) {
+        unsigned int part = 0;
+        double distance = actor->solve_part_ray(O, D, 0, *curr_dist, &part);
+        if (distance > 0 && distance < *curr_dist) {
+            *curr_dist = distance;
+            *hit_part = part;
+            hit_actor = actor;
+        }
+    };
+
+    for (ActorBase* actor : unbounded_actors_) {
+        test_actor(actor);
+    }
+
+    Vector3d inv_D = D.cwiseInverse();
+
+    unsigned int first = bin_starts_[bin];
+    unsigned int last = bin_starts_[bin + 1];
+
+    for (unsigned int i = first; i < last; i++) {
+        const BinnedActor& item = actors_[indices_[i]];
+        double entry = intersect_box(item.lo, item.hi, O, inv_D, *curr_dist);
+        if (entry >= 0 && entry < *curr_dist) {
+            test_actor(item.actor);
+        }
+    }
+
+    stats->num_bin_tests += last - first;
+    stats->num_bin_skips += actors_.size() - (last - first);
+
+    return hit_actor;
+}
+
+
+void ScreenBins::solve_packet_hits(unsigned int bin,
+                                   RayPacket* packet,
+                                   RayHit* hits,
+                                   RenderStats* stats) const
+{
+    stats->num_packets++;
+
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        hits[i] = RayHit();
+        hits[i].distance = packet->max_dist[i];
+    }
+
+    // Same as SceneSnapshot::solve_packet_hits()
+    auto test_actor = [&](ActorBase* actor, unsigned int rays) {
+        unsigned int parts[RayPacket::kMaxRays];
+        unsigned int hit_rays = actor->solve_packet_rays(packet, rays, parts);
+
+        for (unsigned int i = 0; i < packet->num_rays; i++) {
+            if (hit_rays & (1u << i)) {
+                hits[i].actor = actor;
+                hits[i].distance = packet->max_dist[i];
+                hits[i].part = parts[i];
+            }
+        }
+    };
+
+    for (ActorBase* actor : unbounded_actors_) {
+        test_actor(actor, packet->get_all_rays());
+    }
+
+    unsigned int first = bin_starts_[bin];
+    unsigned int last = bin_starts_[bin + 1];
+
+    for (unsigned int a = first; a < last; a++) {
+        const BinnedActor& item = actors_[indices_[a]];
+        if (packet->is_outside_frustum(item.lo, item.hi)) {
+            stats->num_frustum_culls++;
+            continue;
+        }
+
+        unsigned int rays = 0;
+        for (unsigned int i = 0; i < packet->num_rays; i++) {
+            if (packet->intersect_box(i, item.lo, item.hi) >= 0) {
+                rays |= 1u << i;
+            }
+        }
+
+        if (rays) {
+            test_actor(item.actor, rays);
+        }
+    }
+
+    stats->num_bin_tests += last - first;
+    stats->num_bin_skips += actors_.size() - (last - first);
+}
+
+
+} // namespace mrtp
@@ -0,0 +1,75 @@
+#ifndef _SCREENBINS_H
+#define _SCREENBINS_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "actors.h"
+#include "camera.h"
+#include "common.h"
+#include "packet.h"
+#include "stats.h"
+#include "world.h"
+
+
+namespace mrtp {
+
+/*
+Actors binned by the screen tiles their boxes cover, for one camera window.
+Boxes are projected through the window from the eye and padded by a pixel.
+Boxes which reach behind the eye cover every tile. Primary rays of a tile
+only test the actors of its bin and the actors of infinite extent, which
+is cheap to build every frame and needs no hierarchy.
+*/
+class ScreenBins
+{
+public:
+    ScreenBins() = default;
+    ~ScreenBins() = default;
+
+    void build(SceneWorld*, unsigned int, unsigned int, unsigned int);
+
+    bool is_empty() const;
+    unsigned int get_num_actors() const;
+    size_t get_num_entries() const;
+    size_t get_memory_size() const;
+
+    // Bin of the tile holding a pixel
+    unsigned int find_bin(unsigned int, unsigned int) const;
+
+    ActorBase* solve_hits(unsigned int, const Vector3d&, const Vector3d&,
+                          double*, unsigned int*, RenderStats*) const;
+
+    // Closest hits of a packet within one bin, the packet limits the distance
+    void solve_packet_hits(unsigned int, RayPacket*, RayHit*, RenderStats*) const;
+
+private:
+    struct BinnedActor
+    {
+        ActorBase* actor;
+        Vector3d lo;
+        Vector3d hi;
+    };
+
+    bool find_tile_range(const Camera&, const BinnedActor&,
+                         unsigned int*, unsigned int*,
+                         unsigned int*, unsigned int*) const;
+
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    unsigned int tile_size_ = 0;
+    unsigned int num_x_ = 0;
+    unsigned int num_y_ = 0;
+
+    std::vector<BinnedActor> actors_;
+    std::vector<ActorBase*> unbounded_actors_;
+
+    // Actors of bin i are [bin_starts_[i], bin_starts_[i + 1])
+    std::vector<unsigned int> bin_starts_;
+    std::vector<unsigned int> indices_;
+};
+
+
+} // namespace mrtp
+
+#endif // _SCREENBINS_H
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "shadowmap.h"
+#include "world.h"
+
+
+namespace mrtp {
+
+static const unsigned int kNumFaces = 6;
+
+// Depth bias in texel widths, and the steepest slope it grows with
+static const double kDepthBias = 0.5;
+static const double kMaxSlope = 8;
+
+
+// Texels of a face cover [-1, 1] in both directions
+static unsigned int to_texel_index(double r, unsigned int resolution)
+{
+    double x = std::floor((r + 1) * 0.5 * resolution);
+    return static_cast<unsigned int>(std::min(std::max(x, 0.0), resolution - 1.0));
+}
+
+
+void ShadowMap::reset(const Vector3d& center, unsigned int resolution)
+{
+    center_ = center;
+    resolution_ = resolution;
+    depths_.assign(static_cast<size_t>(kNumFaces) * resolution * resolution,
+                   std::numeric_limits<float>::infinity());
+}
+
+
+unsigned int ShadowMap::get_num_rows() const
+{
+    return kNumFaces * resolution_;
+}
+
+
+// Row j of face 2 * axis + side, one ray from the light per texel center
+void ShadowMap::render_row(const SceneSnapshot* snapshot, unsigned int row)
+{
+    unsigned int face = row / resolution_;
+    unsigned int j = row % resolution_;
+
+    int axis = face / 2;
+    int b = (axis + 1) % 3;
+    int c = (axis + 2) % 3;
+
+    Vector3d D;
+    D[axis] = (face % 2) ? -1 : 1;
+    D[c] = (j + 0.5) / resolution_ * 2 - 1;
+
+    float* depths = &depths_[static_cast<size_t>(row) * resolution_];
+
+    for (unsigned int i = 0; i < resolution_; i++) {
+        D[b] = (i + 0.5) / resolution_ * 2 - 1;
+        Vector3d direction = D * (1 / D.norm());
+
+        double depth = snapshot->solve_caster_depth(center_, direction,
+                                                    std::numeric_limits<double>::max());
+        depths[i] = static_cast<float>(depth);
+    }
+}
+
+
+/*
+Texels are one angle of about 2 / resolution wide, so the map only knows
+depths at their centers. Surfaces tilted away from the light change depth
+across a texel, which would shadow them from their own neighbouring texels
+without a bias growing with their slope.
+*/
+double ShadowMap::calculate_occlusion(const Vector3d& point, double cos_angle) const
+{
+    Vector3d v = point - center_;
+    Vector3d a = v.cwiseAbs();
+    int axis = (a[0] >= a[1]) ? ((a[0] >= a[2]) ? 0 : 2) : ((a[1] >= a[2]) ? 1 : 2);
+
+    double w = a[axis];
+    if (w == 0) {
+        return 0;
+    }
+
+    unsigned int face = 2 * axis + ((v[axis] < 0) ? 1 : 0);
+    int i = static_cast<int>(to_texel_index(v[(axis + 1) % 3] / w, resolution_));
+    int j = static_cast<int>(to_texel_index(v[(axis + 2) % 3] / w, resolution_));
+
+    double dist = v.norm();
+    double sin_angle = std::sqrt(std::max(1 - cos_angle * cos_angle, 0.0));
+    double slope = (sin_angle < kMaxSlope * cos_angle) ? sin_angle / cos_angle : kMaxSlope;
+    double texel_width = 2 * dist / resolution_;
+    double bias = texel_width * (kDepthBias + slope * (kFilterRadius + 1));
+
+    int last = static_cast<int>(resolution_) - 1;
+    unsigned int num_blocked = 0;
+    unsigned int num_texels = 0;
+
+    // Texels past the edge of the face are clamped to it
+    for (int dj = -kFilterRadius; dj <= kFilterRadius; dj++) {
+        for (int di = -kFilterRadius; di <= kFilterRadius; di++) {
+            int ti = std::min(std::max(i + di, 0), last);
+            int tj = std::min(std::max(j + dj, 0), last);
+
+            float depth = depths_[(face * resolution_ + tj) * resolution_ + ti];
+            if (depth < dist - bias) {
+                num_blocked++;
+            }
+            num_texels++;
+        }
+    }
+
+    return static_cast<double>(num_blocked) / num_texels;
+}
+
+
+unsigned int ShadowMap::get_resolution() const
+{
+    return resolution_;
+}
+
+
+size_t ShadowMap::get_memory_size() const
+{
+    return depths_.capacity() * sizeof(float);
+}
+
+
+} // namespace mrtp
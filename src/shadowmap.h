@@ -0,0 +1,54 @@
+#ifndef _SHADOWMAP_H
+#define _SHADOWMAP_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "common.h"
+
+
+namespace mrtp {
+
+class SceneSnapshot;
+
+
+/*
+Depth cube around a point light, an approximate answer to shadow rays.
+Each texel holds the distance from the light to the nearest actor with
+shadows in its direction. The faces are laid out as in the light buffer.
+A point is in shadow where the map holds something nearer to the light,
+and lookups filter the texels around the point (percentage closer
+filtering), so shadow edges come out soft rather than stepped.
+*/
+class ShadowMap
+{
+public:
+    ShadowMap() = default;
+    ~ShadowMap() = default;
+
+    void reset(const Vector3d&, unsigned int);
+
+    // Rows are independent, so they may be rendered by many threads
+    unsigned int get_num_rows() const;
+    void render_row(const SceneSnapshot*, unsigned int);
+
+    // Share of the light blocked from a point, from 0 to 1, for a surface
+    // which faces the light at an angle of the given cosine
+    double calculate_occlusion(const Vector3d&, double) const;
+
+    unsigned int get_resolution() const;
+    size_t get_memory_size() const;
+
+private:
+    // Texels on each side of the center one which are filtered
+    static const int kFilterRadius = 1;
+
+    Vector3d center_{0, 0, 0};
+    unsigned int resolution_ = 0;
+    std::vector<float> depths_;
+};
+
+
+} // namespace mrtp
+
+#endif // _SHADOWMAP_H
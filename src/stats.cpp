@@ -0,0 +1,148 @@
+#include <fstream>
+
+#include "stats.h"
+#include "logger.h"
+
+
+namespace mrtp {
+
+// Control characters are written as \u00XX, as JSON strings require
+static std::string escape_json(const std::string& text)
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    std::string escaped;
+    for (char c : text) {
+        unsigned char code = static_cast<unsigned char>(c);
+        if (code < 0x20) {
+            escaped += "\\u00";
+            escaped += kHexDigits[code >> 4];
+            escaped += kHexDigits[code & 0xf];
+            continue;
+        }
+
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+
+static void write_scene(std::ofstream& f, const SceneReport& report)
+{
+    const SceneTimings& t = report.timings;
+    const RenderStats& s = report.stats;
+
+    double rays_per_second = (t.render > 0) ? s.get_num_rays() / t.render : 0;
+
+    f << "    {\n";
+    f << "      \"input\": \"" << escape_json(report.input_file) << "\",\n";
+    f << "      \"output\": \"" << escape_json(report.output_file) << "\",\n";
+    f << "      \"frame\": " << report.frame << ",\n";
+    f << "      \"frames\": " << report.num_frames << ",\n";
+    f << "      \"threads\": " << report.num_threads << ",\n";
+
+    f << "      \"accel\": {\n";
+    f << "        \"name\": \"" << escape_json(report.accel_name) << "\",\n";
+    f << "        \"build\": " << report.accel_build_time << ",\n";
+    f << "        \"memory\": " << report.accel_memory << ",\n";
+    f << "        \"light_buffer\": " << (report.light_buffer ? "true" : "false") << "\n";
+    f << "      },\n";
+
+    f << "      \"shadows\": {\n";
+    f << "        \"mode\": \"" << escape_json(report.shadow_mode) << "\",\n";
+    f << "        \"map_size\": " << report.shadow_map_size << ",\n";
+    f << "        \"map_time\": " << s.shadow_map_time << ",\n";
+    if (report.has_shadow_comparison) {
+        const ShadowComparison& c = report.shadow_comparison;
+        f << "        \"lookups\": " << s.num_shadow_lookups << ",\n";
+        f << "        \"reference_render\": " << c.reference_render << ",\n";
+        f << "        \"differing_pixels\": " << c.num_diff_pixels << ",\n";
+        f << "        \"mean_error\": " << c.mean_error << ",\n";
+        f << "        \"max_error\": " << c.max_error << "\n";
+    } else {
+        f << "        \"lookups\": " << s.num_shadow_lookups << "\n";
+    }
+    f << "      },\n";
+
+    f << "      \"timings\": {\n";
+    f << "        \"parse\": " << t.parse << ",\n";
+    f << "        \"assets\": " << t.assets << ",\n";
+    f << "        \"build\": " << t.build << ",\n";
+    f << "        \"render\": " << t.render << ",\n";
+    f << "        \"write\": " << t.write << "\n";
+    f << "      },\n";
+
+    f << "      \"rays\": {\n";
+    f << "        \"primary\": " << s.num_primary_rays << ",\n";
+    f << "        \"antialiasing\": " << s.num_aa_rays << ",\n";
+    f << "        \"shadow\": " << s.num_shadow_rays << ",\n";
+    f << "        \"reflection\": " << s.num_reflection_rays << ",\n";
+    f << "        \"per_second\": " << rays_per_second << ",\n";
+    f << "        \"primary_per_thread_second\": " << s.get_primary_rays_per_second() << "\n";
+    f << "      },\n";
+
+    f << "      \"shadow_tests\": " << s.num_shadow_tests << ",\n";
+    f << "      \"occluder_cache_hits\": " << s.num_occluder_hits << ",\n";
+    f << "      \"packets\": " << s.num_packets << ",\n";
+    f << "      \"frustum_culls\": " << s.num_frustum_culls << ",\n";
+    f << "      \"screen_bins\": {\n";
+    f << "        \"time\": " << s.bin_time << ",\n";
+    f << "        \"entries\": " << s.num_bin_entries << ",\n";
+    f << "        \"tests\": " << s.num_bin_tests << ",\n";
+    f << "        \"skips\": " << s.num_bin_skips << "\n";
+    f << "      },\n";
+    f << "      \"raster_primary\": {\n";
+    f << "        \"time\": " << s.raster_time << ",\n";
+    f << "        \"pixels\": " << s.num_raster_pixels << ",\n";
+    f << "        \"misses\": " << s.num_raster_misses << "\n";
+    f << "      },\n";
+    f << "      \"mirror_packets\": " << s.num_mirror_packets << ",\n";
+    f << "      \"mirror_rays\": " << s.num_mirror_rays << ",\n";
+    f << "      \"antialiased_pixels\": " << s.num_aa_pixels << ",\n";
+    f << "      \"uniform_antialiasing_rays\": " << s.num_aa_uniform_rays << ",\n";
+    f << "      \"weight_cuts\": " << s.num_weight_cuts << ",\n";
+    f << "      \"roulette_cuts\": " << s.num_roulette_cuts << ",\n";
+
+    f << "      \"paths_by_bounces\": [";
+    for (size_t i = 0; i < s.num_paths_by_bounces.size(); i++) {
+        f << ((i > 0) ? ", " : "") << s.num_paths_by_bounces[i];
+    }
+    f << "],\n";
+
+    f << "      \"tiles\": " << s.num_tiles << ",\n";
+    f << "      \"steals\": " << s.num_steals << ",\n";
+
+    f << "      \"thread_busy\": [";
+    for (size_t i = 0; i < s.thread_busy_times.size(); i++) {
+        f << ((i > 0) ? ", " : "") << s.thread_busy_times[i];
+    }
+    f << "]\n";
+
+    f << "    }";
+}
+
+
+bool write_stats_json(const std::string& filename,
+                      const std::vector<SceneReport>& reports)
+{
+    std::ofstream f(filename);
+    if (!f.is_open()) {
+        LOG_ERROR(std::string("Cannot open stats file " + filename));
+        return false;
+    }
+
+    f << "{\n  \"scenes\": [\n";
+    for (size_t i = 0; i < reports.size(); i++) {
+        write_scene(f, reports[i]);
+        f << ((i + 1 < reports.size()) ? ",\n" : "\n");
+    }
+    f << "  ]\n}\n";
+
+    return f.good();
+}
+
+
+}
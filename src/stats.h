@@ -0,0 +1,218 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+namespace mrtp {
+
+struct RenderStats
+{
+    unsigned long long num_pixels = 0;
+    unsigned long long num_primary_rays = 0;
+    unsigned long long num_reflection_rays = 0;
+    unsigned long long num_shadow_rays = 0;
+    unsigned long long num_shadow_tests = 0;
+    unsigned long long num_occluder_hits = 0;  // answered by the cached occluder
+
+    unsigned long long num_packets = 0;
+    unsigned long long num_frustum_culls = 0;  // nodes skipped by whole packets
+    double primary_time = 0;  // seconds spent finding primary hits
+
+    // Bounded actors that primary rays tested or skipped by screen tile
+    unsigned long long num_bin_tests = 0;
+    unsigned long long num_bin_skips = 0;
+    double bin_time = 0;  // seconds spent binning actors, once per frame
+    unsigned long long num_bin_entries = 0;
+
+    // Pixels drawn by the visibility prepass, and their primary rays which
+    // found no hit within the drawn depth and were traced again
+    double raster_time = 0;  // seconds spent drawing, once per frame
+    unsigned long long num_raster_pixels = 0;
+    unsigned long long num_raster_misses = 0;
+
+    double shadow_map_time = 0;  // seconds spent rendering the shadow map, once per frame
+    unsigned long long num_shadow_lookups = 0;  // shadow rays answered by the map
+
+    unsigned long long num_mirror_packets = 0;
+    unsigned long long num_mirror_rays = 0;  // reflections off flat mirrors in packets
+
+    unsigned long long num_aa_pixels = 0;
+    unsigned long long num_aa_rays = 0;          // extra camera rays for anti-aliasing
+    unsigned long long num_aa_uniform_rays = 0;  // what supersampling every pixel would take
+
+    // Paths by the number of reflected rays they traced
+    std::vector<unsigned long long> num_paths_by_bounces;
+    unsigned long long num_weight_cuts = 0;
+    unsigned long long num_roulette_cuts = 0;
+
+    unsigned long long num_tiles = 0;
+    unsigned long long num_steals = 0;
+
+    double busy_time = 0;  // seconds spent rendering tiles
+    std::vector<double> thread_busy_times;
+
+    void merge(const RenderStats& other)
+    {
+        num_pixels += other.num_pixels;
+        num_primary_rays += other.num_primary_rays;
+        num_reflection_rays += other.num_reflection_rays;
+        num_shadow_rays += other.num_shadow_rays;
+        num_shadow_tests += other.num_shadow_tests;
+        num_occluder_hits += other.num_occluder_hits;
+
+        num_packets += other.num_packets;
+        num_frustum_culls += other.num_frustum_culls;
+        primary_time += other.primary_time;
+
+        num_bin_tests += other.num_bin_tests;
+        num_bin_skips += other.num_bin_skips;
+        bin_time += other.bin_time;
+        num_bin_entries += other.num_bin_entries;
+
+        raster_time += other.raster_time;
+        num_raster_pixels += other.num_raster_pixels;
+        num_raster_misses += other.num_raster_misses;
+
+        shadow_map_time += other.shadow_map_time;
+        num_shadow_lookups += other.num_shadow_lookups;
+
+        num_mirror_packets += other.num_mirror_packets;
+        num_mirror_rays += other.num_mirror_rays;
+
+        num_aa_pixels += other.num_aa_pixels;
+        num_aa_rays += other.num_aa_rays;
+        num_aa_uniform_rays += other.num_aa_uniform_rays;
+
+        if (num_paths_by_bounces.size() < other.num_paths_by_bounces.size()) {
+            num_paths_by_bounces.resize(other.num_paths_by_bounces.size(), 0);
+        }
+        for (size_t i = 0; i < other.num_paths_by_bounces.size(); i++) {
+            num_paths_by_bounces[i] += other.num_paths_by_bounces[i];
+        }
+        num_weight_cuts += other.num_weight_cuts;
+        num_roulette_cuts += other.num_roulette_cuts;
+
+        num_tiles += other.num_tiles;
+        num_steals += other.num_steals;
+
+        busy_time += other.busy_time;
+        thread_busy_times.push_back(other.busy_time);
+    }
+
+    // Totals of the frames of an animation, which keep one busy time per
+    // thread however many frames there are
+    void add_frame(const RenderStats& frame)
+    {
+        std::vector<double> busy_times = std::move(thread_busy_times);
+        merge(frame);
+
+        busy_times.resize(std::max(busy_times.size(), frame.thread_busy_times.size()), 0);
+        for (size_t i = 0; i < frame.thread_busy_times.size(); i++) {
+            busy_times[i] += frame.thread_busy_times[i];
+        }
+        thread_busy_times = std::move(busy_times);
+    }
+
+    void add_path(unsigned int num_bounces)
+    {
+        if (num_paths_by_bounces.size() <= num_bounces) {
+            num_paths_by_bounces.resize(num_bounces + 1, 0);
+        }
+        num_paths_by_bounces[num_bounces]++;
+    }
+
+    unsigned long long get_num_rays() const
+    {
+        return num_primary_rays + num_aa_rays + num_reflection_rays + num_shadow_rays;
+    }
+
+    // Per thread, summed over all threads
+    double get_primary_rays_per_second() const
+    {
+        return (primary_time > 0) ? num_primary_rays / primary_time : 0;
+    }
+};
+
+
+// Wall-clock durations of the phases of one scene, in seconds
+struct SceneTimings
+{
+    double parse = 0;
+    double assets = 0;
+    double build = 0;
+    double render = 0;
+    double write = 0;
+};
+
+
+// Image with the shadow map against the image with shadow rays
+struct ShadowComparison
+{
+    double reference_render = 0;  // seconds with shadow rays
+    unsigned long long num_diff_pixels = 0;
+    double mean_error = 0;  // per channel over all pixels, out of 255
+    unsigned int max_error = 0;
+};
+
+
+struct SceneReport
+{
+    std::string input_file;
+    std::string output_file;
+    // Frames of an animated scene from this one on, with the totals of
+    // their timings and stats
+    unsigned int frame = 0;
+    unsigned int num_frames = 1;
+    unsigned int num_threads = 1;
+
+    // Structure over the bounded actors, built once per scene
+    std::string accel_name;
+    double accel_build_time = 0;
+    size_t accel_memory = 0;
+    bool light_buffer = false;  // answers shadow rays before the structure
+
+    std::string shadow_mode = "rays";
+    unsigned int shadow_map_size = 0;
+    bool has_shadow_comparison = false;
+    ShadowComparison shadow_comparison;
+
+    SceneTimings timings;
+    RenderStats stats;
+};
+
+
+class StopWatch
+{
+public:
+    StopWatch()
+        : start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Seconds since construction or the last restart
+    double elapsed() const
+    {
+        std::chrono::duration<double> d = std::chrono::steady_clock::now() - start_;
+        return d.count();
+    }
+
+    void restart()
+    {
+        start_ = std::chrono::steady_clock::now();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+
+bool write_stats_json(const std::string&, const std::vector<SceneReport>&);
+
+
+}
+
+#endif // _STATS_H
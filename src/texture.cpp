@@ -42,6 +42,7 @@ void TexturePixel::from_vec(const Vector3d& color_vec)
 
 
 TextureSharedState::TextureSharedState(const std::string& filename)
+    : texture_filename_(filename)
 {
     // TODO Stop on errors
     std::vector<unsigned char> buffer;
@@ -75,46 +76,21 @@ bool TextureSharedState::is_same_texture(const std::string& texture_filename) co
 }
 
 
-MyTexture::MyTexture(TextureSharedState* shared_state,
-                     double reflection_coeff,
-                     double scale_coeff) :
-    reflection_coeff_(reflection_coeff),
-    scale_coeff_(scale_coeff),
-    shared_state_(shared_state) {
-
-}
-
-
-MyPixel MyTexture::pick_pixel(double frac_x, double frac_y) const {
-    TexturePixel pixel = shared_state_->pick_pixel(frac_x, frac_y, scale_coeff_);
-
-    return MyPixel{pixel, reflection_coeff_};
-}
-
-
 TextureFactory::TextureFactory(std::list<TextureSharedState>* shared_states)
     : shared_states_(shared_states)
 {
 }
 
 
-MyTexture* TextureFactory::create_texture(const std::string& texture_filename,
-                                          double reflection_coeff,
-                                          double scale_coeff) {
+const TextureSharedState* TextureFactory::load_texture(const std::string& texture_filename) {
     for (auto& shared_state : *shared_states_) {
         if (shared_state.is_same_texture(texture_filename)) {
-            MyTexture new_texture(&shared_state, reflection_coeff, scale_coeff);
-            textures_.push_back(new_texture);
-            return &textures_.back();
+            return &shared_state;
         }
     }
 
-    TextureSharedState new_shared_state(texture_filename);
-    shared_states_->push_back(new_shared_state);
-
-    MyTexture new_texture(&shared_states_->back(), reflection_coeff, scale_coeff);
-    textures_.push_back(new_texture);
-    return &textures_.back();
+    shared_states_->push_back(TextureSharedState(texture_filename));
+    return &shared_states_->back();
 }
 
 
@@ -53,32 +53,16 @@ private:
 };
 
 
-class MyTexture {
-public:
-    MyTexture(TextureSharedState*, double, double);
-    MyTexture() = delete;
-    ~MyTexture() = default;
-
-    MyPixel pick_pixel(double, double) const;
-
-private:
-    double reflection_coeff_;
-    double scale_coeff_;
-
-    TextureSharedState* shared_state_;
-};
-
-
 class TextureFactory {
 public:
     TextureFactory(std::list<TextureSharedState>*);
     ~TextureFactory() = default;
 
-    MyTexture* create_texture(const std::string&, double, double);
+    // Images are decoded once and shared by all worlds
+    const TextureSharedState* load_texture(const std::string&);
 
 private:
     std::list<TextureSharedState>* shared_states_;
-    std::list<MyTexture> textures_;
 };
 
 
@@ -1,5 +1,8 @@
 #include <Eigen/Core>
 
+#include <algorithm>
+#include <sstream>
+
 #include "logger.h"
 #include "config.h"
 #include "world.h"
@@ -21,6 +24,7 @@ using Vector3d = Eigen::Vector3d;
 
 void SceneWorld::add_light(std::shared_ptr<Light> light_ptr) {
     light_ = light_ptr;
+    snapshot_.reset();
 }
 
 
@@ -31,6 +35,13 @@ void SceneWorld::add_camera(std::shared_ptr<Camera> camera_ptr) {
 
 void SceneWorld::add_actor(std::shared_ptr<ActorBase> actor_ptr) {
     actor_ptrs_.push_back(actor_ptr);
+    snapshot_.reset();
+}
+
+
+void SceneWorld::set_materials(std::shared_ptr<MaterialTable> materials) {
+    materials_ = materials;
+    snapshot_.reset();
 }
 
 
@@ -49,6 +60,260 @@ ActorIterator SceneWorld::get_actor_iterator() {
 }
 
 
+void SceneWorld::compile(AccelType accel_type, bool light_buffer) {
+    accel_type_ = accel_type;
+    light_buffer_ = light_buffer;
+
+    const Light* light = light_buffer_ ? light_.get() : nullptr;
+    snapshot_.reset(new SceneSnapshot(actor_ptrs_, materials_.get(), accel_type_, light));
+}
+
+
+const SceneSnapshot* SceneWorld::get_snapshot() {
+    if (!snapshot_) {
+        compile(accel_type_, light_buffer_);
+    }
+    return snapshot_.get();
+}
+
+
+bool SceneWorld::is_animated() const {
+    return std::any_of(actor_ptrs_.begin(), actor_ptrs_.end(),
+                       [](const std::shared_ptr<ActorBase>& actor) { return actor->is_animated(); });
+}
+
+
+bool SceneWorld::advance_frame() {
+    bool has_moved = false;
+    for (const auto& actor : actor_ptrs_) {
+        if (actor->advance_frame()) {
+            has_moved = true;
+        }
+    }
+
+    if (has_moved) {
+        compile(accel_type_, light_buffer_);
+    }
+    return has_moved;
+}
+
+
+static CompiledActor compile_actor(ActorBase* actor) {
+    return CompiledActor{actor, actor->has_shadow()};
+}
+
+
+SceneSnapshot::SceneSnapshot(const std::vector<std::shared_ptr<ActorBase>>& actor_ptrs,
+                             const MaterialTable* materials,
+                             AccelType accel_type,
+                             const Light* light)
+{
+    if (materials) {
+        for (MaterialId id = 0; id < materials->get_num_materials(); id++) {
+            materials_.push_back(materials->get_material(id));
+        }
+    }
+
+    // Compound actors keep their own light buffers, whatever the accelerator
+    for (const auto& actor : actor_ptrs) {
+        actor->prepare_light(light, kLightMargin);
+    }
+
+    std::vector<CompiledActor> bounded_actors;
+    std::vector<BoundingBox> boxes;
+
+    for (const auto& actor : actor_ptrs) {
+        BoundingBox box;
+        if (actor->calculate_bounds(&box)) {
+            bounded_actors.push_back(compile_actor(actor.get()));
+            boxes.push_back(box);
+        } else {
+            unbounded_actors_.push_back(compile_actor(actor.get()));
+        }
+    }
+
+    StopWatch accel_watch;
+    accelerator_ = create_accelerator(accel_type, bounded_actors, boxes);
+    accel_build_time_ = accel_watch.elapsed();
+
+    std::stringstream convert;
+    convert << "Built " << accelerator_->get_name() << " accelerator in "
+            << accel_build_time_ * 1000 << "ms with "
+            << accelerator_->get_memory_size() << " bytes for "
+            << bounded_actors.size() << " actors, "
+            << unbounded_actors_.size() << " unbounded";
+    LOG_DEBUG(convert.str());
+
+    if (!light) {
+        return;
+    }
+
+    std::vector<BoundingBox> shadow_boxes;
+    for (size_t i = 0; i < bounded_actors.size(); i++) {
+        if (bounded_actors[i].has_shadow) {
+            shadow_actors_.push_back(bounded_actors[i]);
+            shadow_boxes.push_back(boxes[i]);
+        }
+    }
+
+    light_buffer_.build(light->get_center(), shadow_boxes, kLightMargin);
+
+    std::stringstream light_stats;
+    light_stats << "Built light buffer with " << light_buffer_.get_resolution()
+                << " cells per edge for " << shadow_actors_.size() << " actors";
+    LOG_DEBUG(light_stats.str());
+}
+
+
+const Accelerator& SceneSnapshot::get_accelerator() const {
+    return *accelerator_;
+}
+
+
+double SceneSnapshot::get_accel_build_time() const {
+    return accel_build_time_;
+}
+
+
+ActorBase* SceneSnapshot::solve_hits(const Vector3d& O,
+                                     const Vector3d& D,
+                                     double* curr_dist,
+                                     unsigned int* hit_part) const {
+    ActorBase* hit_actor = nullptr;
+
+    for (const CompiledActor& item : unbounded_actors_) {
+        unsigned int part = 0;
+        double distance = item.actor->solve_part_ray(O, D, 0, *curr_dist, &part);
+        if (distance > 0 && distance < *curr_dist) {
+            *curr_dist = distance;
+            *hit_part = part;
+            hit_actor = item.actor;
+        }
+    }
+
+    ActorBase* bounded_actor = accelerator_->solve_hits(O, D, curr_dist, hit_part);
+    return bounded_actor ? bounded_actor : hit_actor;
+}
+
+
+// Actors without shadows are stepped over, starting just past them
+double SceneSnapshot::solve_caster_depth(const Vector3d& O,
+                                         const Vector3d& D,
+                                         double max_dist) const {
+    const double kStepOver = 1e-6;
+
+    double closest = max_dist;
+    for (const CompiledActor& item : unbounded_actors_) {
+        if (item.has_shadow) {
+            double distance = item.actor->solve_light_ray(O, D, 0, closest);
+            if (distance > 0 && distance < closest) {
+                closest = distance;
+            }
+        }
+    }
+
+    double start = 0;
+    for (;;) {
+        double distance = closest - start;
+        unsigned int part = 0;
+        ActorBase* actor = accelerator_->solve_hits(O + start * D, D, &distance, &part);
+        if (!actor) {
+            break;
+        }
+        if (actor->has_shadow()) {
+            closest = start + distance;
+            break;
+        }
+        start += distance + kStepOver;
+    }
+
+    return closest;
+}
+
+
+void SceneSnapshot::solve_packet_hits(RayPacket* packet,
+                                      RayHit* hits,
+                                      TraceContext* context) const {
+    RenderStats* stats = &context->stats;
+    stats->num_packets++;
+
+    for (unsigned int i = 0; i < packet->num_rays; i++) {
+        hits[i] = RayHit();
+        hits[i].distance = packet->max_dist[i];
+    }
+
+    // Compound actors walk their own hierarchies with the whole packet
+    for (const CompiledActor& item : unbounded_actors_) {
+        unsigned int parts[RayPacket::kMaxRays];
+        unsigned int hit_rays = item.actor->solve_packet_rays(packet, packet->get_all_rays(),
+                                                              parts);
+
+        for (unsigned int i = 0; i < packet->num_rays; i++) {
+            if (hit_rays & (1u << i)) {
+                hits[i].actor = item.actor;
+                hits[i].distance = packet->max_dist[i];
+                hits[i].part = parts[i];
+            }
+        }
+    }
+
+    accelerator_->solve_packet_hits(packet, hits, stats);
+}
+
+
+bool SceneSnapshot::solve_shadows(const Vector3d& O,
+                                  const Vector3d& D,
+                                  double max_dist,
+                                  unsigned int depth,
+                                  TraceContext* context) const {
+    RenderStats* stats = &context->stats;
+    stats->num_shadow_rays++;
+
+    // Neighbouring pixels are often shadowed by the same actor
+    unsigned int slot = std::min(depth, TraceContext::kNumOccluders - 1);
+    ActorBase* last_occluder = context->last_occluders[slot];
+
+    if (last_occluder) {
+        stats->num_shadow_tests++;
+        if (last_occluder->occludes(O, D, max_dist)) {
+            stats->num_occluder_hits++;
+            return true;
+        }
+    }
+
+    ActorBase* occluder = nullptr;
+
+    auto test_actor = [&](const CompiledActor& item) {
+        if (item.has_shadow && item.actor != last_occluder) {
+            stats->num_shadow_tests++;
+            if (item.actor->occludes(O, D, max_dist)) {
+                occluder = item.actor;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (const CompiledActor& item : unbounded_actors_) {
+        if (test_actor(item)) {
+            break;
+        }
+    }
+
+    if (!occluder && light_buffer_.covers(O, D, max_dist)) {
+        light_buffer_.find_any(O, [&](unsigned int index) {
+            return test_actor(shadow_actors_[index]);
+        });
+    } else if (!occluder) {
+        occluder = accelerator_->find_occluder(O, D, max_dist, last_occluder, stats);
+    }
+
+    // Forget the occluder in lit areas so they do not pay for a stale test
+    context->last_occluders[slot] = occluder;
+    return occluder != nullptr;
+}
+
+
 ActorIterator::ActorIterator(std::vector<std::shared_ptr<ActorBase>>* actor_ptrs):
     actor_ptrs_(actor_ptrs) {
     actor_iter_ = actor_ptrs_->begin();
@@ -87,48 +352,63 @@ public:
     WorldBuilder() = delete;
     ~WorldBuilder() = default;
 
-    std::shared_ptr<SceneWorld> build() const
+    std::shared_ptr<SceneWorld> build(SceneTimings* timings) const
     {
+        StopWatch phase_watch;
+
         std::shared_ptr<ConfigReader> world_config = open_config(world_filename_);
         if (!world_config) {
             return std::shared_ptr<SceneWorld>();
         }
 
+        timings->parse = phase_watch.elapsed();
+        phase_watch.restart();
+
+        // Actors load their meshes, molecules and textures
+        auto materials = std::make_shared<MaterialTable>(texture_factory_);
         std::vector<std::shared_ptr<ActorBase>> new_actors;
 
         auto planes_array = world_config->get_tables("planes");
-        process_actor_array(ActorType::Plane, planes_array, &new_actors);
+        process_actor_array(ActorType::Plane, planes_array, materials.get(), &new_actors);
 
         auto spheres_array = world_config->get_tables("spheres");
-        process_actor_array(ActorType::Sphere, spheres_array, &new_actors);
+        process_actor_array(ActorType::Sphere, spheres_array, materials.get(), &new_actors);
 
         auto cylinders_array = world_config->get_tables("cylinders");
-        process_actor_array(ActorType::Cylinder, cylinders_array, &new_actors);
+        process_actor_array(ActorType::Cylinder, cylinders_array, materials.get(), &new_actors);
 
         auto triangles_array = world_config->get_tables("triangles");
-        process_actor_array(ActorType::Triangle, triangles_array, &new_actors);
+        process_actor_array(ActorType::Triangle, triangles_array, materials.get(), &new_actors);
 
         auto cubes_array = world_config->get_tables("cubes");
-        process_actor_array(ActorType::Cube, cubes_array, &new_actors);
+        process_actor_array(ActorType::Cube, cubes_array, materials.get(), &new_actors);
 
         auto molecules_array = world_config->get_tables("molecules");
-        process_actor_array(ActorType::Molecule, molecules_array, &new_actors);
+        process_actor_array(ActorType::Molecule, molecules_array, materials.get(), &new_actors);
 
         auto banners_array = world_config->get_tables("banners");
-        process_actor_array(ActorType::Banner, banners_array, &new_actors);
+        process_actor_array(ActorType::Banner, banners_array, materials.get(), &new_actors);
 
         auto meshes_array = world_config->get_tables("meshes");
-        process_actor_array(ActorType::Mesh, meshes_array, &new_actors);
+        process_actor_array(ActorType::Mesh, meshes_array, materials.get(), &new_actors);
+
+        timings->assets = phase_watch.elapsed();
 
         if (new_actors.size() < 1) {
             LOG_ERROR("No actors found");
             return std::shared_ptr<SceneWorld>();
         }
 
+        std::stringstream material_stats;
+        material_stats << "Using " << materials->get_num_materials()
+                       << " materials for " << new_actors.size() << " actors";
+        LOG_DEBUG(material_stats.str());
+
         auto world_ptr = std::shared_ptr<SceneWorld>(new SceneWorld());
         for (const auto& actor : new_actors) {
             world_ptr->add_actor(actor);
         }
+        world_ptr->set_materials(materials);
 
         std::shared_ptr<ConfigTable> camera_table = world_config->get_table("camera");
         if (!camera_table) {
@@ -172,6 +452,7 @@ public:
 
     void process_actor_array(ActorType actor_type,
                              std::shared_ptr<ConfigTableIterator> it,
+                             MaterialTable* materials,
                              std::vector<std::shared_ptr<ActorBase>>* actor_ptrs) const
     {
         if (it)
@@ -179,21 +460,21 @@ public:
             for (it->first(); !it->is_done(); it->next())
             {
                 if (actor_type == ActorType::Plane)
-                    create_plane(texture_factory_, it->current(), actor_ptrs);
+                    create_plane(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Sphere)
-                    create_sphere(texture_factory_, it->current(), actor_ptrs);
+                    create_sphere(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Cylinder)
-                    create_cylinder(texture_factory_, it->current(), actor_ptrs);
+                    create_cylinder(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Triangle)
-                    create_triangle(texture_factory_, it->current(), actor_ptrs);
+                    create_triangle(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Cube)
-                    create_cube(texture_factory_, it->current(), actor_ptrs);
+                    create_cube(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Molecule)
-                    create_molecule(texture_factory_, it->current(), actor_ptrs);
+                    create_molecule(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Banner)
-                    create_banner(texture_factory_, it->current(), actor_ptrs);
+                    create_banner(materials, it->current(), actor_ptrs);
                 else if (actor_type == ActorType::Mesh)
-                    create_mesh(texture_factory_, it->current(), actor_ptrs);
+                    create_mesh(materials, it->current(), actor_ptrs);
 
                 // Ignore when unknown type
             }
@@ -207,11 +488,29 @@ private:
 
 
 std::shared_ptr<SceneWorld> build_world(const std::string& world_filename,
-                                        TextureFactory* texture_factory) {
-    return WorldBuilder(
+                                        TextureFactory* texture_factory,
+                                        AccelType accel_type,
+                                        bool light_buffer,
+                                        SceneTimings* timings) {
+    SceneTimings local_timings;
+    if (!timings) {
+        timings = &local_timings;
+    }
+
+    StopWatch build_watch;
+
+    auto world_ptr = WorldBuilder(
                 world_filename,
                 texture_factory
-                ).build();
+                ).build(timings);
+
+    if (world_ptr) {
+        world_ptr->compile(accel_type, light_buffer);
+    }
+
+    timings->build = build_watch.elapsed() - timings->parse - timings->assets;
+
+    return world_ptr;
 }
 
 
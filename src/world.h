@@ -4,14 +4,31 @@
 #include <memory>
 #include <vector>
 
+#include "accel.h"
 #include "actors.h"
 #include "camera.h"
 #include "light.h"
+#include "lightbuffer.h"
+#include "materials.h"
+#include "packet.h"
+#include "stats.h"
 #include "texture.h"
 
 
 namespace mrtp {
 
+// State owned by a single render thread
+struct TraceContext
+{
+    static const unsigned int kNumOccluders = 8;
+
+    RenderStats stats;
+
+    // Last shadow caster found at each recursion depth
+    ActorBase* last_occluders[kNumOccluders] = {};
+};
+
+
 class ActorIterator {
 public:
     ActorIterator(std::vector<std::shared_ptr<ActorBase>>*);
@@ -29,6 +46,60 @@ private:
 };
 
 
+/*
+Read-only scene that render threads share. It refers to the actors of its
+world through raw pointers, so tracing never touches a reference count.
+Bounded actors are indexed by the accelerator of the chosen type. With a
+light buffer, shadow rays look up the actors in their direction from the
+light instead of asking the accelerator.
+*/
+class SceneSnapshot
+{
+public:
+    // Shadow rays start off their surface by the ray bias, so they end
+    // about that far from the light
+    static constexpr double kLightMargin = 0.01;
+
+    SceneSnapshot(const std::vector<std::shared_ptr<ActorBase>>&,
+                  const MaterialTable*, AccelType, const Light*);
+    SceneSnapshot() = delete;
+    SceneSnapshot(const SceneSnapshot&) = delete;
+    SceneSnapshot& operator=(const SceneSnapshot&) = delete;
+    ~SceneSnapshot() = default;
+
+    ActorBase* solve_hits(const Vector3d&, const Vector3d&, double*, unsigned int*) const;
+    bool solve_shadows(const Vector3d&, const Vector3d&, double,
+                       unsigned int, TraceContext*) const;
+
+    // Distance to the closest actor with shadows, or the given distance
+    double solve_caster_depth(const Vector3d&, const Vector3d&, double) const;
+
+    // Closest hits of a bundle of primary rays, the packet limits the distance
+    void solve_packet_hits(RayPacket*, RayHit*, TraceContext*) const;
+
+    const Material& get_material(MaterialId id) const
+    {
+        return materials_[id];
+    }
+
+    const Accelerator& get_accelerator() const;
+    double get_accel_build_time() const;
+
+private:
+    // Copy of the material table next to the actors
+    std::vector<Material> materials_;
+
+    // Bounded actors and actors of infinite extent
+    std::unique_ptr<Accelerator> accelerator_;
+    double accel_build_time_ = 0;
+    std::vector<CompiledActor> unbounded_actors_;
+
+    // Bounded actors with shadows, indexed by the light buffer
+    LightBuffer light_buffer_;
+    std::vector<CompiledActor> shadow_actors_;
+};
+
+
 class SceneWorld {
 public:
     SceneWorld() = default;
@@ -37,21 +108,41 @@ public:
     void add_light(std::shared_ptr<Light>);
     void add_camera(std::shared_ptr<Camera>);
     void add_actor(std::shared_ptr<ActorBase>);
+    void set_materials(std::shared_ptr<MaterialTable>);
 
     Light* get_light_ptr();
     Camera* get_camera_ptr();
 
     ActorIterator get_actor_iterator();
 
+    // Compile the snapshot again, needed after adding actors
+    void compile(AccelType, bool = false);
+    const SceneSnapshot* get_snapshot();
+
+    // Moves the animated actors to their next frame and compiles the
+    // snapshot again. Returns false once none of them has one. Light
+    // buffers, when on, are not refit: compiling builds those of the
+    // scene and of every actor again from scratch.
+    bool is_animated() const;
+    bool advance_frame();
+
 private:
     std::shared_ptr<Light> light_;
     std::shared_ptr<Camera> camera_;
 
     std::vector<std::shared_ptr<ActorBase>> actor_ptrs_;
+    std::shared_ptr<MaterialTable> materials_;
+
+    AccelType accel_type_ = AccelType::BVH;
+    bool light_buffer_ = false;
+    std::unique_ptr<const SceneSnapshot> snapshot_;
 };
 
 
-std::shared_ptr<SceneWorld> build_world(const std::string&, TextureFactory*);
+std::shared_ptr<SceneWorld> build_world(const std::string&, TextureFactory*,
+                                        AccelType = AccelType::BVH,
+                                        bool = false,
+                                        SceneTimings* = nullptr);
 
 
 } //namespace mrtp